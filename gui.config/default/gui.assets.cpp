@@ -20,6 +20,7 @@ import mo_yanxi.gui.assets.manager;
 
 //TODO import image page from other place...
 import mo_yanxi.graphic.image_atlas;
+import mo_yanxi.graphic.msdf.shape_cache;
 import mo_yanxi.gui.infrastructure;
 import mo_yanxi.gui.elem.scroll_pane;
 import mo_yanxi.gui.image_regions;
@@ -37,23 +38,53 @@ auto& load(mo_yanxi::graphic::image_page& page, std::string&& name, mo_yanxi::gr
 	return page.register_named_region(std::move(name), std::move(task), true).region;
 }
 
+/**
+ * @brief Restore the shape from the bake cache, or generate it and record the result for the next launch.
+ *
+ * @param source identifies the shape, the svg text itself for svg icons
+ */
+template <std::invocable<> Gen>
+auto& load_baked(
+	mo_yanxi::graphic::image_page& page, std::string&& name,
+	mo_yanxi::graphic::msdf::persistent_shape_cache* cache,
+	std::string_view source, bool orient_contours,
+	std::optional<mo_yanxi::math::usize2> extent, std::uint32_t levels,
+	Gen make_generator){
+	using namespace mo_yanxi;
+	if(!cache){
+		return load(page, std::move(name), graphic::sdf_load{make_generator(), extent, levels});
+	}
+
+	const auto key = graphic::msdf::hash_shape_source(source, extent.value_or(math::usize2{}), levels, orient_contours);
+	if(const auto baked = cache->find(key)){
+		return load(page, std::move(name), graphic::sdf_load{baked->sdf, baked->sdf.extent, baked->sdf.level_count});
+	}
+
+	graphic::sdf_load task{make_generator(), extent, levels};
+	cache->record_begin(key, task.get_extent(), task.prov_levels);
+	task.on_generated = [cache, key](std::uint32_t level, const graphic::bitmap& generated){
+		cache->record_level(key, level, generated.to_byte_span());
+	};
+	return load(page, std::move(name), std::move(task));
+}
+
 namespace mo_yanxi::gui::cfg::builtin{
 
 
-void generate_default_shapes(graphic::image_atlas& image_atlas){
+void generate_default_shapes(graphic::image_atlas& image_atlas, graphic::msdf::persistent_shape_cache* shape_cache){
 	auto& atlas = image_atlas;
 	auto& page = atlas.create_image_page("ui", {.usage = graphic::image_page_usage::msdf});
 
-	auto& line = load(page, "line", {
-			graphic::msdf::msdf_generator{graphic::msdf::create_capsule(32, 16)},
-			math::usize2{80u, 64u}, 2
-		});
+	//the key is derived from the generator arguments, changes to create_capsule itself bump shape_generator_version
+	static constexpr double line_radius = 32;
+	static constexpr double line_width = 16;
+	auto& line = load_baked(page, "line", shape_cache, std::format("capsule({}, {})", line_radius, line_width), false, math::usize2{80u, 64u}, 2, []{
+		return graphic::msdf::msdf_generator{graphic::msdf::create_capsule(line_radius, line_width)};
+	});
 
-	auto& side_bar = load(page,
-		"side_bar",
-		graphic::sdf_load{
-			graphic::msdf::msdf_generator{svgs::icons::side_bar_svg, true, true}, std::nullopt, 3
-		});
+	auto& side_bar = load_baked(page, "side_bar", shape_cache, svgs::icons::side_bar_svg, true, std::nullopt, 3, []{
+		return graphic::msdf::msdf_generator{svgs::icons::side_bar_svg, true, true};
+	});
 
 	auto& builtin_page = assets::builtin::get_page();
 
@@ -69,7 +100,7 @@ void generate_default_shapes(graphic::image_atlas& image_atlas){
 }
 
 
-void load_default_icons(graphic::image_atlas& image_atlas){
+void load_default_icons(graphic::image_atlas& image_atlas, graphic::msdf::persistent_shape_cache* shape_cache){
 	auto& atlas = image_atlas;
 	auto& page = atlas.create_image_page("ui", {.usage = graphic::image_page_usage::msdf});
 	auto& builtin_page = assets::builtin::get_page();
@@ -81,8 +112,9 @@ void load_default_icons(graphic::image_atlas& image_atlas){
 
 #define LOAD_ICON(name, orient_contours) \
 	{ \
-	auto& i = load(page, COMBINE(name), \
-	graphic::sdf_load{graphic::msdf::msdf_generator{std::string(svgs::icons::basic:: name##_svg), true, orient_contours}, math::usize2{64u, 64u}, 3}); \
+	auto& i = load_baked(page, COMBINE(name), shape_cache, svgs::icons::basic:: name##_svg, orient_contours, math::usize2{64u, 64u}, 3, []{ \
+		return graphic::msdf::msdf_generator{std::string(svgs::icons::basic:: name##_svg), true, orient_contours}; \
+	}); \
 	builtin_page.insert(assets::builtin::shape_id:: name, i);	\
 	}
 
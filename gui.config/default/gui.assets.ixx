@@ -5,15 +5,19 @@
 export module mo_yanxi.gui.cfg.builtin.assets;
 
 import mo_yanxi.graphic.image_atlas;
+import mo_yanxi.graphic.msdf.shape_cache;
 import std;
 
 namespace mo_yanxi::gui::cfg::builtin{
 
+/**
+ * @param shape_cache restores baked shapes instead of running msdfgen and records the ones it had to generate, may be null
+ */
 export
-void generate_default_shapes(graphic::image_atlas& image_atlas);
+void generate_default_shapes(graphic::image_atlas& image_atlas, graphic::msdf::persistent_shape_cache* shape_cache = nullptr);
 
 export
-void load_default_icons(graphic::image_atlas& image_atlas);
+void load_default_icons(graphic::image_atlas& image_atlas, graphic::msdf::persistent_shape_cache* shape_cache = nullptr);
 
 export
 void dispose_generated_shapes();
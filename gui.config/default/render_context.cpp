@@ -359,8 +359,17 @@ void render_context::initialize(){
 		assets_manager_initialized_ = true;
 	}
 
+	log::debug({"Lifecycle"}, "Initializing decoded image cache");
+	decoded_images_.set_byte_budget(config_.decoded_image_cache_budget);
+	decoded_images_.set_thumbnail_directory(config_.thumbnail_cache_path);
+	graphic::default_decoded_image_cache = &decoded_images_;
+
 	log::debug({"Lifecycle"}, "Initializing font manager");
 	builtin::init_font_manager(fonts_, atlas_);
+	if(!config_.glyph_cache_path.empty()){
+		fonts_.set_glyph_cache_directory(config_.glyph_cache_path);
+	}
+	fonts_.set_async_glyph_generation(config_.async_glyph_generation);
 
 	if(config_.load_default_assets){
 		load_default_assets();
@@ -390,8 +399,12 @@ void render_context::load_default_assets(){
 		gui::assets::builtin::shape_id::logo,
 		gui::constant_image_region_borrow{rst.region});
 
-	builtin::generate_default_shapes(atlas_);
-	builtin::load_default_icons(atlas_);
+	if(!config_.shape_cache_path.empty()){
+		shape_cache_.emplace(config_.shape_cache_path / "builtin_shapes.xsc");
+	}
+	auto* shape_cache = shape_cache_ ? std::addressof(*shape_cache_) : nullptr;
+	builtin::generate_default_shapes(atlas_, shape_cache);
+	builtin::load_default_icons(atlas_, shape_cache);
 	generated_shapes_initialized_ = true;
 
 	log::debug({"Lifecycle"}, "Default assets loaded");
@@ -438,6 +451,10 @@ font::font_manager& render_context::font_manager(){
 	return fonts_;
 }
 
+graphic::decoded_image_cache& render_context::decoded_image_cache(){
+	return decoded_images_;
+}
+
 void render_context::wait_on_device(){
 	context().wait_on_device();
 }
@@ -459,6 +476,23 @@ void render_context::shutdown() noexcept{
 	log::debug({"Lifecycle"}, "Stopping image atlas async operations");
 	atlas_.request_stop();
 
+	log::debug({"Lifecycle"}, "Stopping glyph worker");
+	fonts_.set_async_glyph_generation(false);
+
+	log::debug({"Lifecycle"}, "Saving glyph cache");
+	fonts_.save_glyph_caches();
+
+	if(shape_cache_ && shape_cache_->has_pending()){
+		log::debug({"Lifecycle"}, "Saving baked shape cache");
+		try{
+			if(!shape_cache_->save()){
+				log::warn({"Lifecycle"}, "failed to save baked shape cache {}", shape_cache_->path().string());
+			}
+		} catch(const std::exception& e){
+			log::warn({"Lifecycle"}, "failed to save baked shape cache {}: {}", shape_cache_->path().string(), e.what());
+		}
+	}
+
 	log::debug({"Lifecycle"}, "Waiting on Vulkan device");
 	try{
 		ctx_.wait_on_device();
@@ -473,8 +507,10 @@ void render_context::shutdown() noexcept{
 		assets_manager_initialized_ = false;
 	}
 
-	log::debug({"Lifecycle"}, "Clearing font and typesetting globals");
+	log::debug({"Lifecycle"}, "Clearing font, image and typesetting globals");
 	font::default_font_manager = nullptr;
+	graphic::default_decoded_image_cache = nullptr;
+	decoded_images_.clear();
 	typesetting::look_up_table = nullptr;
 
 	if(gui_initialized_){
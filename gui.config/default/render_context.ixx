@@ -13,6 +13,7 @@ export import mo_yanxi.backend.vulkan.context;
 export import mo_yanxi.backend.vulkan.renderer;
 export import mo_yanxi.graphic.image_atlas;
 export import mo_yanxi.font.manager;
+import mo_yanxi.graphic.msdf.shape_cache;
 
 namespace mo_yanxi::gui::cfg{
 
@@ -22,6 +23,29 @@ struct render_context_config{
 	VkApplicationInfo app_info{};
 	std::filesystem::path shader_spv_path{};
 	std::filesystem::path image_asset_path{};
+	/**
+	 * Directory of the persistent glyph MSDF cache, empty disables it.
+	 */
+	std::filesystem::path glyph_cache_path{};
+	/**
+	 * Generate missing glyphs on a background worker instead of the thread doing the layout.
+	 * Text is laid out immediately and relayouts once the glyph textures are available, so missing glyphs are
+	 * briefly not drawn. Opt-in, as it changes what the first frames of new text look like.
+	 */
+	bool async_glyph_generation{false};
+	/**
+	 * Directory of the baked built-in shape SDFs, empty disables it.
+	 * The first launch generates the shapes with msdfgen and stores them, later launches upload them directly.
+	 */
+	std::filesystem::path shape_cache_path{};
+	/**
+	 * Directory of pre-scaled image thumbnails loaded by `bitmap_path_load`, empty disables it.
+	 */
+	std::filesystem::path thumbnail_cache_path{};
+	/**
+	 * Bytes of decoded images kept in memory for reuse by later loads of the same file.
+	 */
+	std::size_t decoded_image_cache_budget{graphic::decoded_image_cache::default_byte_budget};
 	std::vector<VkSamplerCreateInfo> sampler_create_infos{};
 	/**
 	 * Uses `graphic::auto_sampler_index` (~0U) for automatic sampler resolution
@@ -70,6 +94,7 @@ public:
 	const graphic::image_view_registry& image_view_registry() const;
 	graphic::image_atlas& image_atlas();
 	font::font_manager& font_manager();
+	graphic::decoded_image_cache& decoded_image_cache();
 
 	void wait_on_device();
 	void shutdown() noexcept;
@@ -84,6 +109,9 @@ private:
 
 	vk::sampler_vector sampler_vector_{};
 	graphic::image_view_registry image_view_registry_{};
+	//read by the atlas loader workers, so they must outlive the atlas
+	graphic::decoded_image_cache decoded_images_{};
+	std::optional<graphic::msdf::persistent_shape_cache> shape_cache_{};
 	graphic::image_atlas atlas_{};
 	font::font_manager fonts_{};
 
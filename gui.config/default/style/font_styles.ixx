@@ -13,7 +13,11 @@ import mo_yanxi.graphic.image_atlas;
 namespace mo_yanxi::gui::cfg::builtin{
 export
 void init_font_manager(font::font_manager& font_manager, graphic::image_atlas& image_atlas){
-	font_manager.set_page(image_atlas.create_image_page("font", {.usage = graphic::image_page_usage::msdf}));
+	font_manager.set_page(image_atlas.create_image_page("font", {
+		.usage = graphic::image_page_usage::msdf,
+		//two 4096^2 sub pages, glyphs no longer borrowed are recycled least recently used first beyond that
+		.memory_budget = std::size_t{192} << 20
+	}));
 
 	{
 		auto sys_font_path = font::get_system_fonts();
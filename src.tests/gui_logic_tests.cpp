@@ -3,7 +3,13 @@
 import std;
 
 import mo_yanxi.gui.elem.slider_logic;
+import mo_yanxi.gui.renderer.scissor_bound;
+import mo_yanxi.gui.text_document;
 import mo_yanxi.gui.util.animator;
+import mo_yanxi.math;
+import mo_yanxi.math.matrix3;
+import mo_yanxi.math.rect_ortho;
+import mo_yanxi.math.vector2;
 
 namespace {
 
@@ -161,3 +167,80 @@ TEST(SliderNd, AppliesIndependentDimensionTargets) {
 		std::array<float, 2>{1.0f, 1.0f}));
 	expect_float_array_eq(std::array<float, 2>{0.3f, 0.4f}, slider.get_progress());
 }
+
+TEST(TextDocument, EditsSplitPiecesWithoutTouchingTheText) {
+	mo_yanxi::gui::text_document doc{U"hello\nworld"};
+	EXPECT_EQ(11u, doc.size());
+	EXPECT_EQ(1u, doc.piece_count());
+
+	const auto inserted = doc.insert(5, U", big");
+	EXPECT_EQ(U"hello, big\nworld", doc.view());
+	EXPECT_EQ(3u, doc.piece_count());
+
+	//typing right after the previous insertion extends its piece
+	(void)doc.insert(10, U"!");
+	EXPECT_EQ(3u, doc.piece_count());
+	EXPECT_EQ(U"hello, big!\nworld", doc.view());
+
+	const auto removed = doc.erase(3, 8);
+	EXPECT_EQ(U"hel\nworld", doc.view());
+	EXPECT_EQ(U'w', doc[4]);
+
+	doc.insert(3, removed);
+	EXPECT_EQ(U"hello, big!\nworld", doc.view());
+
+	(void)doc.erase(5, 6);
+	doc.insert(5, {&inserted, 1});
+	EXPECT_EQ(U"hello, big\nworld", doc.substr(0));
+	EXPECT_EQ(U"big\nw", doc.substr(7, 5));
+}
+
+TEST(TextDocument, MapsPositionsToLines) {
+	mo_yanxi::gui::text_document doc{U"a\nbb\n"};
+	(void)doc.insert(2, U"x\ny\n");
+	EXPECT_EQ(U"a\nx\ny\nbb\n", doc.view());
+	EXPECT_EQ(5u, doc.line_count());
+
+	EXPECT_EQ(0u, doc.line_of(0));
+	EXPECT_EQ(0u, doc.line_of(1));
+	EXPECT_EQ(1u, doc.line_of(2));
+	EXPECT_EQ(2u, doc.line_of(5));
+	EXPECT_EQ(3u, doc.line_of(6));
+	EXPECT_EQ(4u, doc.line_of(doc.size()));
+
+	EXPECT_EQ(0u, doc.line_begin(0));
+	EXPECT_EQ(2u, doc.line_begin(1));
+	EXPECT_EQ(4u, doc.line_begin(2));
+	EXPECT_EQ(6u, doc.line_begin(3));
+	EXPECT_EQ(9u, doc.line_begin(4));
+	EXPECT_EQ(doc.size(), doc.line_end(4));
+
+	(void)doc.erase(3, 3);
+	EXPECT_EQ(U"a\nxbb\n", doc.view());
+	EXPECT_EQ(3u, doc.line_count());
+	EXPECT_EQ(6u, doc.line_end(1));
+}
+
+TEST(ScissorBound, MapsScreenScissorThroughTheViewportTransform) {
+	using namespace mo_yanxi;
+
+	//viewport translated by (100, 50) and scaled by 2, the element is translated by (10, 0) inside of it
+	math::mat3 element_to_root_screen = math::mat3_idt;
+	element_to_root_screen.c1.x = 2.f;
+	element_to_root_screen.c2.y = 2.f;
+	element_to_root_screen.c3.x = 120.f;
+	element_to_root_screen.c3.y = 50.f;
+
+	const math::frect scissor{tags::from_vertex, math::vec2{120.f, 50.f}, math::vec2{320.f, 250.f}};
+
+	const auto bound = gui::scissor_bound_in_local(scissor, 0.f, element_to_root_screen);
+	EXPECT_FLOAT_EQ(0.f, bound.get_src().x);
+	EXPECT_FLOAT_EQ(0.f, bound.get_src().y);
+	EXPECT_FLOAT_EQ(100.f, bound.get_end().x);
+	EXPECT_FLOAT_EQ(100.f, bound.get_end().y);
+
+	//the margin is in screen space as well
+	const auto expanded = gui::scissor_bound_in_local(scissor, 4.f, element_to_root_screen);
+	EXPECT_FLOAT_EQ(-2.f, expanded.get_src().x);
+	EXPECT_FLOAT_EQ(102.f, expanded.get_end().y);
+}
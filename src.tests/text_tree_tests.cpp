@@ -10,6 +10,7 @@ namespace {
 
 using mo_yanxi::i18n::find_text_tree_locale_file;
 using mo_yanxi::i18n::frozen_text_tree;
+using mo_yanxi::i18n::i18n_text_batch;
 using mo_yanxi::i18n::i18n_text_root_node;
 using mo_yanxi::i18n::load_text_tree_locale_bundle;
 using mo_yanxi::i18n::load_text_tree_toml_file;
@@ -17,9 +18,11 @@ using mo_yanxi::i18n::locale_name;
 using mo_yanxi::i18n::locale_text_tree_load_options;
 using mo_yanxi::i18n::lookup_status;
 using mo_yanxi::i18n::make_locale_fallback_chain;
+using mo_yanxi::i18n::map_text_tree_binary_file;
 using mo_yanxi::i18n::missing_text_policy;
 using mo_yanxi::i18n::node_kind;
 using mo_yanxi::i18n::parse_text_tree_toml;
+using mo_yanxi::i18n::save_text_tree_binary_file;
 using mo_yanxi::i18n::text_subscription;
 using mo_yanxi::i18n::text_tree_builder;
 
@@ -150,6 +153,24 @@ TEST(TextTree, BasicPaths) {
 	EXPECT_EQ(lookup_status::not_namespace, tree->lookup("app.title.extra").status);
 }
 
+TEST(TextTree, ForEachTextVisitsLocalTexts) {
+	text_tree_builder builder;
+	builder.set_text("app.title", "XRGUI");
+	builder.set_text("buttons.ok", "OK");
+	builder.make_dir("empty.dir");
+	builder.mount_tree("mounted", make_locale_tree("Mounted", "Yes", "Exit"));
+
+	auto tree = std::move(builder).freeze();
+	ASSERT_TRUE(tree);
+
+	std::vector<std::string> texts;
+	tree->for_each_text([&](std::string_view text) {
+		texts.emplace_back(text);
+	});
+	std::ranges::sort(texts);
+	EXPECT_EQ((std::vector<std::string>{"OK", "XRGUI"}), texts);
+}
+
 TEST(TextTree, LargeSiblingLookupUsesNameOrder) {
 	constexpr std::array<std::string_view, 12> names{
 		"A0",
@@ -181,6 +202,73 @@ TEST(TextTree, LargeSiblingLookupUsesNameOrder) {
 	EXPECT_EQ(lookup_status::missing, tree->lookup("root.zzz").status);
 }
 
+TEST(TextTree, PathIndexMatchesWalker) {
+	const auto make_tree = [](bool indexed) {
+		text_tree_builder builder;
+		builder.set_path_index_enabled(indexed);
+		builder.set_text("app.title", "Title");
+		builder.set_text("app.nested.value", "Nested");
+		for(int i = 0; i < 32; ++i) {
+			builder.set_text(std::format("many.item_{}", i), std::format("value {}", i));
+		}
+		builder.add_symbolic_link("alias", "app.nested");
+		builder.add_hard_link("hard", "app.nested");
+		std::string deep{"deep"};
+		for(int i = 0; i < 70; ++i) {
+			deep += std::format(".s{}", i);
+		}
+		builder.set_text(deep, "too deep");
+		builder.mount_tree("mounted", make_locale_tree("Mounted", "OK", "Quit"));
+		return std::move(builder).freeze();
+	};
+
+	const auto indexed = make_tree(true);
+	const auto walked = make_tree(false);
+	EXPECT_TRUE(indexed->has_path_index());
+	EXPECT_FALSE(walked->has_path_index());
+
+	std::vector<std::string> paths{
+		"app", "app.title", "app.nested.value", "alias.value", "hard", "hard.value",
+		"many.item_0", "many.item_31", "many.item_32", "mounted", "mounted.app.title",
+		"app.title.extra", "missing", "app..title", "app."};
+	std::string deep{"deep"};
+	for(int i = 0; i < 70; ++i) {
+		deep += std::format(".s{}", i);
+		paths.push_back(deep);
+	}
+
+	for(const auto& path : paths) {
+		SCOPED_TRACE(path);
+		const auto lhs = indexed->lookup(path);
+		const auto rhs = walked->lookup(path);
+		EXPECT_EQ(rhs.status, lhs.status);
+		EXPECT_EQ(rhs.kind, lhs.kind);
+		EXPECT_EQ(rhs.node, lhs.node);
+		EXPECT_EQ(rhs.text, lhs.text);
+	}
+}
+
+TEST(TextTree, PathIndexCapsPathsPerNode) {
+	text_tree_builder builder;
+	for(int i = 0; i < 16; ++i) {
+		builder.set_text(std::format("base.k{}", i), std::format("value {}", i));
+		builder.set_text(std::format("plain.p{}", i), std::format("plain {}", i));
+	}
+	for(int i = 0; i < 16; ++i) {
+		builder.add_hard_link(std::format("fan.l{}", i), "base");
+	}
+
+	auto tree = std::move(builder).freeze();
+	ASSERT_TRUE(tree);
+	ASSERT_TRUE(tree->has_path_index());
+
+	//the hard linked subtree has more paths than the whole tree budget, it must not starve the other keys
+	for(int i = 0; i < 16; ++i) {
+		EXPECT_TRUE(tree->is_path_indexed(std::format("plain.p{}", i)));
+		expect_text(*tree, std::format("fan.l{}.k{}", i, i), std::format("value {}", i));
+	}
+}
+
 TEST(TextTree, NamespaceMounts) {
 	text_tree_builder builder;
 	const auto common = builder.create_namespace();
@@ -399,6 +487,103 @@ title = "English"
 	EXPECT_FALSE(missing.has_value());
 }
 
+TEST(TextTreeBinary, MappedTreeMatchesSource) {
+	text_tree_builder builder;
+	builder.set_text("app.title", "Title");
+	builder.set_text("app.nested.value", "Nested");
+	for(int i = 0; i < 16; ++i) {
+		builder.set_text(std::format("many.item_{:02}", i), std::format("value {}", i));
+	}
+	builder.add_symbolic_link("alias", "app.nested");
+	const auto tree = std::move(builder).freeze();
+
+	scoped_temp_dir temp;
+	save_text_tree_binary_file(*tree, temp.path / "tree.ttb");
+	const auto mapped = map_text_tree_binary_file(temp.path / "tree.ttb");
+
+	ASSERT_TRUE(mapped);
+	EXPECT_TRUE(mapped->is_mapped());
+	EXPECT_FALSE(tree->is_mapped());
+	EXPECT_TRUE(mapped->has_path_index());
+	ASSERT_EQ(tree->raw_size(), mapped->raw_size());
+	EXPECT_EQ(0, std::memcmp(tree->raw_data(), mapped->raw_data(), tree->raw_size()));
+
+	expect_text(*mapped, "app.title", "Title");
+	expect_text(*mapped, "alias.value", "Nested");
+	for(int i = 0; i < 16; ++i) {
+		expect_text(*mapped, std::format("many.item_{:02}", i), std::format("value {}", i));
+	}
+	EXPECT_EQ(lookup_status::missing, mapped->lookup("many.item_16").status);
+	EXPECT_EQ(lookup_status::not_namespace, mapped->lookup("app.title.more").status);
+}
+
+TEST(TextTreeBinary, RejectsMountsAndInvalidFiles) {
+	text_tree_builder mounted;
+	mounted.mount_tree("child", make_locale_tree("a", "b", "c"));
+	const auto with_mount = std::move(mounted).freeze();
+	std::ostringstream sink;
+	EXPECT_THROW(with_mount->write_binary(sink), std::invalid_argument);
+
+	scoped_temp_dir temp;
+	const auto tree = make_locale_tree("Title", "OK", "Quit");
+	save_text_tree_binary_file(*tree, temp.path / "tree.ttb");
+
+	std::string bytes;
+	{
+		std::ifstream in{temp.path / "tree.ttb", std::ios::binary};
+		bytes.assign(std::istreambuf_iterator<char>{in}, {});
+	}
+	write_test_file(temp.path / "truncated.ttb", std::string_view{bytes}.substr(0, bytes.size() - 1));
+	write_test_file(temp.path / "bad_magic.ttb", "XXXX" + bytes.substr(4));
+
+	EXPECT_THROW((void)map_text_tree_binary_file(temp.path / "truncated.ttb"), std::invalid_argument);
+	EXPECT_THROW((void)map_text_tree_binary_file(temp.path / "bad_magic.ttb"), std::invalid_argument);
+	EXPECT_THROW((void)map_text_tree_binary_file(temp.path / "missing.ttb"), std::invalid_argument);
+}
+
+TEST(TextTreeBinary, LocaleBundlePrefersCompiledFile) {
+	scoped_temp_dir temp;
+	save_text_tree_binary_file(*make_locale_tree("Compiled", "OK", "Quit"), temp.path / "en-US.ttb");
+
+	auto en = load_text_tree_locale_bundle(
+		"en-US",
+		locale_text_tree_load_options{.bundle_dir = temp.path});
+	ASSERT_TRUE(en.has_value());
+	EXPECT_EQ("en-US", en->locale);
+	EXPECT_EQ(".ttb", en->path.extension());
+	EXPECT_TRUE(en->tree->is_mapped());
+	expect_text(*en->tree, "app.title", "Compiled");
+}
+
+TEST(TextTreeBinary, LocaleBundleFallsBackToSourceForCorruptedCompiledFile) {
+	scoped_temp_dir temp;
+	write_test_file(temp.path / "en-US.toml", R"(
+[text.app]
+title = "Source"
+)");
+	write_test_file(temp.path / "en-US.ttb", "XXXX not a text tree");
+
+	auto file = find_text_tree_locale_file(
+		"en-US",
+		locale_text_tree_load_options{.bundle_dir = temp.path});
+	ASSERT_TRUE(file.has_value());
+	ASSERT_EQ(".ttb", file->path.extension());
+
+	auto en = load_text_tree_locale_bundle(
+		"en-US",
+		locale_text_tree_load_options{.bundle_dir = temp.path});
+	ASSERT_TRUE(en.has_value());
+	EXPECT_EQ("en-US", en->locale);
+	EXPECT_EQ(".toml", en->path.extension());
+	EXPECT_FALSE(en->tree->is_mapped());
+	expect_text(*en->tree, "app.title", "Source");
+
+	std::filesystem::remove(temp.path / "en-US.toml");
+	EXPECT_THROW(
+		(void)load_text_tree_locale_bundle("en-US", locale_text_tree_load_options{.bundle_dir = temp.path}),
+		std::invalid_argument);
+}
+
 TEST(I18nReactFlow, RootUpdatesSubscribers) {
 	auto en = make_locale_tree("Hello", "OK", "Quit");
 	auto zh = make_locale_tree("你好", "确定", "退出");
@@ -531,3 +716,94 @@ TEST(I18nReactFlow, DirectListenerHelperCopiesCallback) {
 	update_i18n_root(root, zh, "zh");
 	EXPECT_EQ("copy:你好", received);
 }
+
+TEST(I18nReactFlow, BatchDefersAndDeduplicatesListenerUpdates) {
+	auto en = make_locale_tree("Hello", "OK", "Quit");
+	auto zh = make_locale_tree("你好", "确定", "退出");
+
+	mo_yanxi::react_flow::manager manager{mo_yanxi::react_flow::manager_no_async};
+	auto& root = manager.add_node<i18n_text_root_node>(en, "en");
+
+	std::vector<std::string> applied;
+	auto& first = mo_yanxi::i18n::bind_i18n_text_listener(
+		manager,
+		root,
+		text_subscription{.path = "buttons.ok"},
+		[&](std::string_view text) { applied.push_back("first:" + std::string{text}); });
+	(void)mo_yanxi::i18n::bind_i18n_text_listener(
+		manager,
+		root,
+		text_subscription{.path = "buttons.ok"},
+		[&](std::string_view text) { applied.push_back("second:" + std::string{text}); });
+	applied.clear();
+
+	{
+		i18n_text_batch batch;
+		EXPECT_EQ(std::addressof(batch), i18n_text_batch::active());
+
+		update_i18n_root(root, zh, "zh");
+		first.set_subscription(text_subscription{.path = "menu.quit"});
+		EXPECT_TRUE(applied.empty());
+		EXPECT_EQ(3uz, batch.pending());
+
+		EXPECT_EQ(2uz, batch.flush());
+		EXPECT_EQ(0uz, batch.pending());
+	}
+	EXPECT_EQ(nullptr, i18n_text_batch::active());
+
+	ASSERT_EQ(2uz, applied.size());
+	EXPECT_EQ("second:确定", applied[0]);
+	EXPECT_EQ("first:退出", applied[1]);
+}
+
+TEST(I18nReactFlow, SwitchTreeDeliversOneBatch) {
+	auto en = make_locale_tree("Hello", "OK", "Quit");
+	auto zh = make_locale_tree("你好", "确定", "退出");
+
+	mo_yanxi::react_flow::manager manager{mo_yanxi::react_flow::manager_no_async};
+	auto& root = manager.add_node<i18n_text_root_node>(en, "en");
+	dummy_text_target title{manager};
+	dummy_text_target quit{manager};
+	(void)mo_yanxi::i18n::bind_i18n_text(root, title, "app.title");
+	(void)mo_yanxi::i18n::bind_i18n_text(root, quit, text_subscription{
+		.path = "menu.missing",
+		.fallback = "Close",
+		.missing = missing_text_policy::fallback,
+	});
+	EXPECT_EQ("Hello", title.text);
+	EXPECT_EQ("Close", quit.text);
+
+	EXPECT_EQ(2uz, root.switch_tree(zh, "zh"));
+	EXPECT_EQ(2u, root.get_raw_cache().revision);
+	EXPECT_EQ("zh", root.get_raw_cache().locale);
+	EXPECT_EQ("你好", title.text);
+	EXPECT_EQ("Close", quit.text);
+	EXPECT_EQ(nullptr, i18n_text_batch::active());
+}
+
+TEST(I18nReactFlow, SwitchTreeResolvesInParallel) {
+	text_tree_builder en_builder;
+	text_tree_builder de_builder;
+	for(std::size_t i = 0; i < 64; ++i) {
+		en_builder.set_text(std::format("items.i{}", i), std::format("item {}", i));
+		de_builder.set_text(std::format("items.i{}", i), std::format("Eintrag {}", i));
+	}
+
+	mo_yanxi::react_flow::manager manager{mo_yanxi::react_flow::manager_no_async};
+	auto& root = manager.add_node<i18n_text_root_node>(std::move(en_builder).freeze(), "en");
+
+	std::vector<std::string> received(64);
+	for(std::size_t i = 0; i < received.size(); ++i) {
+		(void)mo_yanxi::i18n::bind_i18n_text_listener(
+			manager,
+			root,
+			text_subscription{.path = std::format("items.i{}", i)},
+			[&received, i](std::string_view text) { received[i] = text; });
+	}
+	EXPECT_EQ("item 63", received[63]);
+
+	EXPECT_EQ(64uz, root.switch_tree(std::move(de_builder).freeze(), "de", {.parallel_threshold = 2}));
+	for(std::size_t i = 0; i < received.size(); ++i) {
+		EXPECT_EQ(std::format("Eintrag {}", i), received[i]);
+	}
+}
@@ -3,8 +3,13 @@
 import std;
 
 import mo_yanxi.csv;
+import mo_yanxi.graphic.bitmap_kernels;
+import mo_yanxi.graphic.bitmap_resize;
+import mo_yanxi.graphic.region_slot_table;
 import mo_yanxi.double_buffer;
 import mo_yanxi.fixed_vector;
+import mo_yanxi.mpmc_queue;
+import mo_yanxi.thread_pool;
 import mo_yanxi.unicode;
 import mo_yanxi.vector_string;
 
@@ -73,6 +78,19 @@ struct counted_value {
 	}
 };
 
+std::vector<std::byte> random_pixels(std::size_t pixel_count, std::uint32_t seed) {
+	std::mt19937 rng{seed};
+	std::vector<std::byte> pixels(pixel_count * 4);
+	for(auto& byte : pixels) {
+		byte = static_cast<std::byte>(rng());
+	}
+	return pixels;
+}
+
+int channel(const std::vector<std::byte>& pixels, std::size_t pixel, std::size_t c) {
+	return std::to_integer<int>(pixels[pixel * 4 + c]);
+}
+
 void expect_coord(mo_yanxi::csv::coord actual, std::size_t row, std::size_t col) {
 	EXPECT_EQ(row, actual.row);
 	EXPECT_EQ(col, actual.col);
@@ -80,6 +98,213 @@ void expect_coord(mo_yanxi::csv::coord actual, std::size_t row, std::size_t col)
 
 } // namespace
 
+TEST(BitmapKernels, PremultiplyAndSwizzleMatchReference) {
+	namespace kernels = mo_yanxi::graphic::bitmap_kernels;
+
+	//odd counts leave a tail for the scalar path after the vector loop
+	for(const std::size_t count : {1uz, 7uz, 8uz, 29uz, 300uz}) {
+		const auto source = random_pixels(count, static_cast<std::uint32_t>(count));
+
+		auto premultiplied = source;
+		kernels::premultiply_alpha(premultiplied);
+		auto swizzled = source;
+		kernels::swap_red_blue(swizzled);
+
+		for(std::size_t i = 0; i < count; ++i) {
+			const int alpha = channel(source, i, 3);
+			for(std::size_t c = 0; c < 3; ++c) {
+				EXPECT_EQ(static_cast<int>(std::lround(channel(source, i, c) * alpha / 255.)), channel(premultiplied, i, c));
+			}
+			EXPECT_EQ(alpha, channel(premultiplied, i, 3));
+
+			EXPECT_EQ(channel(source, i, 2), channel(swizzled, i, 0));
+			EXPECT_EQ(channel(source, i, 1), channel(swizzled, i, 1));
+			EXPECT_EQ(channel(source, i, 0), channel(swizzled, i, 2));
+			EXPECT_EQ(channel(source, i, 3), channel(swizzled, i, 3));
+		}
+	}
+}
+
+TEST(BitmapKernels, SrgbConversionRoundTripsAndKeepsAlpha) {
+	namespace kernels = mo_yanxi::graphic::bitmap_kernels;
+
+	std::vector<std::byte> pixels(256 * 4);
+	for(std::size_t i = 0; i < 256; ++i) {
+		for(std::size_t c = 0; c < 4; ++c) {
+			pixels[i * 4 + c] = static_cast<std::byte>(i);
+		}
+	}
+
+	auto linear = pixels;
+	kernels::srgb_to_linear(linear);
+	EXPECT_EQ(0, channel(linear, 0, 0));
+	EXPECT_EQ(255, channel(linear, 255, 0));
+	EXPECT_EQ(55, channel(linear, 128, 1));
+	EXPECT_EQ(128, channel(linear, 128, 3));
+
+	auto encoded = pixels;
+	kernels::linear_to_srgb(encoded);
+	EXPECT_EQ(188, channel(encoded, 128, 2));
+	EXPECT_EQ(128, channel(encoded, 128, 3));
+
+	//the linear 8 bit encoding is lossy in the darks, the bright half survives a round trip
+	kernels::linear_to_srgb(linear);
+	for(std::size_t i = 128; i < 256; ++i) {
+		EXPECT_NEAR(static_cast<int>(i), channel(linear, i, 0), 2);
+	}
+}
+
+TEST(BitmapKernels, DownsampleAveragesQuadsAndDropsOddEdges) {
+	namespace kernels = mo_yanxi::graphic::bitmap_kernels;
+
+	const std::array<std::pair<std::size_t, std::size_t>, 5> extents{{{1, 1}, {1, 6}, {9, 1}, {16, 4}, {37, 11}}};
+	for(const auto [width, height] : extents) {
+		const auto source = random_pixels(width * height, static_cast<std::uint32_t>(width * 131 + height));
+		const auto [dst_width, dst_height] = kernels::downsampled_extent(width, height);
+		std::vector<std::byte> result(dst_width * dst_height * 4);
+		kernels::downsample_2x(source, width, height, result);
+
+		for(std::size_t y = 0; y < dst_height; ++y) {
+			for(std::size_t x = 0; x < dst_width; ++x) {
+				const auto x0 = x * 2;
+				const auto y0 = y * 2;
+				const auto x1 = std::min(x0 + 1, width - 1);
+				const auto y1 = std::min(y0 + 1, height - 1);
+				for(std::size_t c = 0; c < 4; ++c) {
+					const int sum =
+						channel(source, y0 * width + x0, c) + channel(source, y0 * width + x1, c) +
+						channel(source, y1 * width + x0, c) + channel(source, y1 * width + x1, c);
+					EXPECT_EQ((sum + 2) / 4, channel(result, y * dst_width + x, c));
+				}
+			}
+		}
+	}
+}
+
+TEST(BitmapResize, FitImageExtentKeepsAspectAndNeverUpscales) {
+	using mo_yanxi::graphic::fit_image_extent;
+	using mo_yanxi::math::usize2;
+
+	static_assert(fit_image_extent({2000, 1000}, {1024, 640}) == usize2{1024, 512});
+	EXPECT_EQ((usize2{300, 200}), fit_image_extent({300, 200}, {1024, 640}));
+	EXPECT_EQ((usize2{250, 1000}), fit_image_extent({1000, 4000}, {0, 1000}));
+	EXPECT_EQ((usize2{1000, 4000}), fit_image_extent({1000, 4000}, {0, 0}));
+	//a thin image keeps at least one texel on its short side
+	EXPECT_EQ((usize2{100, 1}), fit_image_extent({1000, 5}, {100, 100}));
+	EXPECT_EQ((usize2{0, 5}), fit_image_extent({0, 5}, {10, 10}));
+}
+
+TEST(BitmapResize, DownscaleWeightsColorByAlpha) {
+	using mo_yanxi::graphic::downscale_bitmap;
+	using mo_yanxi::math::usize2;
+
+	//left block: two opaque red and two transparent green texels, right block: opaque gray
+	mo_yanxi::bitmap source{4, 2};
+	auto* texels = reinterpret_cast<std::uint8_t*>(source.data());
+	const std::array<std::array<std::uint8_t, 4>, 8> pixels{{
+		{255, 0, 0, 255}, {0, 255, 0, 0}, {90, 90, 90, 255}, {90, 90, 90, 255},
+		{0, 255, 0, 0}, {255, 0, 0, 255}, {90, 90, 90, 255}, {90, 90, 90, 255},
+	}};
+	std::ranges::copy(pixels | std::views::join, texels);
+
+	const auto result = downscale_bitmap(source, {2, 1});
+	ASSERT_EQ((usize2{2, 1}), result.extent());
+	const auto* out = reinterpret_cast<const std::uint8_t*>(result.data());
+	EXPECT_EQ(255, out[0]);
+	EXPECT_EQ(0, out[1]);
+	EXPECT_EQ(0, out[2]);
+	EXPECT_EQ(128, out[3]);
+	for(std::size_t c = 0; c < 3; ++c) {
+		EXPECT_EQ(90, out[4 + c]);
+	}
+	EXPECT_EQ(255, out[7]);
+
+	const auto same = downscale_bitmap(source, source.extent());
+	EXPECT_TRUE(std::ranges::equal(
+		std::span{texels, 32}, std::span{reinterpret_cast<const std::uint8_t*>(same.data()), 32}));
+}
+
+TEST(BitmapResize, DownscaleCoversUnevenRatios) {
+	using mo_yanxi::graphic::downscale_bitmap;
+	using mo_yanxi::math::usize2;
+
+	mo_yanxi::bitmap source{7, 5};
+	auto* texels = reinterpret_cast<std::uint8_t*>(source.data());
+	for(std::size_t i = 0; i < 7 * 5; ++i) {
+		texels[i * 4 + 0] = 40;
+		texels[i * 4 + 1] = 120;
+		texels[i * 4 + 2] = 200;
+		texels[i * 4 + 3] = 255;
+	}
+
+	//every target texel averages a non empty box, a uniform image stays uniform
+	for(const usize2 target : {usize2{3, 2}, usize2{1, 1}, usize2{7, 1}, usize2{2, 5}}) {
+		const auto result = downscale_bitmap(source, target);
+		ASSERT_EQ(target, result.extent());
+		const auto* out = reinterpret_cast<const std::uint8_t*>(result.data());
+		for(std::size_t i = 0; i < static_cast<std::size_t>(target.x) * target.y; ++i) {
+			EXPECT_EQ(40, out[i * 4 + 0]);
+			EXPECT_EQ(120, out[i * 4 + 1]);
+			EXPECT_EQ(200, out[i * 4 + 2]);
+			EXPECT_EQ(255, out[i * 4 + 3]);
+		}
+	}
+}
+
+TEST(RegionSlotTable, ReleaseBumpsGenerationAndRejectsStaleHandles) {
+	mo_yanxi::graphic::region_slot_table<int> table;
+	int first = 1;
+	int second = 2;
+
+	const auto slot = table.acquire();
+	table.publish(slot, first);
+	const auto handle = table.handle_of(slot);
+	ASSERT_TRUE(handle);
+	EXPECT_EQ(&first, table.resolve(handle));
+
+	table.release(slot);
+	EXPECT_EQ(nullptr, table.resolve(handle));
+	EXPECT_NE(handle.generation, table.handle_of(slot).generation);
+
+	//the released slot is handed out again, the old handle must not see its new region
+	const auto reused = table.acquire();
+	EXPECT_EQ(slot, reused);
+	table.publish(reused, second);
+	EXPECT_EQ(nullptr, table.resolve(handle));
+	EXPECT_EQ(&second, table.resolve(table.handle_of(reused)));
+	EXPECT_EQ(nullptr, table.resolve({}));
+}
+
+TEST(RegionSlotTable, FreeListReusesLastReleasedFirst) {
+	mo_yanxi::graphic::region_slot_table<int> table;
+	const auto a = table.acquire();
+	const auto b = table.acquire();
+	const auto c = table.acquire();
+	EXPECT_NE(a, b);
+	EXPECT_NE(b, c);
+
+	table.release(a);
+	table.release(c);
+	EXPECT_EQ(c, table.acquire());
+	EXPECT_EQ(a, table.acquire());
+	EXPECT_EQ(c + 1, table.acquire());
+}
+
+TEST(RegionSlotTable, VisitOnlyRunsForLiveHandles) {
+	mo_yanxi::graphic::region_slot_table<int> table;
+	int value = 7;
+	const auto slot = table.acquire();
+	table.publish(slot, value);
+	const auto handle = table.handle_of(slot);
+
+	int seen{};
+	EXPECT_TRUE(table.visit(handle, [&](int& region) { seen = region; }));
+	EXPECT_EQ(7, seen);
+
+	table.release(slot);
+	EXPECT_FALSE(table.visit(handle, [&](int&) { ADD_FAILURE(); }));
+}
+
 TEST(Csv, NumericDetectionHandlesCommonNumberForms) {
 	EXPECT_TRUE(mo_yanxi::csv::is_numeric("42"));
 	EXPECT_TRUE(mo_yanxi::csv::is_numeric(" \t-12.5e+3\r\n"));
@@ -134,6 +359,161 @@ TEST(Csv, UnescapeCsvFieldOnlyCopiesWhenQuotesExist) {
 	EXPECT_EQ("a \"quoted\" value", target);
 }
 
+TEST(Csv, MappedReaderChunksOnRecordBoundaries) {
+	const scoped_temp_file csv_file{".csv"};
+	std::string text = "\xEF\xBB\xBFid,note\r\n";
+	for(int i = 0; i < 64; ++i) {
+		text += std::format("{},\"line {}\nwith, \"\"quotes\"\"\"\r\n", i, i);
+	}
+	text += "last,";
+	csv_file.write(text);
+
+	const mo_yanxi::csv::mapped_reader reader{csv_file.path};
+	ASSERT_TRUE(static_cast<bool>(reader));
+	mo_yanxi::thread_pool pool{2};
+
+	std::vector<parsed_cell> sequential;
+	reader.parse([&](mo_yanxi::csv::coord position, std::string_view field) {
+		sequential.push_back(parsed_cell{.position = position, .text = std::string{field}});
+	});
+
+	std::vector<parsed_cell> chunked;
+	std::size_t chunk_count{};
+	std::size_t expected_first_row{};
+	reader.parse_parallel(pool, [&](mo_yanxi::csv::record_chunk&& chunk) {
+		EXPECT_EQ(expected_first_row, chunk.first_row);
+		expected_first_row += chunk.size();
+		++chunk_count;
+		for(std::size_t record = 0; record < chunk.size(); ++record) {
+			for(const auto& [col, field] : chunk[record] | std::views::enumerate) {
+				chunked.push_back(parsed_cell{
+					.position = {chunk.first_row + record, static_cast<std::size_t>(col)},
+					.text = std::string{field}
+				});
+			}
+		}
+	}, 3, 16);
+
+	EXPECT_GT(chunk_count, 1uz);
+	EXPECT_EQ(66uz, expected_first_row);
+	ASSERT_EQ(sequential.size(), chunked.size());
+	for(std::size_t i = 0; i < sequential.size(); ++i) {
+		expect_coord(chunked[i].position, sequential[i].position.row, sequential[i].position.col);
+		EXPECT_EQ(sequential[i].text, chunked[i].text);
+	}
+
+	ASSERT_EQ(2uz + 64 * 2 + 2, sequential.size());
+	EXPECT_EQ("id", sequential[0].text);
+	expect_coord(sequential[3].position, 1, 1);
+	std::string unescaped;
+	mo_yanxi::csv::unescape_csv_field(unescaped, sequential[3].text);
+	EXPECT_EQ("line 0\nwith, \"quotes\"", unescaped);
+	expect_coord(sequential.back().position, 65, 1);
+	EXPECT_TRUE(sequential.back().text.empty());
+}
+
+TEST(Csv, MappedReaderSplitsOnEveryLineBreakStyle) {
+	for(const std::string_view line_break : {"\r", "\n", "\r\n"}) {
+		const scoped_temp_file csv_file{".csv"};
+		std::string text;
+		for(int i = 0; i < 32; ++i) {
+			text += std::format("{},\"a{}b\"{}", i, line_break, line_break);
+		}
+		csv_file.write(text);
+
+		const mo_yanxi::csv::mapped_reader reader{csv_file.path};
+		ASSERT_TRUE(static_cast<bool>(reader));
+		mo_yanxi::thread_pool pool{2};
+
+		std::vector<parsed_cell> sequential;
+		reader.parse([&](mo_yanxi::csv::coord position, std::string_view field) {
+			sequential.push_back(parsed_cell{.position = position, .text = std::string{field}});
+		});
+		ASSERT_EQ(32uz * 2, sequential.size());
+
+		for(const std::size_t chunk_size : {1uz, 5uz, 13uz}) {
+			std::vector<parsed_cell> chunked;
+			std::size_t chunk_count{};
+			reader.parse_parallel(pool, [&](mo_yanxi::csv::record_chunk&& chunk) {
+				++chunk_count;
+				for(std::size_t record = 0; record < chunk.size(); ++record) {
+					for(const auto& [col, field] : chunk[record] | std::views::enumerate) {
+						chunked.push_back(parsed_cell{
+							.position = {chunk.first_row + record, static_cast<std::size_t>(col)},
+							.text = std::string{field}
+						});
+					}
+				}
+			}, 2, chunk_size);
+
+			//each chunk ends at the first line break outside of quotes past its size, whatever its style
+			EXPECT_GE(chunk_count, text.size() / (chunk_size + 16));
+			ASSERT_EQ(sequential.size(), chunked.size());
+			for(std::size_t i = 0; i < sequential.size(); ++i) {
+				expect_coord(chunked[i].position, sequential[i].position.row, sequential[i].position.col);
+				EXPECT_EQ(sequential[i].text, chunked[i].text);
+			}
+		}
+	}
+}
+
+TEST(Csv, MappedReaderStopsWhenChunkCallbackDeclines) {
+	const scoped_temp_file csv_file{".csv"};
+	std::string text;
+	for(int i = 0; i < 32; ++i) {
+		text += std::format("{},{}\n", i, i * 2);
+	}
+	csv_file.write(text);
+
+	const mo_yanxi::csv::mapped_reader reader{csv_file.path};
+	std::size_t chunk_count{};
+	mo_yanxi::thread_pool pool{2};
+	reader.parse_parallel(pool, [&](mo_yanxi::csv::record_chunk&&) {
+		++chunk_count;
+		return false;
+	}, 2, 8);
+	EXPECT_EQ(1uz, chunk_count);
+
+	const mo_yanxi::csv::mapped_reader missing{csv_file.path.string() + ".missing"};
+	EXPECT_FALSE(static_cast<bool>(missing));
+	reader.parse_parallel(pool, [&](mo_yanxi::csv::record_chunk&&) {
+		++chunk_count;
+	});
+	missing.parse_parallel(pool, [&](mo_yanxi::csv::record_chunk&&) {
+		ADD_FAILURE() << "an unmapped file has no records";
+	});
+	EXPECT_EQ(2uz, chunk_count);
+}
+
+TEST(Csv, ChunkParserHandsOutChunksInOrderWithoutBlocking) {
+	std::string text;
+	for(int i = 0; i < 200; ++i) {
+		text += std::format("{},\"v\n{}\"\n", i, i);
+	}
+	const auto owned = std::make_shared<const std::string>(std::move(text));
+
+	mo_yanxi::thread_pool pool{2};
+	mo_yanxi::csv::parallel_chunk_parser parser{pool, *owned, ',', owned, 3, 64};
+
+	std::size_t next_row{};
+	while(!parser.done()) {
+		if(auto chunk = parser.try_next()) {
+			EXPECT_EQ(next_row, chunk->first_row);
+			for(std::size_t record = 0; record < chunk->size(); ++record) {
+				EXPECT_EQ(std::to_string(next_row + record), (*chunk)[record][0]);
+			}
+			next_row += chunk->size();
+		} else {
+			std::this_thread::yield();
+		}
+	}
+	EXPECT_EQ(200uz, next_row);
+
+	//dropping a parser with chunks still queued must not wait for or parse them
+	mo_yanxi::csv::parallel_chunk_parser dropped{pool, *owned, ',', owned, 3, 64};
+	EXPECT_FALSE(dropped.done());
+}
+
 TEST(FixedVector, ConstructsCopiesMovesAndBoundsChecks) {
 	mo_yanxi::fixed_vector<int> values(3, 7);
 	EXPECT_EQ(3uz, values.size());
@@ -173,6 +553,87 @@ TEST(FixedVector, DestroysConstructedObjectsExactlyOnce) {
 	EXPECT_EQ(0, counted_value::alive);
 }
 
+TEST(MpmcQueue, KeepsFifoOrderAndRejectsWhenFull) {
+	mo_yanxi::mpmc_queue<std::unique_ptr<int>> queue{3};
+	EXPECT_EQ(4uz, queue.capacity());
+	EXPECT_TRUE(queue.empty_approx());
+	EXPECT_FALSE(queue.try_pop().has_value());
+
+	for(int i = 0; i < 4; ++i) {
+		EXPECT_TRUE(queue.try_push(std::make_unique<int>(i)));
+	}
+
+	auto rejected = std::make_unique<int>(4);
+	EXPECT_FALSE(queue.try_push(std::move(rejected)));
+	ASSERT_TRUE(rejected);
+	EXPECT_EQ(4uz, queue.size_approx());
+
+	for(int i = 0; i < 4; ++i) {
+		auto value = queue.try_pop();
+		ASSERT_TRUE(value.has_value());
+		EXPECT_EQ(i, **value);
+	}
+	EXPECT_TRUE(queue.empty_approx());
+
+	EXPECT_TRUE(queue.try_push(std::move(rejected)));
+	EXPECT_EQ(4, **queue.try_pop());
+}
+
+TEST(MpmcQueue, DeliversEveryItemOnceAcrossThreads) {
+	constexpr int producer_count = 4;
+	constexpr int consumer_count = 4;
+	constexpr int items_per_producer = 20000;
+
+	mo_yanxi::mpmc_queue<int> queue{64};
+	std::atomic_int consumed{};
+	std::vector<std::atomic_int> seen(producer_count * items_per_producer);
+
+	{
+		std::vector<std::jthread> threads;
+		for(int p = 0; p < producer_count; ++p) {
+			threads.emplace_back([&, p] {
+				for(int i = 0; i < items_per_producer; ++i) {
+					while(!queue.try_push(p * items_per_producer + i)) {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+		for(int c = 0; c < consumer_count; ++c) {
+			threads.emplace_back([&] {
+				while(consumed.load() < producer_count * items_per_producer) {
+					if(auto value = queue.try_pop()) {
+						seen[*value].fetch_add(1);
+						consumed.fetch_add(1);
+					} else {
+						std::this_thread::yield();
+					}
+				}
+			});
+		}
+	}
+
+	EXPECT_EQ(producer_count * items_per_producer, consumed.load());
+	EXPECT_TRUE(std::ranges::all_of(seen, [](const std::atomic_int& count) { return count.load() == 1; }));
+}
+
+TEST(ThreadPool, ParallelForRunsEveryIndexOnceFromAWorker) {
+	mo_yanxi::thread_pool pool{2};
+	constexpr std::size_t count = 1000;
+	std::vector<std::atomic_int> seen(count);
+	std::atomic_bool finished{};
+
+	//a task waiting on its own batch must not deadlock the pool
+	ASSERT_TRUE(pool.try_post([&] {
+		pool.parallel_for(count, [&](std::size_t i) { seen[i].fetch_add(1); });
+		finished.store(true);
+		finished.notify_all();
+	}));
+	finished.wait(false);
+
+	EXPECT_TRUE(std::ranges::all_of(seen, [](const std::atomic_int& hits) { return hits.load() == 1; }));
+}
+
 TEST(DoubleBuffer, TracksCurrentAndBackupSlots) {
 	mo_yanxi::double_buffer<std::vector<int>> buffer;
 
@@ -0,0 +1,66 @@
+export module mo_yanxi.font.glyph_cache;
+
+import std;
+
+export import mo_yanxi.graphic.msdf.sdf_cache;
+
+import mo_yanxi.font;
+
+namespace mo_yanxi::font{
+
+/**
+ * @brief Content hash of a font file, used to identify cache files independent of the file path.
+ */
+export
+[[nodiscard]] std::uint64_t hash_font_data(std::span<const std::byte> data) noexcept{
+	static constexpr std::uint64_t prime = 0x100000001b3ULL;
+	std::uint64_t h = 0xcbf29ce484222325ULL ^ data.size();
+
+	const auto word_count = data.size() / sizeof(std::uint64_t);
+	for(std::size_t i = 0; i < word_count; ++i){
+		std::uint64_t word;
+		std::memcpy(&word, data.data() + i * sizeof(std::uint64_t), sizeof(word));
+		h = (h ^ word) * prime;
+		h ^= h >> 29;
+	}
+
+	for(std::size_t i = word_count * sizeof(std::uint64_t); i < data.size(); ++i){
+		h = (h ^ std::to_integer<std::uint64_t>(data[i])) * prime;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+static_assert(sizeof(glyph_metrics) == 32);
+
+/**
+ * @brief Persistent MSDF cache of one font file at one atlas glyph size, keyed by glyph index.
+ *
+ * The metrics of every glyph are stored with it, glyphs without outline are recorded through `record_empty`.
+ */
+export
+struct persistent_glyph_cache : graphic::msdf::persistent_sdf_cache<glyph_metrics>{
+	using cached_glyph = graphic::msdf::cached_sdf<glyph_metrics>;
+
+	[[nodiscard]] persistent_glyph_cache(
+		const std::filesystem::path& directory,
+		std::span<const std::byte> font_data,
+		const glyph_size_type glyph_size) :
+		persistent_glyph_cache(directory, hash_font_data(font_data), glyph_size){
+	}
+
+private:
+	[[nodiscard]] persistent_glyph_cache(
+		const std::filesystem::path& directory,
+		const std::uint64_t font_hash,
+		const glyph_size_type glyph_size) :
+		persistent_sdf_cache(
+			directory / std::format("{:016X}.{}x{}.xgc", font_hash, glyph_size.x, glyph_size.y),
+			font_hash ^ (std::uint64_t{glyph_size.x} << 48 | std::uint64_t{glyph_size.y} << 32)){
+	}
+};
+
+}
@@ -487,15 +487,7 @@ public:
 		return chain_.end();
 	}
 
-	std::pair<font_face_handle*, glyph_index_t> find_glyph_of(const char_code code){
-		for(auto& chain : chain_){
-			const auto index = chain.index_of(code);
-			if(index != 0){
-				return {&chain, index};
-			}
-		}
-		return {&face(), face().index_of(code)};
-	}
+	std::pair<font_face_handle*, glyph_index_t> find_glyph_of(const char_code code);
 };
 
 export struct styled_font_face_view {
@@ -541,6 +533,61 @@ private:
 	}
 };
 
+/**
+ * @brief Codepoints mapped by a face, stored as 256 codepoint blocks of bits.
+ *
+ * Blocks without any codepoint share the empty block 0, so a CJK face costs a few KB.
+ */
+export struct codepoint_coverage{
+private:
+	static constexpr char_code codepoint_count = 0x110000;
+	static constexpr unsigned block_shift = 8;
+	static constexpr std::size_t block_count = codepoint_count >> block_shift;
+	using block = std::array<std::uint64_t, (1u << block_shift) / 64>;
+
+	std::vector<std::uint16_t> block_index_{};
+	std::vector<block> blocks_{};
+	//faces without a unicode charmap cannot be enumerated, every query is answered by the face itself
+	bool exact_{};
+
+public:
+	[[nodiscard]] codepoint_coverage() = default;
+
+	[[nodiscard]] explicit codepoint_coverage(FT_Face face){
+		if(!face || !face->charmap || face->charmap->encoding != FT_ENCODING_UNICODE) return;
+
+		block_index_.assign(block_count, 0);
+		blocks_.emplace_back();
+
+		FT_UInt gindex{};
+		for(FT_ULong code = FT_Get_First_Char(face, &gindex); gindex != 0; code = FT_Get_Next_Char(face, code, &gindex)){
+			if(code >= codepoint_count) continue;
+			auto& index = block_index_[code >> block_shift];
+			if(index == 0){
+				index = static_cast<std::uint16_t>(blocks_.size());
+				blocks_.emplace_back();
+			}
+			const auto bit = code & ((1u << block_shift) - 1);
+			blocks_[index][bit / 64] |= std::uint64_t{1} << (bit % 64);
+		}
+		exact_ = true;
+	}
+
+	/**
+	 * @return false only if the face definitely has no glyph for the codepoint
+	 */
+	[[nodiscard]] bool may_contain(const char_code code) const noexcept{
+		if(!exact_) return true;
+		if(code >= codepoint_count) return false;
+		const auto bit = code & ((1u << block_shift) - 1);
+		return (blocks_[block_index_[code >> block_shift]][bit / 64] >> (bit % 64)) & 1;
+	}
+
+	[[nodiscard]] bool is_exact() const noexcept{
+		return exact_;
+	}
+};
+
 /**
  * @brief 字体元数据 (Read-Only)
  * 仅包含文件数据，多线程共享，不包含任何 Handle。
@@ -553,6 +600,7 @@ private:
 	// 因为 Loading Thread 是单例/串行的，所以这里存放一个实例是安全的。
 	// 它的初始化在 Meta 创建时完成（通常在主线程），之后仅由 Loading Thread 读取/使用。
 	font_face_handle loader_handle_{};
+	codepoint_coverage coverage_{};
 
 public:
 	font_face_meta() = default;
@@ -561,6 +609,7 @@ public:
 		// 在 Meta 创建时，立即为加载线程初始化一个专用的 Handle
 		// 注意：这里传 nullptr 给 meta 参数，防止递归引用，且 loader handle 不需要回溯
 		loader_handle_ = font_face_handle(font_data_, nullptr);
+		coverage_ = codepoint_coverage{loader_handle_.get()};
 	}
 
 	explicit font_face_meta(const char* path) : font_face_meta(read_file(path)) {}
@@ -581,6 +630,10 @@ public:
 		return font_data_;
 	}
 
+	[[nodiscard]] const codepoint_coverage& coverage() const noexcept {
+		return coverage_;
+	}
+
 private:
 	static std::vector<std::byte> read_file(std::ifstream& file){
 		if (!file.is_open()) throw std::runtime_error("Failed to open font file");
@@ -606,6 +659,18 @@ private:
 	}
 };
 
+inline std::pair<font_face_handle*, glyph_index_t> font_face_view::find_glyph_of(const char_code code){
+	for(auto& chain : chain_){
+		//skip faces known to miss the codepoint without asking FreeType
+		if(const auto* meta = chain.get_source(); meta && !meta->coverage().may_contain(code)) continue;
+		const auto index = chain.index_of(code);
+		if(index != 0){
+			return {&chain, index};
+		}
+	}
+	return {&face(), face().index_of(code)};
+}
+
 export struct font_family {
 private:
 	static constexpr std::size_t Total = std::to_underlying(font_style::bold_italic) + 1;
@@ -10,6 +10,7 @@ export module mo_yanxi.font.manager;
 import std;
 
 export import mo_yanxi.font;
+import mo_yanxi.font.glyph_cache;
 
 import mo_yanxi.graphic.image_region.borrow;
 import mo_yanxi.graphic.image_region;
@@ -21,6 +22,8 @@ import mo_yanxi.heterogeneous;
 import mo_yanxi.cache;
 import mo_yanxi.cache.map;
 import mo_yanxi.static_string;
+import mo_yanxi.unicode;
+import mo_yanxi.log;
 
 namespace mo_yanxi::font{
 export
@@ -165,6 +168,122 @@ struct std::hash<mo_yanxi::font::font_metrics::key>{
 
 namespace mo_yanxi::font{
 
+/**
+ * @brief Progress of a glyph pre-warming pass, shared between the submitting thread and the loader workers.
+ */
+export
+struct glyph_prewarm_progress{
+	std::atomic_size_t total{};
+	/** @brief Glyphs whose load has finished, including the ones that failed or were dropped by a stopping loader. */
+	std::atomic_size_t completed{};
+	/** @brief Part of `completed` that never reached the atlas. */
+	std::atomic_size_t failed{};
+	std::atomic_bool cancelled{};
+
+	[[nodiscard]] float ratio() const noexcept{
+		const auto t = total.load(std::memory_order_relaxed);
+		if(t == 0) return 1.f;
+		return static_cast<float>(completed.load(std::memory_order_relaxed)) / static_cast<float>(t);
+	}
+
+	[[nodiscard]] bool finished() const noexcept{
+		return completed.load(std::memory_order_relaxed) >= total.load(std::memory_order_relaxed);
+	}
+
+	void cancel() noexcept{
+		cancelled.store(true, std::memory_order_relaxed);
+	}
+};
+
+/**
+ * @brief Sorted, deduplicated set of codepoints to pre-warm.
+ */
+export
+struct glyph_charset{
+private:
+	mutable std::vector<char32_t> codepoints_{};
+	mutable bool sorted_{true};
+
+	//whitespace, controls and values that are not scalar values never have a glyph worth generating
+	[[nodiscard]] static constexpr bool is_drawable_codepoint(const char32_t codepoint) noexcept{
+		if(codepoint <= U' ') return false;
+		if(codepoint >= U'\x7F' && codepoint <= U'\x9F') return false;
+		if(codepoint >= 0xD800 && codepoint <= 0xDFFF) return false;
+		return codepoint <= 0x10FFFF;
+	}
+
+	void drop_undrawable_from_(std::size_t first){
+		const auto [last, end] = std::ranges::remove_if(codepoints_.begin() + first, codepoints_.end(), [](char32_t c){
+			return !is_drawable_codepoint(c);
+		});
+		codepoints_.erase(last, end);
+		sorted_ = false;
+	}
+
+public:
+	void insert(char32_t codepoint){
+		if(!is_drawable_codepoint(codepoint)) return;
+		codepoints_.push_back(codepoint);
+		sorted_ = false;
+	}
+
+	/**
+	 * @brief Insert the closed range [first, last], clamped to the Unicode code space.
+	 */
+	void insert_range(char32_t first, char32_t last){
+		last = std::min<char32_t>(last, 0x10FFFF);
+		if(first > last) return;
+
+		const auto offset = codepoints_.size();
+		codepoints_.reserve(offset + (last - first) + 1);
+		for(auto c = first;; ++c){
+			codepoints_.push_back(c);
+			if(c == last) break;
+		}
+		drop_undrawable_from_(offset);
+	}
+
+	void append(std::u32string_view text){
+		const auto offset = codepoints_.size();
+		codepoints_.append_range(text);
+		drop_undrawable_from_(offset);
+	}
+
+	void append_utf8(std::string_view text){
+		const auto offset = codepoints_.size();
+		unicode::append_utf8_to_utf32(text, codepoints_);
+		drop_undrawable_from_(offset);
+	}
+
+	[[nodiscard]] std::span<const char32_t> codepoints() const{
+		if(!sorted_){
+			std::ranges::sort(codepoints_);
+			const auto [last, end] = std::ranges::unique(codepoints_);
+			codepoints_.erase(last, end);
+			sorted_ = true;
+		}
+		return codepoints_;
+	}
+
+	[[nodiscard]] std::size_t size() const{
+		return codepoints().size();
+	}
+};
+
+/**
+ * @brief A glyph queued to the async glyph worker, filled with its borrow once it lands.
+ *
+ * Layouts that laid the glyph out without texture keep their hold until the relayout replaces them,
+ * so the landed region cannot be evicted before that relayout borrows it again.
+ */
+export
+struct glyph_landing{
+	glyph_borrow borrow{};
+};
+
+export
+using glyph_landing_hold = std::shared_ptr<const glyph_landing>;
+
 struct resolve_tls_entry{
 	resolve_key key{};
 	resolved_codepoint value{};
@@ -175,7 +294,8 @@ struct font_global_cache{
 	using tls_lru_cache_t = lru_cache<family_style_key, std::span<font_face_handle>, 8>;
 	tls_lru_cache_t family;
 	mapped_lru_cache<font_metrics::key, font_metrics::val> metrics;
-	static constexpr std::size_t resolve_hot_capacity = 128;
+	//direct mapped, sized so mixed script text (latin + CJK + emoji fallbacks) does not keep evicting itself
+	static constexpr std::size_t resolve_hot_capacity = 1024;
 	std::array<resolve_tls_entry, resolve_hot_capacity> resolve_hot{};
 
 	auto get_metrics(const font_metrics::key key){
@@ -238,14 +358,30 @@ private:
     mutable std::mutex storage_mtx_;
     global_storage_t handle_storage_;
 
+	std::filesystem::path glyph_cache_directory_{};
+	std::mutex glyph_cache_mtx_{};
+	//shared with the queued loads recording into them, so replacing the directory never frees a cache in use
+	std::unordered_map<const font_face_meta*, std::shared_ptr<persistent_glyph_cache>> glyph_caches_{};
+
+	/** @brief Bumped every time a batch of deferred glyphs is registered, starts from 1 so 0 can mean "nothing pending". */
+	std::atomic_uint64_t glyph_epoch_{1};
+	std::mutex pending_glyph_mtx_{};
+	std::condition_variable_any pending_glyph_cond_{};
+	std::unordered_map<atlas_glyph_key, std::shared_ptr<glyph_landing>> pending_glyph_landings_{};
+	std::vector<atlas_glyph_key> pending_glyph_queue_{};
+	//read by layouts on any thread, glyph_worker_ itself is only touched by set_async_glyph_generation
+	std::atomic_bool async_glyphs_enabled_{false};
+	//must be the last member, the worker references everything above
+	std::jthread glyph_worker_{};
+
     using tls_lru_cache_t = lru_cache<family_style_key, std::span<font_face_handle>, 8>;
 
 	static tls_lru_cache_t& get_thread_local_lru(){
 		return cache.family;
 	}
 
-	[[nodiscard]] static std::string make_glyph_region_name(const font_face_meta* meta, glyph_index_t index){
-		return std::format("ft.{}.{:08X}", std::bit_cast<std::uintptr_t>(meta), index);
+	[[nodiscard]] static constexpr graphic::image_region_key make_glyph_region_key(const font_face_meta* meta, glyph_index_t index) noexcept{
+		return {meta, index};
 	}
 
 	[[nodiscard]] static std::string_view format(glyph_size_identity& identity/*use lr to make sure no dangling*/){
@@ -254,6 +390,19 @@ private:
 		return std::string_view{reinterpret_cast<const char *>(&identity), sizeof(identity)};
 	}
 
+	[[nodiscard]] std::shared_ptr<persistent_glyph_cache> glyph_cache_of_(const font_face_meta* meta){
+		if(meta == nullptr) return nullptr;
+
+		std::lock_guard _{glyph_cache_mtx_};
+		if(glyph_cache_directory_.empty()) return nullptr;
+
+		auto& cache_slot = glyph_caches_[meta];
+		if(!cache_slot){
+			cache_slot = std::make_shared<persistent_glyph_cache>(glyph_cache_directory_, meta->data(), atlas_glyph_size);
+		}
+		return cache_slot;
+	}
+
 	[[nodiscard]] static resolved_codepoint build_resolved_codepoint(
 		const font_family* family,
 		font_style requested_style,
@@ -373,43 +522,299 @@ public:
 	}
 
 	[[nodiscard]] std::optional<glyph_borrow> borrow_glyph_region(font_face_handle& handle, glyph_index_t gid){
+		return borrow_glyph_region_(handle, gid, nullptr);
+	}
+
+	/**
+	 * @brief Non-blocking variant of `borrow_glyph_region`.
+	 *
+	 * With async generation enabled, a glyph that is not in the atlas yet is queued to the glyph worker and
+	 * `pending` receives its landing, the caller should lay it out with its metrics only, keep the hold and retry
+	 * once `glyph_epoch` changes. Otherwise this is identical to `borrow_glyph_region`.
+	 */
+	[[nodiscard]] std::optional<glyph_borrow> try_borrow_glyph_region(font_face_handle& handle, glyph_index_t gid, glyph_landing_hold& pending){
+		pending = nullptr;
+		if(!is_async_glyph_generation()){
+			return borrow_glyph_region_(handle, gid, nullptr);
+		}
+
+		const atlas_glyph_key key{handle.get_source(), gid};
+
+		bool drawable = true;
+		glyph_drawable_cache_.if_contains(key, [&](glyph_drawable_cache_t::value_type& value){
+			drawable = value.second;
+		});
+		if(!drawable) return std::nullopt;
+
+		if(auto borrowed = page().find<glyph_texture_region>(make_glyph_region_key(key.meta, gid))){
+			return std::move(*borrowed);
+		}
+
+		{
+			std::lock_guard _{pending_glyph_mtx_};
+			//checked again under the lock, disabling clears the queue under it after the flag is reset
+			if(is_async_glyph_generation()){
+				auto& landing = pending_glyph_landings_[key];
+				if(!landing){
+					landing = std::make_shared<glyph_landing>();
+					pending_glyph_queue_.push_back(key);
+					pending_glyph_cond_.notify_one();
+				}
+				pending = landing;
+				return std::nullopt;
+			}
+		}
+		return borrow_glyph_region_(handle, gid, nullptr);
+	}
+
+	[[nodiscard]] std::uint64_t glyph_epoch() const noexcept{
+		return glyph_epoch_.load(std::memory_order_acquire);
+	}
+
+	[[nodiscard]] bool is_async_glyph_generation() const noexcept{
+		return async_glyphs_enabled_.load(std::memory_order_acquire);
+	}
+
+	/**
+	 * @brief Move glyph rasterization and atlas allocation of missing glyphs to a background worker.
+	 *
+	 * @warning Must be disabled (which joins the worker) before the font page is destroyed.
+	 */
+	void set_async_glyph_generation(bool enable){
+		if(enable == is_async_glyph_generation()) return;
+
+		if(enable){
+			glyph_worker_ = std::jthread{[this](std::stop_token stop_token){
+				glyph_worker_func_(std::move(stop_token));
+			}};
+			async_glyphs_enabled_.store(true, std::memory_order_release);
+		}else{
+			async_glyphs_enabled_.store(false, std::memory_order_release);
+			glyph_worker_.request_stop();
+			glyph_worker_.join();
+			glyph_worker_ = {};
+
+			{
+				std::lock_guard _{pending_glyph_mtx_};
+				pending_glyph_queue_.clear();
+				pending_glyph_landings_.clear();
+			}
+			//layouts still waiting for the worker relayout and generate their glyphs directly
+			glyph_epoch_.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	/**
+	 * @brief Queue the MSDF generation of every glyph used by `codepoints` in one pass.
+	 *
+	 * Generation itself runs on the image loader cpu workers in parallel, this call only resolves the glyphs and
+	 * allocates their atlas regions, so it is safe (and recommended) to invoke it from a background task.
+	 *
+	 * @param progress optional progress sink, `total` is known once this function returns and every glyph is
+	 * eventually counted as `completed`, even when its generation fails or the loader stops.
+	 * @return borrows of the prewarmed glyphs, the regions cannot be evicted or cleaned up while they are held.
+	 */
+	[[nodiscard]] std::vector<glyph_borrow> prewarm_glyphs(
+		const font_family* family,
+		font_style style,
+		std::span<const char32_t> codepoints,
+		const std::shared_ptr<glyph_prewarm_progress>& progress = nullptr){
+
+		std::vector<resolved_glyph_entry> glyphs{};
+		glyphs.reserve(codepoints.size());
+		for(const auto codepoint : codepoints){
+			if(auto resolved = resolve_codepoint(family, style, codepoint); resolved && resolved.glyph_index != 0){
+				glyphs.push_back(resolved);
+			}
+		}
+
+		std::ranges::sort(glyphs, {}, [](const resolved_glyph_entry& e){
+			return std::pair{static_cast<const void*>(e.face), e.glyph_index};
+		});
+		const auto [last, end] = std::ranges::unique(glyphs, {}, [](const resolved_glyph_entry& e){
+			return std::pair{static_cast<const void*>(e.face), e.glyph_index};
+		});
+		glyphs.erase(last, end);
+
+		if(progress){
+			progress->total.fetch_add(glyphs.size(), std::memory_order_relaxed);
+		}
+
+		std::vector<glyph_borrow> borrows{};
+		borrows.reserve(glyphs.size());
+		for(std::size_t i = 0; i < glyphs.size(); ++i){
+			const auto& entry = glyphs[i];
+			if(progress && progress->cancelled.load(std::memory_order_relaxed)){
+				progress->completed.fetch_add(1, std::memory_order_relaxed);
+				continue;
+			}
+			try{
+				if(auto borrowed = borrow_glyph_region_(*entry.face, entry.glyph_index, progress)){
+					borrows.push_back(std::move(*borrowed));
+				}
+			} catch(const graphic::image_loader_stopped&){
+				//the glyph being registered was counted by its ticket, the rest never reach the loader
+				if(progress){
+					progress->cancelled.store(true, std::memory_order_relaxed);
+					progress->failed.fetch_add(glyphs.size() - i - 1, std::memory_order_relaxed);
+					progress->completed.fetch_add(glyphs.size() - i - 1, std::memory_order_relaxed);
+				}
+				break;
+			}
+		}
+		return borrows;
+	}
+
+	[[nodiscard]] std::vector<glyph_borrow> prewarm_glyphs(
+		const font_family* family,
+		font_style style,
+		const glyph_charset& charset,
+		const std::shared_ptr<glyph_prewarm_progress>& progress = nullptr){
+		return prewarm_glyphs(family, style, charset.codepoints(), progress);
+	}
+
+private:
+	/**
+	 * @brief Completes one glyph of a prewarm pass when the last copy of its load is gone, whether it was uploaded,
+	 * failed on a worker or was discarded by a stopping loader.
+	 */
+	struct prewarm_ticket{
+		std::shared_ptr<glyph_prewarm_progress> progress;
+		std::atomic_bool generated{};
+
+		~prewarm_ticket(){
+			if(!generated.load(std::memory_order_relaxed)) progress->failed.fetch_add(1, std::memory_order_relaxed);
+			progress->completed.fetch_add(1, std::memory_order_relaxed);
+		}
+	};
+
+	void glyph_worker_func_(std::stop_token stop_token){
+		//font face handles are not thread safe, the worker owns its own set
+		std::unordered_map<const font_face_meta*, font_face_handle> handles{};
+		std::vector<atlas_glyph_key> batch{};
+
+		while(true){
+			{
+				std::unique_lock lk{pending_glyph_mtx_};
+				if(!pending_glyph_cond_.wait(lk, stop_token, [this]{ return !pending_glyph_queue_.empty(); })){
+					return;
+				}
+				batch.swap(pending_glyph_queue_);
+			}
+
+			for(const auto& key : batch){
+				if(stop_token.stop_requested()) return;
+				if(key.meta == nullptr) continue;
+
+				auto& handle = handles.try_emplace(key.meta, key.meta->data(), key.meta).first->second;
+				std::optional<glyph_borrow> borrowed{};
+				try{
+					borrowed = borrow_glyph_region_(handle, key.glyph_index, nullptr);
+				} catch(const graphic::image_loader_stopped&){
+					return;
+				} catch(const std::exception& e){
+					log::warn({"Font"}, "failed to generate glyph {}: {}", key.glyph_index, e.what());
+				}
+
+				//later requests find the region in the page, only the layouts waiting so far need the landing
+				std::shared_ptr<glyph_landing> landing{};
+				{
+					std::lock_guard _{pending_glyph_mtx_};
+					if(const auto itr = pending_glyph_landings_.find(key); itr != pending_glyph_landings_.end()){
+						landing = std::move(itr->second);
+						pending_glyph_landings_.erase(itr);
+					}
+				}
+				if(landing && borrowed){
+					landing->borrow = std::move(*borrowed);
+				}
+			}
+
+			batch.clear();
+			glyph_epoch_.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	[[nodiscard]] std::optional<glyph_borrow> borrow_glyph_region_(
+		font_face_handle& handle, glyph_index_t gid,
+		const std::shared_ptr<glyph_prewarm_progress>& progress){
 		const atlas_glyph_key key{handle.get_source(), gid};
+		const auto mark_ready = [&]{
+			if(progress) progress->completed.fetch_add(1, std::memory_order_relaxed);
+		};
 
 		bool* cached_drawable = nullptr;
 		glyph_drawable_cache_.if_contains(key, [&](glyph_drawable_cache_t::value_type& value){
 			cached_drawable = &value.second;
 		});
 		if(cached_drawable != nullptr && !*cached_drawable){
+			mark_ready();
 			return std::nullopt;
 		}
 
-		auto name = make_glyph_region_name(handle.get_source(), gid);
-		if(auto* region = page().find(name)){
-			if(auto borrowed = region->make_universal_borrow<glyph_texture_region>()){
-				return std::move(*borrowed);
-			}
+		const auto region_key = make_glyph_region_key(handle.get_source(), gid);
+		if(auto borrowed = page().find<glyph_texture_region>(region_key)){
+			mark_ready();
+			return std::move(*borrowed);
 		}
 
-		auto acquired = handle.obtain(gid, atlas_glyph_size);
-		if(!acquired.has_drawable_glyph()){
-			glyph_drawable_cache_.try_emplace(key, false);
-			return std::nullopt;
+		auto disk_cache = glyph_cache_of_(handle.get_source());
+		graphic::sdf_load load{};
+		std::shared_ptr<prewarm_ticket> ticket{};
+
+		if(auto cached = disk_cache ? disk_cache->find(gid) : std::nullopt){
+			if(!cached->drawable()){
+				glyph_drawable_cache_.try_emplace(key, false);
+				mark_ready();
+				return std::nullopt;
+			}
+
+			load.extent = cached->sdf.extent;
+			load.prov_levels = cached->sdf.level_count;
+			load.generator = cached->sdf;
+			mark_ready();
+		}else{
+			auto acquired = handle.obtain(gid, atlas_glyph_size);
+			if(!acquired.has_drawable_glyph()){
+				if(disk_cache) disk_cache->record_empty(gid, acquired.metrics);
+				glyph_drawable_cache_.try_emplace(key, false);
+				mark_ready();
+				return std::nullopt;
+			}
+
+			auto crop = acquired.generator.crop(gid);
+			crop.meta = handle.get_source();
+			load.generator = std::move(crop);
+			load.extent = acquired.extent();
+
+			if(disk_cache){
+				disk_cache->record_begin(gid, acquired.extent(), load.prov_levels, acquired.metrics);
+			}
+
+			if(progress){
+				ticket = std::make_shared<prewarm_ticket>(progress);
+			}
+
+			if(disk_cache || ticket){
+				load.on_generated = [disk_cache, gid, ticket](std::uint32_t level, const graphic::bitmap& generated){
+					if(disk_cache) disk_cache->record_level(gid, level, generated.to_byte_span());
+					if(ticket && level == 0) ticket->generated.store(true, std::memory_order_relaxed);
+				};
+			}
 		}
 
-		auto crop = acquired.generator.crop(gid);
-		crop.meta = handle.get_source();
-		auto load = graphic::sdf_load{
-			std::move(crop),
-			acquired.extent()
-		};
-		auto reg = page().register_named_region(std::move(name), graphic::image_load_description{std::move(load)});
+		auto reg = page().register_keyed_region(region_key, graphic::image_load_description{std::move(load)});
 		glyph_drawable_cache_.try_emplace(key, true);
+		//someone else registered the glyph first, our load was dropped without running
+		if(ticket && !reg.inserted) ticket->generated.store(true, std::memory_order_relaxed);
 
 		auto borrowed = reg.region.make_universal_borrow<glyph_texture_region>();
 		assert(borrowed.has_value());
 		return std::move(*borrowed);
 	}
 
+public:
+
 	[[nodiscard]] glyph_metrics get_glyph_metrics_exact(font_face_handle& handle, const glyph_identity key){
 		if(auto mtr_cache = cache.get_metrics({&handle, key})){
 			return mtr_cache->metrics;
@@ -621,6 +1026,35 @@ public:
 		return {final_view, satisfy_bold, satisfy_italic};
 	}
 
+	/**
+	 * @brief Enable the persistent MSDF cache, glyphs generated afterwards are stored per font file under this directory.
+	 *
+	 * Loads already queued from the previous caches hold them (and their mappings) until they are uploaded.
+	 */
+	void set_glyph_cache_directory(std::filesystem::path directory){
+		std::lock_guard _{glyph_cache_mtx_};
+		glyph_cache_directory_ = std::move(directory);
+		glyph_caches_.clear();
+	}
+
+	/**
+	 * @brief Write newly generated glyphs to the persistent cache.
+	 *
+	 * @warning Cached glyphs are uploaded directly from the mapped files, the image loader must be idle.
+	 */
+	void save_glyph_caches() noexcept{
+		std::lock_guard _{glyph_cache_mtx_};
+		for(auto& cache_file : glyph_caches_ | std::views::values){
+			try{
+				if(!cache_file->save()){
+					log::warn({"Font"}, "failed to save glyph cache {}", cache_file->path().string());
+				}
+			} catch(const std::exception& e){
+				log::warn({"Font"}, "failed to save glyph cache {}: {}", cache_file->path().string(), e.what());
+			}
+		}
+	}
+
 	void UNCHECKED_clear_this_thread_font_face_cache() noexcept {
 		get_thread_local_lru().clear();
 		cache.clear_resolved();
@@ -25,12 +25,18 @@ export using buffer_ptr = std::unique_ptr<hb_buffer_t, hb_deleter<hb_buffer_dest
 export using blob_ptr   = std::unique_ptr<hb_blob_t,   hb_deleter<hb_blob_destroy>>;
 export using face_ptr   = std::unique_ptr<hb_face_t,   hb_deleter<hb_face_destroy>>;
 export using font_ptr   = std::unique_ptr<hb_font_t,   hb_deleter<hb_font_destroy>>;
+export using set_ptr    = std::unique_ptr<hb_set_t,    hb_deleter<hb_set_destroy>>;
 
 export
 [[nodiscard]] inline auto make_buffer() -> buffer_ptr {
 	return buffer_ptr{hb_buffer_create()};
 }
 
+export
+[[nodiscard]] inline auto make_set() -> set_ptr {
+	return set_ptr{hb_set_create()};
+}
+
 export
 [[nodiscard]] inline auto make_face(hb_blob_t* blob, unsigned int index) -> face_ptr {
 	return face_ptr{hb_face_create(blob, index)};
@@ -2,6 +2,7 @@ module;
 
 #include <hb.h>
 #include <hb-ft.h>
+#include <hb-ot.h>
 #include <freetype/freetype.h>
 #include <cassert>
 #include <mo_yanxi/adapted_attributes.hpp>
@@ -71,6 +72,122 @@ struct hb_font_cache_key{
 	constexpr bool operator==(const hb_font_cache_key&) const noexcept = default;
 };
 
+/**
+ * @brief Nominal glyphs and advances of the ASCII range of one face at one size.
+ *
+ * Runs made of these codepoints skip HarfBuzz unless they contain a pair the font shapes differently
+ * (kerning, ligatures, contextual alternates), such pairs are found once by shaping every printable pair.
+ *
+ * Substitutions spanning more than two characters cannot be found from pairs, they are taken from the GSUB lookups
+ * of the features HarfBuzz applies by default: a codepoint used by a contextual lookup always needs shaping, and
+ * three consecutive codepoints used by other lookups (e.g. the components of `www` or `-->`) do as well.
+ */
+struct ascii_shaping_table{
+	static constexpr char32_t first_printable = U' ';
+	static constexpr char32_t last_printable = U'~';
+	static constexpr std::size_t printable_count = last_printable - first_printable + 1;
+	static constexpr std::size_t code_count = 128;
+
+	std::array<font::glyph_index_t, code_count> glyphs{};
+	std::array<hb_position_t, code_count> advances{};
+	std::bitset<code_count> supported{};
+	std::bitset<printable_count * printable_count> shaped_pairs{};
+	std::bitset<code_count> contextual{};
+	std::bitset<code_count> substituted{};
+
+	[[nodiscard]] static constexpr bool is_printable(const char32_t c) noexcept{
+		return c >= first_printable && c <= last_printable;
+	}
+
+	[[nodiscard]] bool is_pair_shaped(const char32_t prev, const char32_t cur) const noexcept{
+		if(!is_printable(prev) || !is_printable(cur)) return false;
+		return shaped_pairs[(prev - first_printable) * printable_count + (cur - first_printable)];
+	}
+
+	void build(hb_font_t* font){
+		for(char32_t c = 0; c < code_count; ++c){
+			//line controls never reach the glyph output, any glyph will do
+			const bool is_line_control = c == U'\t' || c == U'\n' || c == U'\r';
+			if(!is_printable(c) && !is_line_control) continue;
+
+			hb_codepoint_t gid{};
+			if(!hb_font_get_nominal_glyph(font, c, &gid) && !is_line_control) continue;
+			glyphs[c] = gid;
+			advances[c] = hb_font_get_glyph_h_advance(font, gid);
+			supported.set(c);
+		}
+
+		collect_substitutions(hb_font_get_face(font));
+
+		//every pair followed by a line feed, so a deviating glyph can be attributed to exactly one pair
+		std::u32string pairs;
+		pairs.reserve(printable_count * printable_count * 3);
+		for(char32_t a = first_printable; a <= last_printable; ++a){
+			for(char32_t b = first_printable; b <= last_printable; ++b){
+				pairs.append({a, b, U'\n'});
+			}
+		}
+
+		const auto buffer = font::hb::make_buffer();
+		hb_buffer_add_utf32(buffer.get(), reinterpret_cast<const std::uint32_t*>(pairs.data()), static_cast<int>(pairs.size()), 0, -1);
+		hb_buffer_set_direction(buffer.get(), HB_DIRECTION_LTR);
+		hb_buffer_guess_segment_properties(buffer.get());
+		::hb_shape(font, buffer.get(), nullptr, 0);
+
+		unsigned int len;
+		const hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(buffer.get(), &len);
+		const hb_glyph_position_t* pos = hb_buffer_get_glyph_positions(buffer.get(), &len);
+		for(unsigned int i = 0; i < len; ++i){
+			const auto cluster = infos[i].cluster;
+			if(cluster % 3 == 2) continue;
+			const auto c = pairs[cluster];
+
+			const bool deviates =
+				!supported[c] ||
+				infos[i].codepoint != glyphs[c] ||
+				pos[i].x_advance != advances[c] || pos[i].y_advance != 0 ||
+				pos[i].x_offset != 0 || pos[i].y_offset != 0 ||
+				(i + 1 < len && infos[i + 1].cluster == cluster);
+			if(deviates) shaped_pairs.set(cluster / 3);
+		}
+	}
+
+private:
+	void collect_substitutions(hb_face_t* face){
+		static constexpr std::array default_features{
+				HB_TAG('r', 'v', 'r', 'n'), HB_TAG('c', 'c', 'm', 'p'), HB_TAG('l', 'o', 'c', 'l'),
+				HB_TAG('r', 'l', 'i', 'g'), HB_TAG('r', 'c', 'l', 't'), HB_TAG('c', 'a', 'l', 't'),
+				HB_TAG('c', 'l', 'i', 'g'), HB_TAG('l', 'i', 'g', 'a'), HB_TAG_NONE
+			};
+
+		const auto lookups = font::hb::make_set();
+		hb_ot_layout_collect_lookups(face, HB_OT_TAG_GSUB, nullptr, nullptr, default_features.data(), lookups.get());
+
+		const auto before = font::hb::make_set();
+		const auto input = font::hb::make_set();
+		const auto after = font::hb::make_set();
+		for(hb_codepoint_t lookup = HB_SET_VALUE_INVALID; hb_set_next(lookups.get(), &lookup);){
+			hb_set_clear(before.get());
+			hb_set_clear(input.get());
+			hb_set_clear(after.get());
+			hb_ot_layout_lookup_collect_glyphs(face, HB_OT_TAG_GSUB, lookup, before.get(), input.get(), after.get(), nullptr);
+
+			const bool has_context = !hb_set_is_empty(before.get()) || !hb_set_is_empty(after.get());
+			for(char32_t c = first_printable; c <= last_printable; ++c){
+				if(!supported[c]) continue;
+				const auto gid = glyphs[c];
+				if(has_context){
+					if(hb_set_has(before.get(), gid) || hb_set_has(input.get(), gid) || hb_set_has(after.get(), gid)){
+						contextual.set(c);
+					}
+				}else if(hb_set_has(input.get(), gid)){
+					substituted.set(c);
+				}
+			}
+		}
+	}
+};
+
 struct persistent_run_state{
 	std::optional<ul_start_info> active_ul_start;
 	std::optional<wrap_start_info> active_wrap_start;
@@ -87,10 +204,12 @@ struct layout_ctx_base{
 protected:
 	font::font_manager* manager_{font::default_font_manager};
 	lru_cache<hb_font_cache_key, font::hb::font_ptr, 8> hb_cache_;
+	lru_cache<hb_font_cache_key, ascii_shaping_table, 8> ascii_cache_;
 	font::hb::buffer_ptr hb_buffer_{font::hb::make_buffer()};
 	std::vector<hb_feature_t> feature_stack_{};
 	layout_state_t state_{};
 	indicator_cache cached_indicator_{};
+	std::vector<font::glyph_landing_hold> pending_glyph_holds_{};
 
 	layout_buffer layout_buffer_{};
 
@@ -140,6 +259,57 @@ public:
 	}
 
 protected:
+	[[nodiscard]] const ascii_shaping_table& get_ascii_shaping_table(
+		font::font_face_handle* face,
+		font::glyph_size_type snapped_size,
+		hb_font_t* hb_font){
+		const hb_font_cache_key key{face, snapped_size};
+		if(const auto ptr = ascii_cache_.get(key)){
+			return *ptr;
+		}
+		ascii_shaping_table table{};
+		table.build(hb_font);
+		ascii_cache_.put(key, std::move(table));
+		return *ascii_cache_.get(key);
+	}
+
+	/**
+	 * @brief Fill the glyphs of an ASCII run into the (unshaped) hb buffer directly when HarfBuzz would not change them.
+	 *
+	 * @return false if the run needs shaping
+	 */
+	bool try_fill_ascii_run(
+		std::u32string_view text, typst_szt start, typst_szt length,
+		font::font_face_handle* face, font::glyph_size_type snapped_size, hb_font_t* hb_font){
+		if(state_.target_hb_dir != HB_DIRECTION_LTR || !feature_stack_.empty()) return false;
+
+		const auto run = text.substr(start, length);
+		if(!std::ranges::all_of(run, [](const char32_t c){ return c < ascii_shaping_table::code_count; })) return false;
+
+		const auto& table = this->get_ascii_shaping_table(face, snapped_size, hb_font);
+		char32_t prev{};
+		unsigned substituted_streak{};
+		for(const auto c : run){
+			if(!table.supported[c] || table.contextual[c] || table.is_pair_shaped(prev, c)) return false;
+			substituted_streak = table.substituted[c] ? substituted_streak + 1 : 0;
+			if(substituted_streak >= 3) return false;
+			prev = c;
+		}
+
+		unsigned int len;
+		hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(hb_buffer_.get(), &len);
+		hb_glyph_position_t* pos = hb_buffer_get_glyph_positions(hb_buffer_.get(), &len);
+		if(len != run.size()) return false;
+
+		for(unsigned int i = 0; i < len; ++i){
+			const auto c = text[infos[i].cluster];
+			infos[i].codepoint = table.glyphs[c];
+			pos[i] = {.x_advance = table.advances[c]};
+		}
+		hb_buffer_set_content_type(hb_buffer_.get(), HB_BUFFER_CONTENT_TYPE_GLYPHS);
+		return true;
+	}
+
 	[[nodiscard]] FORCE_INLINE inline math::vec2 move_pen(math::vec2 pen, math::vec2 advance) const noexcept{
 		if(state_.target_hb_dir == HB_DIRECTION_LTR){
 			pen.x += advance.x;
@@ -529,6 +699,7 @@ private:
 
 		state_.reset();
 		layout_buffer_.clear();
+		pending_glyph_holds_.clear();
 
 		if constexpr(enable_dynamic_rich_text_state){
 			rich_text_state& rtstate = rich_text_state_;
@@ -613,7 +784,9 @@ private:
 				auto index = resolved.glyph_index;
 				font::glyph_identity id{index, snapped_base_size};
 				const auto m = manager_->get_glyph_metrics_exact(*face, id);
-				auto opt_borrow = manager_->borrow_glyph_region(*face, index);
+				font::glyph_landing_hold pending{};
+				auto opt_borrow = manager_->try_borrow_glyph_region(*face, index, pending);
+				if(pending) pending_glyph_holds_.push_back(std::move(pending));
 				font::glyph g = opt_borrow ? font::glyph{std::move(*opt_borrow), m} : font::glyph{m};
 				const auto advance = m.advance * base_scale_factor;
 				math::vec2 adv{};
@@ -657,8 +830,10 @@ private:
 		hb_buffer_guess_segment_properties(hb_buffer_.get());
 
 		const run_metrics metrics = this->calculate_metrics(config_, face);
-		::hb_shape(this->get_hb_font(&face, metrics.snapped_size), hb_buffer_.get(), feature_stack_.data(),
-			(unsigned int)feature_stack_.size());
+		hb_font_t* hb_font = this->get_hb_font(&face, metrics.snapped_size);
+		if(!this->try_fill_ascii_run(full_text.get_text(), start, length, &face, metrics.snapped_size, hb_font)){
+			::hb_shape(hb_font, hb_buffer_.get(), feature_stack_.data(), (unsigned int)feature_stack_.size());
+		}
 
 		unsigned int len;
 		hb_glyph_info_t* infos = hb_buffer_get_glyph_infos(hb_buffer_.get(), &len);
@@ -836,7 +1011,9 @@ private:
 
 			const font::glyph_identity glyph_id{gid, metrics.snapped_size};
 			const auto exact_metrics = manager_->get_glyph_metrics_exact(face, glyph_id);
-			auto opt_borrow = manager_->borrow_glyph_region(face, gid);
+			font::glyph_landing_hold pending{};
+			auto opt_borrow = manager_->try_borrow_glyph_region(face, gid, pending);
+			if(pending) pending_glyph_holds_.push_back(std::move(pending));
 			const font::glyph loaded_glyph = opt_borrow
 				? font::glyph{std::move(*opt_borrow), exact_metrics}
 				: font::glyph{exact_metrics};
@@ -1342,8 +1519,12 @@ public:
 	
 
 	void layout(const tokenized_text_view& full_text, const layout_config& config_, glyph_layout& layout_ref){
+		//sampled before any glyph is requested, so a glyph landing mid-layout still expires the result
+		const auto glyph_epoch = manager_->glyph_epoch();
 		this->initialize_state(full_text, config_);
 
+		//the glyphs the previous result waited for must stay resident until this layout has borrowed them
+		const auto previous_holds = std::move(layout_ref.pending_glyph_holds);
 		layout_ref.clear();
 		layout_ref.direction = this->get_actual_direction(config_);
 
@@ -1368,6 +1549,13 @@ public:
 		layout_ref.is_exhausted = result;
 
 		this->finalize(layout_ref);
+
+		if(!pending_glyph_holds_.empty()){
+			layout_ref.pending_glyph_source = manager_;
+			layout_ref.pending_glyph_epoch = glyph_epoch;
+			layout_ref.pending_glyph_holds = std::move(pending_glyph_holds_);
+			pending_glyph_holds_.clear();
+		}
 	}
 
     void layout(const tokenized_text_view& full_text, const layout_config& config_, glyph_layout_draw_only& draw_only){
@@ -95,6 +95,10 @@ export struct line{
 
 	layout_rect rect;
 	math::vec2 start_pos;
+	/**
+	 * @brief Added to the cluster_index of the clusters of this line, lets a stitched layout move lines without rewriting their clusters.
+	 */
+	typst_szt text_offset{};
 
 	[[nodiscard]] constexpr line_align_result calculate_alignment(
 		math::vec2 extent,
@@ -151,11 +155,41 @@ export struct glyph_layout_draw_only{
 	std::vector<line> lines;
 	math::vec2 extent;
 
+	/**
+	 * @brief Set when some glyph textures were still being generated during layout.
+	 *
+	 * Those glyphs are laid out with their exact metrics but have no texture, relayout once the epoch moves on.
+	 */
+	const font::font_manager* pending_glyph_source{};
+	std::uint64_t pending_glyph_epoch{};
+	/** @brief Keeps the landed glyphs resident until the relayout has borrowed them. */
+	std::vector<font::glyph_landing_hold> pending_glyph_holds{};
+
 	void clear() noexcept{
 		elems.clear();
 		lines.clear();
 		extent = {};
+		pending_glyph_source = {};
+		pending_glyph_epoch = {};
+		pending_glyph_holds.clear();
+	}
+
+	[[nodiscard]] bool has_pending_glyphs() const noexcept{
+		return pending_glyph_source != nullptr;
 	}
+
+	[[nodiscard]] bool is_pending_glyphs_landed() const noexcept{
+		return pending_glyph_source != nullptr && pending_glyph_source->glyph_epoch() != pending_glyph_epoch;
+	}
+};
+
+/**
+ * @brief Lines of a glyph_layout replaced by an incremental update, `line` is the first one in the updated layout.
+ */
+export struct line_change{
+	typst_szt line;
+	typst_szt removed;
+	typst_szt inserted;
 };
 
 export struct glyph_layout : glyph_layout_draw_only{
@@ -3,6 +3,7 @@ export module mo_yanxi.typesetting.segmented_layout;
 import std;
 import mo_yanxi.typesetting;
 import mo_yanxi.typesetting.rich_text;
+import mo_yanxi.font.manager;
 import mo_yanxi.math.vector2;
 
 namespace mo_yanxi::typesetting {
@@ -30,16 +31,46 @@ void replace_range(std::vector<T>& vec,
 	}
 }
 
+/**
+ * @brief Amount of each glyph_layout vector owned by a segment inside the stitched layout.
+ */
+export struct layout_footprint{
+	std::uint32_t lines{};
+	std::uint32_t elems{};
+	std::uint32_t clusters{};
+	std::uint32_t underlines{};
+	std::uint32_t wrap_frames{};
+
+	constexpr layout_footprint& operator+=(const layout_footprint& other) noexcept{
+		lines += other.lines;
+		elems += other.elems;
+		clusters += other.clusters;
+		underlines += other.underlines;
+		wrap_frames += other.wrap_frames;
+		return *this;
+	}
+
+	constexpr bool operator==(const layout_footprint&) const noexcept = default;
+};
+
 export struct text_segment {
     std::uint32_t start_pos{};
     std::uint32_t end_pos{};
     bool is_dirty{true};
+	// 已被编辑移除的段落，仅用于在下次拼接时移除其旧的排版结果
+	bool is_removed{false};
+
+	layout_footprint footprint{};
 
-    // 局部的排版结果（内部坐标从 0,0 起算）
-    glyph_layout local_layout{};
+	// 首行基线在局部/全局排版中的位置，以及到下一段落首行基线的距离
+	float local_baseline{};
+	float baseline{};
+	float advance{};
+	math::vec2 local_extent{};
 
-    // 组装后的全局偏移量（例如该段落左上角在整个文档中的坐标）
-    math::vec2 global_offset{};
+	const font::font_manager* pending_glyph_source{};
+	std::uint64_t pending_glyph_epoch{};
+	std::vector<font::glyph_landing_hold> pending_glyph_holds{};
 
     [[nodiscard]] constexpr std::uint32_t length() const noexcept {
         return end_pos - start_pos;
@@ -53,40 +84,141 @@ export struct text_segment {
     }
 };
 
+/**
+ * @brief Raw text laid out by segmented_layout_manager that is not held in a tokenized_text, e.g. a piece table.
+ */
+export struct paragraph_source{
+	virtual ~paragraph_source() = default;
+
+	[[nodiscard]] virtual std::uint32_t size() const noexcept = 0;
+
+	/**
+	 * @return position past the line feed ending the paragraph that contains `pos`, or size() for the last paragraph
+	 */
+	[[nodiscard]] virtual std::uint32_t paragraph_end(std::uint32_t pos) const noexcept = 0;
+
+	/**
+	 * @brief Replace the content of `out` with the text of [pos, pos + length).
+	 */
+	virtual void copy_text(std::uint32_t pos, std::uint32_t length, std::u32string& out) const = 0;
+};
+
+/**
+ * @brief Lays a text out paragraph by paragraph (split after each line feed) and stitches the results into one glyph_layout.
+ *
+ * Only dirty paragraphs are shaped again. Their glyphs and clusters are appended to the stitched layout and only their
+ * lines are inserted in place, the lines of the clean paragraphs are offset (`line::text_offset` and the line origin)
+ * without touching their glyphs. Glyphs of replaced paragraphs are left as holes and compacted once they outnumber the
+ * live ones. An edit therefore costs the shaping of the dirty paragraphs plus a pass over the line records.
+ *
+ * The stitched layout is identical to a full layout of the text as long as it is horizontal (ltr) and has no rich text
+ * state crossing lines.
+ *
+ * @warning The bound glyph_layout must not be modified by anyone else while bound.
+ */
 export class segmented_layout_manager {
 private:
     std::vector<text_segment> segments_;
     const tokenized_text* source_text_{nullptr};
-    math::vec2 total_extent_{};
+	const paragraph_source* paragraphs_{nullptr};
+	glyph_layout* target_{nullptr};
+	// 仅供旧接口 bind_text 使用，未指定目标排版时拼接到此处
+	glyph_layout owned_{};
+	std::u32string paragraph_text_{};
+	glyph_layout scratch_{};
+
+	std::vector<line_change> line_changes_{};
+	// 目标排版已被清空，下次更新为全量排版
+	bool rebuild_pending_{true};
+	bool last_update_rebuilt_{true};
+	std::size_t garbage_elems_{};
+	std::size_t garbage_clusters_{};
+
+	static constexpr std::size_t min_compact_garbage = 4096;
 
 public:
     [[nodiscard]] segmented_layout_manager() = default;
-    [[nodiscard]] explicit(false) segmented_layout_manager(const tokenized_text& text){
-	    bind_text(text);
-    }
 
-    void bind_text(const tokenized_text& text) {
-    	if(source_text_ == &text)return;
-        source_text_ = &text;
-        invalidate_all();
+	/**
+	 * @deprecated The stitched layout is no longer held per segment, use bind(text, target) and read the target layout.
+	 */
+	[[deprecated("use bind(text, target)")]] [[nodiscard]] explicit(false) segmented_layout_manager(const tokenized_text& text){
+		bind_impl_(text, nullptr);
+	}
+
+	[[nodiscard]] bool is_bound() const noexcept{
+		return source_text_ != nullptr || paragraphs_ != nullptr;
+	}
+
+    void bind(const tokenized_text& text, glyph_layout& target) {
+    	bind_impl_(text, &target);
     }
 
+	/**
+	 * @brief Bind to raw text, only the paragraphs being laid out are copied out of the source.
+	 */
+	void bind(const paragraph_source& text, glyph_layout& target) {
+		if(paragraphs_ == &text && target_ == &target)return;
+		source_text_ = nullptr;
+		paragraphs_ = &text;
+		target_ = &target;
+		invalidate_all();
+	}
+
+	/**
+	 * @deprecated Stitches into a layout owned by the manager, use bind(text, target) to stitch into your own.
+	 */
+	[[deprecated("use bind(text, target)")]] void bind_text(const tokenized_text& text) {
+		bind_impl_(text, nullptr);
+	}
+
+	/**
+	 * @deprecated Segments must end with a line feed to be stitched like a full layout, which invalidate_all does.
+	 *
+	 * Re-split the bound text after every occurrence of `pat`. The pattern stays at the end of its segment so the
+	 * segments keep covering the whole text.
+	 */
 	template <typename Pat>
-	void split(Pat&& pat){
-    	auto text = source_text_->get_text();
-    	auto src = text.data();
-    	segments_.clear();
-    	for(auto subrange : text | std::views::split(std::forward<Pat>(pat))){
-    		std::u32string_view substr{subrange};
-    		auto beg = (std::uint32_t)(substr.data() - src);
-    		auto end = (std::uint32_t)(beg + substr.size());
-    		segments_.emplace_back(beg, end);
-    	}
-    }
+	[[deprecated("segments are split after each line feed by invalidate_all")]] void split(Pat&& pat){
+		if(!source_text_) return;
+
+		std::u32string delimiter;
+		if constexpr(std::convertible_to<Pat, char32_t>){
+			delimiter.push_back(static_cast<char32_t>(pat));
+		}else{
+			delimiter = std::u32string_view{pat};
+		}
+		if(delimiter.empty()){
+			invalidate_all();
+			return;
+		}
+
+		const auto text = source_text_->get_text();
+		clear_layout_();
+		for(std::size_t pos = 0; pos < text.size();){
+			const auto found = text.find(delimiter, pos);
+			const auto end = found == std::u32string_view::npos ? text.size() : found + delimiter.size();
+			segments_.emplace_back(static_cast<std::uint32_t>(pos), static_cast<std::uint32_t>(end));
+			pos = end;
+		}
+	}
+
+	/**
+	 * @brief Unbind from the text, called when the bound layout has been produced by other means.
+	 */
+	void reset() noexcept{
+		source_text_ = nullptr;
+		paragraphs_ = nullptr;
+		target_ = nullptr;
+		segments_.clear();
+		line_changes_.clear();
+		rebuild_pending_ = true;
+		garbage_elems_ = garbage_clusters_ = 0;
+	}
 
     // 1. 增量更新段落：精准剔除受影响的段落并重新划分，保留安全段落的缓存
     void apply_edit(std::uint32_t edit_start, std::uint32_t old_len, std::uint32_t new_len) {
-        if (!source_text_) return;
+        if (!is_bound()) return;
         if (segments_.empty()) {
             invalidate_all();
             return;
@@ -95,11 +227,14 @@ public:
         const std::uint32_t old_end = edit_start + old_len;
         const std::int32_t diff = static_cast<std::int32_t>(new_len) - static_cast<std::int32_t>(old_len);
 
+        // 段落按位置有序，从首个可能相交的段落开始寻找受影响的段落区间 [start_it, end_it)
         auto start_it = segments_.end();
         auto end_it = segments_.begin();
 
-        // 寻找受影响的段落区间 [start_it, end_it)
-        for (auto it = segments_.begin(); it != segments_.end(); ++it) {
+        const auto first_candidate = std::ranges::partition_point(segments_, [&](const text_segment& seg){
+        	return seg.end_pos < edit_start;
+        });
+        for (auto it = first_candidate; it != segments_.end() && it->start_pos <= old_end; ++it) {
             bool intersects = false;
             if (old_len == 0) {
                 // 纯插入情况：判断插入点是否在段落内 [start_pos, end_pos)
@@ -125,6 +260,20 @@ public:
             return;
         }
 
+    	// 删除了段落结尾的换行，该段落与下一段落合并
+    	if(old_len > 0 && old_end == (end_it - 1)->end_pos){
+    		while(end_it != segments_.end() && end_it->is_removed) ++end_it;
+    		if(end_it != segments_.end()) ++end_it;
+    	}
+
+    	// 末段保留结尾的空行而其余段落不保留，末段变化时其前一段落也需要重新排版
+    	if(end_it == segments_.end()){
+    		while(start_it != segments_.begin()){
+    			--start_it;
+    			if(!start_it->is_removed) break;
+    		}
+    	}
+
         std::uint32_t affected_old_start = start_it->start_pos;
         std::uint32_t affected_old_end = (end_it - 1)->end_pos;
 
@@ -134,66 +283,139 @@ public:
             it->end_pos += diff;
         }
 
+    	// 被替换段落的旧排版行在全局排版中是连续的，合并为一个移除标记
+    	text_segment removed{affected_old_start, affected_old_start};
+    	removed.is_removed = true;
+    	for(auto it = start_it; it != end_it; ++it){
+    		removed.footprint += it->footprint;
+    	}
+
         std::uint32_t affected_new_end = affected_old_end + diff;
         std::vector<text_segment> new_sub_segments;
-        const auto chars = source_text_->get_text();
-
-        // 在新的受影响区间内，重新扫描换行符划分段落
-        std::uint32_t current_start = affected_old_start;
-        for (std::uint32_t i = affected_old_start; i < affected_new_end && i < chars.size(); ++i) {
-            if (chars[i] == U'\n') {
-                new_sub_segments.push_back(text_segment{current_start, i + 1});
-                current_start = i + 1;
-            }
-        }
-        if (current_start < affected_new_end) {
-            new_sub_segments.push_back(text_segment{current_start, affected_new_end});
-        }
+    	if(removed.footprint != layout_footprint{}){
+    		new_sub_segments.push_back(removed);
+    	}
+    	split_lines_(affected_old_start, affected_new_end, new_sub_segments);
 
     	replace_range(segments_, start_it, end_it, new_sub_segments | std::views::as_rvalue);
     }
 
     // 全量重建所有段落
     void invalidate_all(){
-	    segments_.clear();
-	    total_extent_ = {};
-	    if(!source_text_ || source_text_->empty()) return;
-	    split(std::u32string_view{U"\n\n"});
+	    clear_layout_();
+	    const auto size = source_size_();
+	    if(size == 0) return;
+    	split_lines_(0, size, segments_);
     }
 
-    // 2. 核心更新逻辑：只排版脏段落
-    void update_layouts(layout_context& ctx, const layout_config& config = {}) {
-        if (!source_text_) return;
-
-        bool layout_changed = false;
-
-        for (auto& seg : segments_) {
-            if (!seg.is_dirty) continue;
+	/**
+	 * @brief Mark the segments whose missing glyphs have been generated since their layout as dirty.
+	 */
+	bool invalidate_landed_glyphs() noexcept{
+		bool any{};
+		for(auto& seg : segments_){
+			if(seg.pending_glyph_source && seg.pending_glyph_source->glyph_epoch() != seg.pending_glyph_epoch){
+				seg.is_dirty = true;
+				any = true;
+			}
+		}
+		return any;
+	}
 
-            tokenized_text_view view{*source_text_, seg.start_pos, seg.length()};
-            ctx.layout(view, config, seg.local_layout);
+    // 2. 核心更新逻辑：只排版脏段落，其后段落的行整体平移
+	/**
+	 * @return false if the text cannot be stitched (e.g. non ltr direction), the caller should fall back to a full layout.
+	 */
+    bool update_layouts(layout_context& ctx, const layout_config& config = {}) {
+        if (!is_bound()) return false;
+    	line_changes_.clear();
+    	last_update_rebuilt_ = std::exchange(rebuild_pending_, false);
+
+    	const auto first_dirty = std::ranges::find_if(segments_, [](const text_segment& seg){
+    		return seg.is_dirty || seg.is_removed;
+    	});
+    	if(first_dirty == segments_.end()) return true;
+
+    	glyph_layout& target = target_layout_();
+    	std::uint32_t line_cursor{};
+    	std::optional<float> next_baseline{};
+    	for(auto it = segments_.begin(); it != first_dirty; ++it){
+    		line_cursor += it->footprint.lines;
+    		next_baseline = it->baseline + it->advance;
+    	}
 
-            // 重要：HarfBuzz 产生的 cluster_index 是基于局部视图的 (从 0 开始)，
-            // 我们必须将其补偿回全局坐标，以确保外层命中测试和游标逻辑的正确性。
-            for (auto& cluster : seg.local_layout.clusters) {
-                cluster.cluster_index += seg.start_pos;
-            }
+    	const auto last_live = std::ranges::find_last_if(segments_, std::not_fn(&text_segment::is_removed)).begin();
+
+    	bool success = true;
+    	std::optional<line_change> pending_change{};
+    	const auto change_at = [&]() -> line_change&{
+    		if(!pending_change) pending_change = line_change{line_cursor, 0, 0};
+    		return *pending_change;
+    	};
+
+    	for(auto it = first_dirty; it != segments_.end(); ++it){
+    		auto& seg = *it;
+    		if(seg.is_removed){
+    			remove_lines_(target, line_cursor, seg.footprint.lines);
+    			change_at().removed += seg.footprint.lines;
+    			continue;
+    		}
+
+    		if(seg.is_dirty){
+    			auto& change = change_at();
+    			//relayout after glyphs landed, the segment still owns its previous lines
+    			remove_lines_(target, line_cursor, seg.footprint.lines);
+    			change.removed += seg.footprint.lines;
+
+    			if(!layout_segment_(ctx, config, seg, it == last_live)){
+    				success = false;
+    				break;
+    			}
+    			insert_lines_(target, line_cursor, seg, next_baseline.value_or(seg.local_baseline));
+    			change.inserted += seg.footprint.lines;
+    			seg.is_dirty = false;
+    		}else{
+    			if(pending_change){
+    				line_changes_.push_back(*pending_change);
+    				pending_change.reset();
+    			}
+    			offset_lines_(target, line_cursor, seg, next_baseline.value_or(seg.local_baseline));
+    		}
+    		line_cursor += seg.footprint.lines;
+    		next_baseline = seg.baseline + seg.advance;
+    	}
+    	if(pending_change) line_changes_.push_back(*pending_change);
 
-            seg.is_dirty = false;
-            layout_changed = true;
-        }
+    	std::erase_if(segments_, &text_segment::is_removed);
+    	if(!success){
+    		reset();
+    		return false;
+    	}
 
-        if (layout_changed) {
-            assemble_coordinates();
-        }
+    	if(garbage_elems_ > min_compact_garbage && garbage_elems_ > target.elems.size() - garbage_elems_){
+    		compact_(target);
+    	}
+    	finalize_(target);
+    	return true;
     }
 
+	/**
+	 * @brief Lines replaced by the last update_layouts, ordered by line. Lines outside of them kept their glyphs but may
+	 * have been moved.
+	 *
+	 * @return nullopt if the last update laid out the whole text
+	 */
+	[[nodiscard]] std::optional<std::span<const line_change>> get_line_changes() const noexcept{
+		if(last_update_rebuilt_ || rebuild_pending_) return std::nullopt;
+		return line_changes_;
+	}
+
     [[nodiscard]] const std::vector<text_segment>& get_segments() const noexcept {
         return segments_;
     }
 
     [[nodiscard]] math::vec2 get_extent() const noexcept {
-        return total_extent_;
+        return target_layout_().extent;
     }
 
 	template <typename S>
@@ -203,75 +425,246 @@ public:
 
 	template <typename S>
 	auto end(this S&& self) noexcept{
-	    return std::forward_like<S>(self.segments_).begin();
+	    return std::forward_like<S>(self.segments_).end();
     }
 
     // 4. 全局命中测试代理
     [[nodiscard]] glyph_layout::hit_result hit_test(math::vec2 pos, line_alignment align) const noexcept {
-        if (segments_.empty()) return {};
+        return target_layout_().hit_test(pos, align);
+    }
 
-        const text_segment* target_seg = &segments_.front();
-        bool is_vertical = false;
+private:
+	void bind_impl_(const tokenized_text& text, glyph_layout* target){
+		if(source_text_ == &text && target_ == target)return;
+		source_text_ = &text;
+		paragraphs_ = nullptr;
+		target_ = target;
+		invalidate_all();
+	}
 
-        // 根据排版方向寻找命中的段落
-        for (const auto& seg : segments_) {
-            const auto dir = seg.local_layout.direction;
-            is_vertical = (dir == layout_direction::ttb || dir == layout_direction::btt);
+	[[nodiscard]] glyph_layout& target_layout_() noexcept{
+		return target_ ? *target_ : owned_;
+	}
 
-            if (is_vertical) {
-                // 垂直文本，段落沿 X 轴堆叠
-                if (pos.x >= seg.global_offset.x && pos.x <= seg.global_offset.x + seg.local_layout.extent.x) {
-                    target_seg = &seg;
-                    break;
-                }
-            } else {
-                // 水平文本，段落沿 Y 轴堆叠
-                if (pos.y >= seg.global_offset.y && pos.y <= seg.global_offset.y + seg.local_layout.extent.y) {
-                    target_seg = &seg;
-                    break;
-                }
-            }
-            // 如果没 break，target_seg 会保留最后一个段落（作为越界兜底）
-            target_seg = &seg;
-        }
+	[[nodiscard]] const glyph_layout& target_layout_() const noexcept{
+		return target_ ? *target_ : owned_;
+	}
 
-        // 将全局坐标转换为目标段落的局部坐标进行精确碰撞
-        math::vec2 local_pos = pos - target_seg->global_offset;
-        return target_seg->local_layout.hit_test(local_pos, align);
-    }
+	void clear_layout_() noexcept{
+		segments_.clear();
+		line_changes_.clear();
+		target_layout_().clear();
+		rebuild_pending_ = true;
+		garbage_elems_ = garbage_clusters_ = 0;
+	}
 
-private:
-    // 3. 线性组装：计算每个段落的全局坐标
-    void assemble_coordinates() {
-        total_extent_ = {0.f, 0.f};
-        math::vec2 current_offset{0.f, 0.f};
-
-        for (auto& seg : segments_) {
-            seg.global_offset = current_offset;
-            const auto& ext = seg.local_layout.extent;
-
-            // 根据局部排版方向动态堆叠段落
-            if (seg.local_layout.direction == layout_direction::ttb || seg.local_layout.direction == layout_direction::btt) {
-                // 垂直排版：段落横向铺开
-                total_extent_.y = std::max(total_extent_.y, ext.y);
-                current_offset.x += ext.x;
-            } else {
-                // 水平排版：段落纵向铺开
-                total_extent_.x = std::max(total_extent_.x, ext.x);
-                current_offset.y += ext.y;
-            }
-        }
+	[[nodiscard]] std::uint32_t source_size_() const noexcept{
+		if(paragraphs_) return paragraphs_->size();
+		if(source_text_) return static_cast<std::uint32_t>(source_text_->get_text().size());
+		return 0;
+	}
 
-        // 结算最终高度或宽度
-        if (!segments_.empty()) {
-            const auto last_dir = segments_.back().local_layout.direction;
-            if (last_dir == layout_direction::ttb || last_dir == layout_direction::btt) {
-                total_extent_.x = current_offset.x;
-            } else {
-                total_extent_.y = current_offset.y;
-            }
-        }
-    }
+	void split_lines_(std::uint32_t begin, std::uint32_t end, std::vector<text_segment>& out) const{
+		if(paragraphs_){
+			for(auto pos = begin; pos < end;){
+				const auto paragraph_end = std::min(paragraphs_->paragraph_end(pos), end);
+				out.push_back(text_segment{pos, paragraph_end});
+				pos = paragraph_end;
+			}
+			return;
+		}
+
+		const auto chars = source_text_->get_text();
+		std::uint32_t current_start = begin;
+		for (std::uint32_t i = begin; i < end && i < chars.size(); ++i) {
+			if (chars[i] == U'\n') {
+				out.push_back(text_segment{current_start, i + 1});
+				current_start = i + 1;
+			}
+		}
+		if (current_start < end) {
+			out.push_back(text_segment{current_start, end});
+		}
+	}
+
+	bool layout_segment_(layout_context& ctx, const layout_config& config, text_segment& seg, bool is_last){
+		if(paragraphs_){
+			paragraphs_->copy_text(seg.start_pos, seg.length(), paragraph_text_);
+			ctx.layout(tokenized_text_view{paragraph_text_, {}, 0}, config, scratch_);
+		}else{
+			ctx.layout(tokenized_text_view{*source_text_, seg.start_pos, seg.length()}, config, scratch_);
+		}
+		if(scratch_.direction != layout_direction::ltr || scratch_.lines.empty()) return false;
+
+		// 非末段以换行结尾，排版器会在其后追加一个空行，该空行即下一段落首行的位置
+		const bool drop_trailing = !is_last && scratch_.lines.size() > 1 && scratch_.lines.back().cluster_range.size == 0;
+		const auto kept_lines = static_cast<std::uint32_t>(scratch_.lines.size() - (drop_trailing ? 1 : 0));
+
+		seg.footprint = {
+			.lines = kept_lines,
+			.elems = static_cast<std::uint32_t>(scratch_.elems.size()),
+			.clusters = static_cast<std::uint32_t>(scratch_.clusters.size()),
+			.underlines = static_cast<std::uint32_t>(std::ranges::count_if(scratch_.underlines, [&](const underline& ul){
+				return ul.line_index < kept_lines;
+			})),
+			.wrap_frames = static_cast<std::uint32_t>(std::ranges::count_if(scratch_.wrap_frames, [&](const wrap_frame& wf){
+				return wf.line_index < kept_lines;
+			})),
+		};
+		seg.local_baseline = scratch_.lines.front().start_pos.y;
+		seg.advance = drop_trailing
+			? scratch_.lines.back().start_pos.y - seg.local_baseline
+			: scratch_.extent.y - seg.local_baseline;
+		seg.local_extent = scratch_.extent;
+		seg.pending_glyph_source = scratch_.pending_glyph_source;
+		seg.pending_glyph_epoch = scratch_.pending_glyph_epoch;
+		seg.pending_glyph_holds = std::move(scratch_.pending_glyph_holds);
+		return true;
+	}
+
+	/**
+	 * @brief Decorations are ordered by line, shift the ones at or after `line` and return where they start.
+	 */
+	template <typename Decoration>
+	static auto shift_decorations_(std::vector<Decoration>& decorations, std::uint32_t line, std::int64_t delta) noexcept{
+		const auto first = std::ranges::partition_point(decorations, [&](const Decoration& d){
+			return d.line_index < line;
+		});
+		for(auto& d : std::ranges::subrange{first, decorations.end()}){
+			d.line_index = static_cast<typst_szt>(d.line_index + delta);
+		}
+		return first;
+	}
+
+	template <typename Decoration>
+	static void erase_decorations_(std::vector<Decoration>& decorations, std::uint32_t line, std::uint32_t count){
+		const auto first = std::ranges::partition_point(decorations, [&](const Decoration& d){
+			return d.line_index < line;
+		});
+		const auto last = std::ranges::partition_point(first, decorations.end(), [&](const Decoration& d){
+			return d.line_index < line + count;
+		});
+		const auto erased = decorations.erase(first, last);
+		for(auto& d : std::ranges::subrange{erased, decorations.end()}){
+			d.line_index -= count;
+		}
+	}
+
+	/**
+	 * @brief Remove lines [line, line + count), their glyphs and clusters stay in place as holes.
+	 */
+	void remove_lines_(glyph_layout& target, std::uint32_t line, std::uint32_t count){
+		if(count == 0) return;
+		const auto lines = std::span{target.lines}.subspan(line, count);
+		for(const auto& l : lines){
+			// 尽早归还字形纹理，空洞中只剩下无效的元素
+			for(auto& elem : std::span{target.elems}.subspan(l.glyph_range.pos, l.glyph_range.size)){
+				elem.texture = {};
+			}
+			garbage_elems_ += l.glyph_range.size;
+			garbage_clusters_ += l.cluster_range.size;
+		}
+		target.lines.erase(target.lines.begin() + line, target.lines.begin() + line + count);
+		if(!target.underlines.empty()) erase_decorations_(target.underlines, line, count);
+		if(!target.wrap_frames.empty()) erase_decorations_(target.wrap_frames, line, count);
+	}
+
+	/**
+	 * @brief Move the layout of `seg` from the scratch layout into the target, its lines are inserted at `line`.
+	 */
+	void insert_lines_(glyph_layout& target, std::uint32_t line, text_segment& seg, float baseline){
+		const auto elem_base = static_cast<typst_szt>(target.elems.size());
+		const auto cluster_base = static_cast<typst_szt>(target.clusters.size());
+		const float dy = baseline - seg.local_baseline;
+
+		target.elems.append_range(scratch_.elems | std::views::as_rvalue);
+		target.clusters.append_range(scratch_.clusters);
+
+		const auto kept = std::span{scratch_.lines}.first(seg.footprint.lines);
+		for(auto& l : kept){
+			l.glyph_range.pos += elem_base;
+			l.cluster_range.pos += cluster_base;
+			l.start_pos.y += dy;
+			l.text_offset = seg.start_pos;
+		}
+		target.lines.insert_range(target.lines.begin() + line, kept);
+
+		const auto insert_decorations = [&]<typename Decoration>(std::vector<Decoration>& to, std::vector<Decoration>& from){
+			if(to.empty() && from.empty()) return;
+			const auto at = shift_decorations_(to, line, seg.footprint.lines);
+			std::vector<Decoration> moved;
+			for(auto& d : from){
+				if(d.line_index >= seg.footprint.lines) continue;
+				d.line_index += line;
+				moved.push_back(std::move(d));
+			}
+			to.insert_range(at, moved | std::views::as_rvalue);
+		};
+		insert_decorations(target.underlines, scratch_.underlines);
+		insert_decorations(target.wrap_frames, scratch_.wrap_frames);
+
+		seg.baseline = baseline;
+	}
+
+	/**
+	 * @brief Move the unchanged lines of `seg` to its current text position and baseline, decorations are line relative.
+	 */
+	static void offset_lines_(glyph_layout& target, std::uint32_t line, text_segment& seg, float baseline) noexcept{
+		const float dy = baseline - seg.baseline;
+		for(auto& l : std::span{target.lines}.subspan(line, seg.footprint.lines)){
+			l.start_pos.y += dy;
+			l.text_offset = seg.start_pos;
+		}
+		seg.baseline = baseline;
+	}
+
+	/**
+	 * @brief Drop the holes left by replaced lines, glyphs and clusters are put back into line order.
+	 */
+	void compact_(glyph_layout& target){
+		std::vector<glyph_elem> elems;
+		std::vector<logical_cluster> clusters;
+		elems.reserve(target.elems.size() - garbage_elems_);
+		clusters.reserve(target.clusters.size() - garbage_clusters_);
+
+		for(auto& l : target.lines){
+			const auto elem_pos = static_cast<typst_szt>(elems.size());
+			const auto cluster_pos = static_cast<typst_szt>(clusters.size());
+			elems.append_range(std::span{target.elems}.subspan(l.glyph_range.pos, l.glyph_range.size) | std::views::as_rvalue);
+			clusters.append_range(std::span{target.clusters}.subspan(l.cluster_range.pos, l.cluster_range.size));
+			l.glyph_range.pos = elem_pos;
+			l.cluster_range.pos = cluster_pos;
+		}
+
+		target.elems = std::move(elems);
+		target.clusters = std::move(clusters);
+		garbage_elems_ = garbage_clusters_ = 0;
+	}
+
+	// 3. 结算全局尺寸
+	void finalize_(glyph_layout& target) const noexcept{
+		target.direction = layout_direction::ltr;
+		target.is_exhausted = true;
+		target.pending_glyph_source = nullptr;
+		target.pending_glyph_epoch = 0;
+
+		if(segments_.empty()){
+			target.extent = {};
+			return;
+		}
+
+		float width{};
+		for(const auto& seg : segments_){
+			width = std::max(width, seg.local_extent.x);
+			if(seg.pending_glyph_source && (!target.pending_glyph_source || seg.pending_glyph_epoch < target.pending_glyph_epoch)){
+				target.pending_glyph_source = seg.pending_glyph_source;
+				target.pending_glyph_epoch = seg.pending_glyph_epoch;
+			}
+		}
+
+		const auto& last = segments_.back();
+		target.extent = {width, last.baseline - last.local_baseline + last.local_extent.y};
+	}
 };
 
 }
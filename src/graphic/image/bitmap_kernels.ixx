@@ -0,0 +1,265 @@
+module;
+
+#include <cassert>
+
+#if defined(__AVX2__)
+#define XRGUI_BITMAP_HAS_AVX2 1
+#include <immintrin.h>
+#endif
+
+export module mo_yanxi.graphic.bitmap_kernels;
+
+import std;
+
+/**
+ * @brief In place pixel kernels over tightly packed RGBA8 (or BGRA8) data.
+ *
+ * Every kernel has a scalar path producing the same bytes as the vectorized one, the AVX2 path is taken when the
+ * target enables it. Tails shorter than a vector are handled by the scalar path.
+ */
+namespace mo_yanxi::graphic::bitmap_kernels{
+
+constexpr std::size_t channels = 4;
+
+//exact round(x / 255) for x in [0, 255 * 255]
+[[nodiscard]] constexpr std::uint32_t div255_round(const std::uint32_t x) noexcept{
+	const auto t = x + 128;
+	return (t + (t >> 8)) >> 8;
+}
+
+[[nodiscard]] inline std::uint8_t* bytes_of(const std::span<std::byte> pixels) noexcept{
+	return reinterpret_cast<std::uint8_t*>(pixels.data());
+}
+
+[[nodiscard]] inline const std::uint8_t* bytes_of(const std::span<const std::byte> pixels) noexcept{
+	return reinterpret_cast<const std::uint8_t*>(pixels.data());
+}
+
+void premultiply_alpha_scalar(std::uint8_t* p, const std::size_t pixel_count) noexcept{
+	for(std::size_t i = 0; i < pixel_count; ++i, p += channels){
+		const std::uint32_t a = p[3];
+		p[0] = static_cast<std::uint8_t>(div255_round(p[0] * a));
+		p[1] = static_cast<std::uint8_t>(div255_round(p[1] * a));
+		p[2] = static_cast<std::uint8_t>(div255_round(p[2] * a));
+	}
+}
+
+void swap_red_blue_scalar(std::uint8_t* p, const std::size_t pixel_count) noexcept{
+	for(std::size_t i = 0; i < pixel_count; ++i, p += channels){
+		std::swap(p[0], p[2]);
+	}
+}
+
+void apply_color_table(std::uint8_t* p, const std::size_t pixel_count, const std::array<std::uint8_t, 256>& table) noexcept{
+	for(std::size_t i = 0; i < pixel_count; ++i, p += channels){
+		p[0] = table[p[0]];
+		p[1] = table[p[1]];
+		p[2] = table[p[2]];
+	}
+}
+
+void downsample_2x_row_scalar(
+	const std::uint8_t* row0, const std::uint8_t* row1, std::uint8_t* dst,
+	const std::size_t src_width, std::size_t dst_begin, const std::size_t dst_end) noexcept{
+	for(; dst_begin < dst_end; ++dst_begin){
+		const auto x0 = dst_begin * 2;
+		const auto x1 = std::min(x0 + 1, src_width - 1);
+		for(std::size_t c = 0; c < channels; ++c){
+			const std::uint32_t sum =
+				row0[x0 * channels + c] + row0[x1 * channels + c] +
+				row1[x0 * channels + c] + row1[x1 * channels + c];
+			dst[dst_begin * channels + c] = static_cast<std::uint8_t>((sum + 2) >> 2);
+		}
+	}
+}
+
+#if XRGUI_BITMAP_HAS_AVX2
+
+//8 pixels per iteration, returns the number of pixels processed
+std::size_t premultiply_alpha_avx2(std::uint8_t* p, const std::size_t pixel_count) noexcept{
+	//broadcast alpha to the color channels of its pixel, the alpha channel itself is scaled by 255 (kept)
+	const __m256i alpha_shuffle = _mm256_setr_epi8(
+		6, -1, 6, -1, 6, -1, -1, -1, 14, -1, 14, -1, 14, -1, -1, -1,
+		6, -1, 6, -1, 6, -1, -1, -1, 14, -1, 14, -1, 14, -1, -1, -1);
+	const __m256i alpha_keep = _mm256_setr_epi16(0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255, 0, 0, 0, 255);
+	const __m256i round = _mm256_set1_epi16(128);
+
+	const auto scale = [&](const __m256i px){
+		const __m256i mul = _mm256_or_si256(_mm256_shuffle_epi8(px, alpha_shuffle), alpha_keep);
+		const __m256i t = _mm256_add_epi16(_mm256_mullo_epi16(px, mul), round);
+		return _mm256_srli_epi16(_mm256_add_epi16(t, _mm256_srli_epi16(t, 8)), 8);
+	};
+
+	const __m256i zero = _mm256_setzero_si256();
+	std::size_t i = 0;
+	for(; i + 8 <= pixel_count; i += 8){
+		auto* ptr = reinterpret_cast<__m256i*>(p + i * channels);
+		const __m256i px = _mm256_loadu_si256(ptr);
+		const __m256i lo = scale(_mm256_unpacklo_epi8(px, zero));
+		const __m256i hi = scale(_mm256_unpackhi_epi8(px, zero));
+		_mm256_storeu_si256(ptr, _mm256_packus_epi16(lo, hi));
+	}
+	return i;
+}
+
+std::size_t swap_red_blue_avx2(std::uint8_t* p, const std::size_t pixel_count) noexcept{
+	const __m256i shuffle = _mm256_setr_epi8(
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+		2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+
+	std::size_t i = 0;
+	for(; i + 8 <= pixel_count; i += 8){
+		auto* ptr = reinterpret_cast<__m256i*>(p + i * channels);
+		_mm256_storeu_si256(ptr, _mm256_shuffle_epi8(_mm256_loadu_si256(ptr), shuffle));
+	}
+	return i;
+}
+
+//8 source pixels of each row become 4 destination pixels, returns the number of destination pixels written
+std::size_t downsample_2x_row_avx2(
+	const std::uint8_t* row0, const std::uint8_t* row1, std::uint8_t* dst, const std::size_t dst_width) noexcept{
+	const __m256i round = _mm256_set1_epi16(2);
+
+	std::size_t x = 0;
+	for(; x + 4 <= dst_width; x += 4){
+		const auto* s0 = reinterpret_cast<const __m128i*>(row0 + x * 2 * channels);
+		const auto* s1 = reinterpret_cast<const __m128i*>(row1 + x * 2 * channels);
+
+		//p0..p3 and p4..p7 widened to 16 bits, rows summed
+		const __m256i lo = _mm256_add_epi16(
+			_mm256_cvtepu8_epi16(_mm_loadu_si128(s0)),
+			_mm256_cvtepu8_epi16(_mm_loadu_si128(s1)));
+		const __m256i hi = _mm256_add_epi16(
+			_mm256_cvtepu8_epi16(_mm_loadu_si128(s0 + 1)),
+			_mm256_cvtepu8_epi16(_mm_loadu_si128(s1 + 1)));
+
+		//[p0, p4, p2, p6] + [p1, p5, p3, p7], then reordered to [p01, p23, p45, p67]
+		__m256i sum = _mm256_add_epi16(_mm256_unpacklo_epi64(lo, hi), _mm256_unpackhi_epi64(lo, hi));
+		sum = _mm256_permute4x64_epi64(sum, 0b11'01'10'00);
+		sum = _mm256_srli_epi16(_mm256_add_epi16(sum, round), 2);
+
+		const __m256i packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(sum, sum), 0b10'00'10'00);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst + x * channels), _mm256_castsi256_si128(packed));
+	}
+	return x;
+}
+
+#endif
+
+[[nodiscard]] const std::array<std::uint8_t, 256>& srgb_to_linear_table() noexcept{
+	static const std::array<std::uint8_t, 256> table = []{
+		std::array<std::uint8_t, 256> t{};
+		for(std::size_t i = 0; i < t.size(); ++i){
+			const double c = static_cast<double>(i) / 255.;
+			const double l = c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4);
+			t[i] = static_cast<std::uint8_t>(std::lround(l * 255.));
+		}
+		return t;
+	}();
+	return table;
+}
+
+[[nodiscard]] const std::array<std::uint8_t, 256>& linear_to_srgb_table() noexcept{
+	static const std::array<std::uint8_t, 256> table = []{
+		std::array<std::uint8_t, 256> t{};
+		for(std::size_t i = 0; i < t.size(); ++i){
+			const double l = static_cast<double>(i) / 255.;
+			const double c = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1. / 2.4) - 0.055;
+			t[i] = static_cast<std::uint8_t>(std::lround(c * 255.));
+		}
+		return t;
+	}();
+	return table;
+}
+
+/**
+ * @brief Multiply the color channels by alpha, `round(c * a / 255)`.
+ */
+export
+void premultiply_alpha(const std::span<std::byte> pixels) noexcept{
+	assert(pixels.size() % channels == 0);
+	const auto count = pixels.size() / channels;
+	auto* p = bytes_of(pixels);
+	std::size_t done = 0;
+#if XRGUI_BITMAP_HAS_AVX2
+	done = premultiply_alpha_avx2(p, count);
+#endif
+	premultiply_alpha_scalar(p + done * channels, count - done);
+}
+
+/**
+ * @brief Convert between RGBA and BGRA by exchanging the first and third channel.
+ */
+export
+void swap_red_blue(const std::span<std::byte> pixels) noexcept{
+	assert(pixels.size() % channels == 0);
+	const auto count = pixels.size() / channels;
+	auto* p = bytes_of(pixels);
+	std::size_t done = 0;
+#if XRGUI_BITMAP_HAS_AVX2
+	done = swap_red_blue_avx2(p, count);
+#endif
+	swap_red_blue_scalar(p + done * channels, count - done);
+}
+
+/**
+ * @brief Decode sRGB color channels to linear 8 bit values, alpha is left untouched.
+ *
+ * Table driven: a gather per channel is not faster than scalar lookups, and the table stays in L1.
+ */
+export
+void srgb_to_linear(const std::span<std::byte> pixels) noexcept{
+	assert(pixels.size() % channels == 0);
+	apply_color_table(bytes_of(pixels), pixels.size() / channels, srgb_to_linear_table());
+}
+
+/**
+ * @brief Encode linear color channels to sRGB 8 bit values, alpha is left untouched.
+ */
+export
+void linear_to_srgb(const std::span<std::byte> pixels) noexcept{
+	assert(pixels.size() % channels == 0);
+	apply_color_table(bytes_of(pixels), pixels.size() / channels, linear_to_srgb_table());
+}
+
+/**
+ * @brief Extent of the next mip level, each axis is halved (rounded down) but never below 1.
+ */
+export
+[[nodiscard]] constexpr std::array<std::size_t, 2> downsampled_extent(const std::size_t width, const std::size_t height) noexcept{
+	return {std::max<std::size_t>(width / 2, 1), std::max<std::size_t>(height / 2, 1)};
+}
+
+/**
+ * @brief 2x2 box filter for the next mip level, `dst` holds `downsampled_extent(width, height)` pixels.
+ *
+ * An odd trailing row or column is dropped, as a mip level blit does; an axis of size 1 is kept as is.
+ * Channels are filtered independently, premultiply first when alpha varies to avoid dark fringes.
+ */
+export
+void downsample_2x(
+	const std::span<const std::byte> src, const std::size_t width, const std::size_t height,
+	const std::span<std::byte> dst) noexcept{
+	const auto [dst_width, dst_height] = downsampled_extent(width, height);
+	assert(src.size() >= width * height * channels);
+	assert(dst.size() >= dst_width * dst_height * channels);
+	if(width == 0 || height == 0) return;
+
+	const auto* s = bytes_of(src);
+	auto* d = bytes_of(dst);
+	const auto src_stride = width * channels;
+
+	for(std::size_t y = 0; y < dst_height; ++y){
+		const auto* row0 = s + y * 2 * src_stride;
+		const auto* row1 = height > 1 ? row0 + src_stride : row0;
+		auto* out = d + y * dst_width * channels;
+
+		std::size_t done = 0;
+#if XRGUI_BITMAP_HAS_AVX2
+		if(width > 1) done = downsample_2x_row_avx2(row0, row1, out, dst_width);
+#endif
+		downsample_2x_row_scalar(row0, row1, out, width, done, dst_width);
+	}
+}
+
+}
@@ -0,0 +1,81 @@
+module;
+
+#include <cassert>
+
+export module mo_yanxi.graphic.bitmap_resize;
+
+import std;
+import mo_yanxi.bitmap;
+import mo_yanxi.math.vector2;
+
+namespace mo_yanxi::graphic{
+
+/**
+ * @brief Largest extent with the aspect ratio of `source` that fits in `bound`, images are never upscaled.
+ *
+ * A zero component of `bound` leaves that axis unconstrained.
+ */
+export
+[[nodiscard]] constexpr math::usize2 fit_image_extent(const math::usize2 source, const math::usize2 bound) noexcept{
+	if(source.x == 0 || source.y == 0) return source;
+
+	double scale = 1.;
+	if(bound.x != 0) scale = std::min(scale, static_cast<double>(bound.x) / static_cast<double>(source.x));
+	if(bound.y != 0) scale = std::min(scale, static_cast<double>(bound.y) / static_cast<double>(source.y));
+	if(scale >= 1.) return source;
+
+	return {
+			std::max(1u, static_cast<std::uint32_t>(static_cast<double>(source.x) * scale)),
+			std::max(1u, static_cast<std::uint32_t>(static_cast<double>(source.y) * scale))
+		};
+}
+
+/**
+ * @brief Box filtered downscale of a RGBA8 image, color is weighted by alpha so transparent texels do not bleed in.
+ */
+export
+[[nodiscard]] bitmap downscale_bitmap(const bitmap& source, const math::usize2 target){
+	const math::usize2 src_ext = source.extent();
+	if(target == src_ext || target.x == 0 || target.y == 0) return source;
+	assert(target.x <= src_ext.x && target.y <= src_ext.y);
+
+	bitmap result{target.x, target.y};
+	const auto* src = reinterpret_cast<const std::uint8_t*>(source.data());
+	auto* dst = reinterpret_cast<std::uint8_t*>(result.data());
+
+	for(std::uint32_t y = 0; y < target.y; ++y){
+		const std::size_t y0 = static_cast<std::size_t>(y) * src_ext.y / target.y;
+		const std::size_t y1 = std::max(y0 + 1, static_cast<std::size_t>(y + 1) * src_ext.y / target.y);
+
+		for(std::uint32_t x = 0; x < target.x; ++x){
+			const std::size_t x0 = static_cast<std::size_t>(x) * src_ext.x / target.x;
+			const std::size_t x1 = std::max(x0 + 1, static_cast<std::size_t>(x + 1) * src_ext.x / target.x);
+
+			std::uint64_t r{}, g{}, b{}, a{};
+			for(std::size_t sy = y0; sy < y1; ++sy){
+				const auto* row = src + (sy * src_ext.x + x0) * 4;
+				for(std::size_t sx = x0; sx < x1; ++sx, row += 4){
+					r += row[0] * row[3];
+					g += row[1] * row[3];
+					b += row[2] * row[3];
+					a += row[3];
+				}
+			}
+
+			const auto count = (y1 - y0) * (x1 - x0);
+			auto* out = dst + (static_cast<std::size_t>(y) * target.x + x) * 4;
+			if(a != 0){
+				out[0] = static_cast<std::uint8_t>((r + a / 2) / a);
+				out[1] = static_cast<std::uint8_t>((g + a / 2) / a);
+				out[2] = static_cast<std::uint8_t>((b + a / 2) / a);
+			} else{
+				out[0] = out[1] = out[2] = 0;
+			}
+			out[3] = static_cast<std::uint8_t>((a + count / 2) / count);
+		}
+	}
+
+	return result;
+}
+
+}
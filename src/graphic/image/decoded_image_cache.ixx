@@ -0,0 +1,284 @@
+module;
+
+#include <cassert>
+
+export module mo_yanxi.graphic.decoded_image_cache;
+
+import std;
+
+export import mo_yanxi.graphic.bitmap;
+export import mo_yanxi.graphic.bitmap_resize;
+import mo_yanxi.math.vector2;
+import mo_yanxi.platform.mapped_file;
+
+namespace mo_yanxi::graphic{
+
+/**
+ * @brief Tightly packed RGBA8 pixels, either decoded in memory or mapped from a thumbnail file.
+ */
+export
+struct decoded_image{
+	math::usize2 extent{};
+	std::variant<bitmap, platform::mapped_file> storage{};
+	std::size_t data_offset{};
+
+	[[nodiscard]] std::span<const std::byte> get_bytes() const noexcept{
+		const auto size = static_cast<std::size_t>(extent.x) * extent.y * 4;
+		return std::visit([&] <typename T>(const T& data) -> std::span<const std::byte>{
+			if constexpr(std::same_as<T, bitmap>){
+				return {reinterpret_cast<const std::byte*>(data.data()), size};
+			} else{
+				return {data.data() + data_offset, size};
+			}
+		}, storage);
+	}
+
+	[[nodiscard]] std::size_t size_bytes() const noexcept{
+		return static_cast<std::size_t>(extent.x) * extent.y * 4;
+	}
+};
+
+struct thumbnail_header{
+	static constexpr std::array<char, 4> expected_magic{'X', 'G', 'T', 'N'};
+	static constexpr std::uint32_t current_version = 1;
+
+	std::array<char, 4> magic{expected_magic};
+	std::uint32_t version{current_version};
+	std::uint64_t key_hash{};
+	std::int64_t source_mtime{};
+	std::uint32_t width{};
+	std::uint32_t height{};
+};
+
+static_assert(std::is_trivially_copyable_v<thumbnail_header>);
+
+/**
+ * @brief Decoded images keyed by file path, modification time and target extent.
+ *
+ * Recently used images are kept in memory up to a byte budget and evicted in LRU order.
+ * Downscaled images can additionally be persisted to a thumbnail directory as a raw header | RGBA8 file,
+ * which is memory mapped on later runs instead of decoding the source again.
+ *
+ * Thread safe, loads are expected to come from the atlas loader workers.
+ */
+export
+class decoded_image_cache{
+public:
+	using image_ptr = std::shared_ptr<const decoded_image>;
+
+private:
+	struct cache_key{
+		std::string path{};
+		std::int64_t mtime{};
+		math::usize2 bound{};
+
+		bool operator==(const cache_key&) const noexcept = default;
+	};
+
+	struct key_hasher{
+		std::uint64_t operator()(const cache_key& k) const noexcept{
+			static constexpr std::uint64_t prime = 0x100000001b3ULL;
+			std::uint64_t h = 0xcbf29ce484222325ULL;
+			for(const char c : k.path){
+				h = (h ^ static_cast<std::uint8_t>(c)) * prime;
+			}
+			for(const std::uint64_t v : {static_cast<std::uint64_t>(k.mtime), std::uint64_t{k.bound.x}, std::uint64_t{k.bound.y}}){
+				h = (h ^ v) * prime;
+				h ^= h >> 29;
+			}
+			h ^= h >> 33;
+			h *= 0xff51afd7ed558ccdULL;
+			h ^= h >> 33;
+			return h;
+		}
+	};
+
+	struct entry{
+		cache_key key;
+		image_ptr image;
+	};
+
+	using lru_list = std::list<entry>;
+
+	mutable std::mutex mtx_{};
+	lru_list lru_{};
+	std::unordered_map<cache_key, lru_list::iterator, key_hasher> index_{};
+	std::size_t used_bytes_{};
+	std::size_t byte_budget_{};
+	std::filesystem::path thumbnail_directory_{};
+
+public:
+	static constexpr std::size_t default_byte_budget = 64 << 20;
+
+	[[nodiscard]] explicit decoded_image_cache(std::size_t byte_budget = default_byte_budget)
+		: byte_budget_(byte_budget){
+	}
+
+	decoded_image_cache(const decoded_image_cache&) = delete;
+	decoded_image_cache& operator=(const decoded_image_cache&) = delete;
+
+	void set_byte_budget(const std::size_t byte_budget){
+		std::lock_guard lk{mtx_};
+		byte_budget_ = byte_budget;
+		shrink_();
+	}
+
+	/**
+	 * @param directory empty disables the on-disk thumbnail tier
+	 */
+	void set_thumbnail_directory(std::filesystem::path directory){
+		std::error_code ec;
+		if(!directory.empty()) std::filesystem::create_directories(directory, ec);
+		std::lock_guard lk{mtx_};
+		thumbnail_directory_ = std::move(directory);
+	}
+
+	void clear() noexcept{
+		std::lock_guard lk{mtx_};
+		index_.clear();
+		lru_.clear();
+		used_bytes_ = 0;
+	}
+
+	[[nodiscard]] std::size_t used_bytes() const noexcept{
+		std::lock_guard lk{mtx_};
+		return used_bytes_;
+	}
+
+	/**
+	 * @brief Decoded image of `path`, downscaled to fit `bound` when it is non-zero.
+	 *
+	 * A changed modification time of the file misses the cache, the stale entry ages out through the LRU.
+	 *
+	 * @throws std::runtime_error if the file cannot be decoded
+	 */
+	[[nodiscard]] image_ptr load(std::string_view path, const math::usize2 bound = {}){
+		cache_key k{std::string{path}, query_mtime_(path), bound};
+
+		std::filesystem::path thumbnail_dir;
+		{
+			std::lock_guard lk{mtx_};
+			if(const auto itr = index_.find(k); itr != index_.end()){
+				lru_.splice(lru_.begin(), lru_, itr->second);
+				return itr->second->image;
+			}
+			thumbnail_dir = thumbnail_directory_;
+		}
+
+		const auto hash = key_hasher{}(k);
+		std::filesystem::path thumbnail_path;
+		if(!thumbnail_dir.empty() && bound != math::usize2{}){
+			thumbnail_path = thumbnail_dir / std::format("{:016X}.xtn", hash);
+		}
+
+		image_ptr image;
+		if(!thumbnail_path.empty()){
+			image = open_thumbnail_(thumbnail_path, hash, k.mtime);
+		}
+
+		if(!image){
+			auto source = load_bitmap(path);
+			const auto target = fit_image_extent(source.extent(), bound);
+			const bool scaled = target != source.extent();
+			if(scaled){
+				source = downscale_bitmap(source, target);
+				if(!thumbnail_path.empty()){
+					write_thumbnail_(thumbnail_path, hash, k.mtime, source);
+				}
+			}
+			image = std::make_shared<const decoded_image>(decoded_image{target, std::move(source)});
+		}
+
+		std::lock_guard lk{mtx_};
+		//another worker may have decoded the same image meanwhile
+		if(const auto itr = index_.find(k); itr != index_.end()){
+			lru_.splice(lru_.begin(), lru_, itr->second);
+			return itr->second->image;
+		}
+
+		used_bytes_ += image->size_bytes();
+		lru_.push_front(entry{k, image});
+		index_.emplace(std::move(k), lru_.begin());
+		shrink_();
+		return image;
+	}
+
+private:
+	//the entry just inserted is always kept, even if it alone exceeds the budget
+	void shrink_() noexcept{
+		while(used_bytes_ > byte_budget_ && lru_.size() > 1){
+			auto& victim = lru_.back();
+			used_bytes_ -= victim.image->size_bytes();
+			index_.erase(victim.key);
+			lru_.pop_back();
+		}
+	}
+
+	[[nodiscard]] static std::int64_t query_mtime_(std::string_view path) noexcept{
+		std::error_code ec;
+		const auto time = std::filesystem::last_write_time(std::filesystem::path{path}, ec);
+		if(ec) return 0;
+		return static_cast<std::int64_t>(time.time_since_epoch().count());
+	}
+
+	[[nodiscard]] static image_ptr open_thumbnail_(const std::filesystem::path& path, const std::uint64_t hash, const std::int64_t mtime) noexcept{
+		platform::mapped_file file{path};
+		if(file.size() < sizeof(thumbnail_header)) return nullptr;
+
+		thumbnail_header header;
+		std::memcpy(&header, file.data(), sizeof(header));
+		if(
+			header.magic != thumbnail_header::expected_magic ||
+			header.version != thumbnail_header::current_version ||
+			header.key_hash != hash ||
+			header.source_mtime != mtime ||
+			header.width == 0 || header.height == 0 ||
+			file.size() - sizeof(header) < static_cast<std::size_t>(header.width) * header.height * 4
+		){
+			return nullptr;
+		}
+
+		try{
+			return std::make_shared<const decoded_image>(decoded_image{
+					{header.width, header.height}, std::move(file), sizeof(thumbnail_header)
+				});
+		} catch(...){
+			return nullptr;
+		}
+	}
+
+	//failing to persist a thumbnail only costs a decode next time
+	static void write_thumbnail_(const std::filesystem::path& path, const std::uint64_t hash, const std::int64_t mtime, const bitmap& image) noexcept{
+		try{
+			const math::usize2 extent = image.extent();
+			const thumbnail_header header{
+					.key_hash = hash,
+					.source_mtime = mtime,
+					.width = extent.x,
+					.height = extent.y,
+				};
+
+			auto temp_path = path;
+			temp_path += ".tmp";
+			{
+				std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+				if(!out) return;
+				out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+				out.write(reinterpret_cast<const char*>(image.data()), static_cast<std::streamsize>(image.area() * 4));
+				if(!out) return;
+			}
+
+			std::error_code ec;
+			std::filesystem::rename(temp_path, path, ec);
+			if(ec) std::filesystem::remove(temp_path, ec);
+		} catch(...){
+		}
+	}
+};
+
+/**
+ * @brief Cache used by `bitmap_path_load`, null decodes every load directly.
+ */
+export inline decoded_image_cache* default_decoded_image_cache{};
+
+}
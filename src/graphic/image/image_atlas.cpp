@@ -8,6 +8,7 @@ module;
 module mo_yanxi.graphic.image_atlas;
 
 import mo_yanxi.vk.cmd;
+import mo_yanxi.graphic.bitmap_kernels;
 import mo_yanxi.platform.thread;
 import mo_yanxi.log;
 
@@ -78,21 +79,20 @@ void async_image_loader::gpu_work_func(std::stop_token stop_token, async_image_l
 void async_image_loader::cpu_work_func(std::stop_token stop_token, async_image_loader& self, unsigned worker_index) try {
 	auto& worker = self.cpu_workers_[worker_index];
 	while (true) {
-		allocated_image_load_description item{};
-
-		{
-			std::unique_lock lock(self.load_queue_mutex_);
-
-			self.load_queue_cond_.wait(lock, [&]{
-				return !self.load_queue.empty() || stop_token.stop_requested();
-			});
-
-			if (stop_token.stop_requested() && self.load_queue.empty()) {
+		auto popped = self.pop_load_work_();
+		if(!popped){
+			if(stop_token.stop_requested()){
 				break;
 			}
+			self.wait_for_load_work_(stop_token);
+			continue;
+		}
+
+		auto item = std::move(*popped);
 
-			item = std::move(self.load_queue.front());
-			self.load_queue.pop_front();
+		//fan out a burst of pushes one worker at a time instead of waking everyone per push
+		if(self.has_load_work_()){
+			self.wake_cpu_workers_(1);
 		}
 
 		if(stop_token.stop_requested()){
@@ -145,7 +145,8 @@ std::optional<prepared_image_upload> async_image_loader::prepare(allocated_image
 
 		static constexpr std::uint32_t max_prov = 3;
 
-		const auto mipmap_level = std::min(std::min(max_prov, desc.mip_level), desc.desc.get_prov_levels());
+		const auto wanted_level = std::min(max_prov, desc.mip_level);
+		const auto mipmap_level = std::min(wanted_level, desc.desc.get_prov_levels());
 		assert(mipmap_level > 0);
 
 		prepared_image_upload prepared{};
@@ -177,6 +178,30 @@ std::optional<prepared_image_upload> async_image_loader::prepare(allocated_image
 			prepared.mip_data.push_back(std::move(level_data));
 		}
 
+		//levels the description does not provide are filtered here on the worker instead of blitted on the loader queue
+		for(auto mip_lv = static_cast<std::uint32_t>(prepared.mip_data.size()); mip_lv < wanted_level; ++mip_lv){
+			if(stop_requested()){
+				return std::nullopt;
+			}
+
+			const auto scl = 1u << (mip_lv - 1);
+			const std::size_t src_w = desc.region.width() / scl;
+			const std::size_t src_h = desc.region.height() / scl;
+			const std::size_t dst_w = desc.region.width() / (scl * 2);
+			const std::size_t dst_h = desc.region.height() / (scl * 2);
+			const auto& src = prepared.mip_data.back();
+			if(dst_w == 0 || dst_h == 0 || src.size() != src_w * src_h * 4){
+				break;
+			}
+
+			prepared_image_upload::mip_level_data level_data{};
+			level_data.resize_and_overwrite(dst_w * dst_h * 4, [&](std::byte* data, std::size_t, std::size_t requested_size) noexcept{
+				bitmap_kernels::downsample_2x({src.data(), src.size()}, src_w, src_h, {data, requested_size});
+				return requested_size;
+			});
+			prepared.mip_data.push_back(std::move(level_data));
+		}
+
 		return std::move(prepared);
 	}
 
@@ -319,16 +344,17 @@ std::optional<prepared_image_upload> async_image_loader::prepare(allocated_image
 		vk::context_info context,
 		std::uint32_t graphic_family_index,
 		VkQueue working_queue,
-		image_view_registry& image_view_registry):
+		image_view_registry& image_view_registry,
+		unsigned cpu_worker_count):
 		working_queue_{working_queue},
 		async_allocator_(vk::allocator(context, VMA_ALLOCATOR_CREATE_EXTERNALLY_SYNCHRONIZED_BIT)),
 		command_pool_(context.device, graphic_family_index, VK_COMMAND_POOL_CREATE_TRANSIENT_BIT),
 		region_fence_(context.device, true),
 		allocation_fence_(context.device, false),
 		image_view_registry_(&image_view_registry){
-		const auto cpu_worker_count = calculate_cpu_worker_count();
-		cpu_workers_.reserve(cpu_worker_count);
-		for(unsigned i = 0; i < cpu_worker_count; ++i){
+		const auto worker_count = calculate_cpu_worker_count(cpu_worker_count);
+		cpu_workers_.reserve(worker_count);
+		for(unsigned i = 0; i < worker_count; ++i){
 			auto& worker = cpu_workers_.emplace_back();
 			worker.work_thread = std::jthread([](std::stop_token stop_token, async_image_loader& self, unsigned worker_index){
 				cpu_work_func(std::move(stop_token), self, worker_index);
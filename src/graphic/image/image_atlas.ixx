@@ -17,6 +17,8 @@ export import mo_yanxi.graphic.image_region;
 export import mo_yanxi.graphic.image_view_registry;
 export import mo_yanxi.graphic.color;
 export import mo_yanxi.graphic.bitmap;
+export import mo_yanxi.graphic.decoded_image_cache;
+export import mo_yanxi.graphic.region_slot_table;
 
 import mo_yanxi.referenced_ptr;
 import mo_yanxi.meta_programming;
@@ -35,6 +37,7 @@ import mo_yanxi.vk.universal_handle;
 import mo_yanxi.heterogeneous;
 import mo_yanxi.concurrent.condition_variable_single;
 import mo_yanxi.concurrent.mpsc_queue;
+import mo_yanxi.mpmc_queue;
 import mo_yanxi.utility;
 
 export import mo_yanxi.graphic.msdf;
@@ -71,6 +74,29 @@ using concurrent_node_string_map = gtl::parallel_node_hash_map<
 	StringHashEq, StringHashEq
 >;
 
+/**
+ * @brief Allocation free region key, e.g. (font face, glyph index).
+ */
+export
+struct image_region_key{
+	const void* owner{};
+	std::uint64_t index{};
+
+	constexpr bool operator==(const image_region_key&) const noexcept = default;
+};
+
+struct image_region_key_hash{
+	static std::size_t operator()(const image_region_key& key) noexcept {
+		return gtl::HashState().combine(0, key.owner, key.index);
+	}
+};
+
+template <typename V>
+using concurrent_node_key_map = gtl::parallel_node_hash_map<
+	image_region_key, V,
+	image_region_key_hash
+>;
+
 #pragma endregion
 constexpr math::usize2 DefaultTexturePageSize = math::vectors::constant2<std::uint32_t>::base_vec2 * (4096);
 
@@ -82,7 +108,7 @@ export
 struct bitmap_represent{
 	using byte_span = std::span<const std::byte>;
 
-	std::variant<byte_span, bitmap> present{};
+	std::variant<byte_span, bitmap, std::shared_ptr<const decoded_image>> present{};
 
 	[[nodiscard]] constexpr bitmap_represent() = default;
 
@@ -97,6 +123,8 @@ struct bitmap_represent{
 			if constexpr(std::same_as<T, bitmap>){
 				const std::span<const bitmap::value_type> s = data.to_span();
 				return byte_span{reinterpret_cast<const std::byte*>(s.data()), s.size_bytes()};
+			} else if constexpr(std::same_as<T, std::shared_ptr<const decoded_image>>){
+				return data ? data->get_bytes() : byte_span{};
 			} else{
 				return data;
 			}
@@ -107,17 +135,30 @@ struct bitmap_represent{
 export
 struct bitmap_path_load{
 	std::string path{};
+	/**
+	 * @brief Downscale the image to fit in this extent, zero keeps the source size. Images are never upscaled.
+	 */
+	math::usize2 max_extent{};
 
 	[[nodiscard]] math::usize2 get_extent() const{
 		const auto ext = io::image::read_image_extent(path.c_str());
 		if(!ext){
 			throw bad_image_asset{};
 		}
-		return std::bit_cast<math::usize2>(ext.value());
+		return fit_image_extent(std::bit_cast<math::usize2>(ext.value()), max_extent);
 	}
 
 	bitmap_represent operator()(unsigned w, unsigned h, unsigned level) const{
-		return load_bitmap(path);
+		if(default_decoded_image_cache){
+			return default_decoded_image_cache->load(path, max_extent);
+		}
+
+		auto source = load_bitmap(path);
+		const auto target = fit_image_extent(source.extent(), max_extent);
+		if(target != source.extent()){
+			return downscale_bitmap(source, target);
+		}
+		return source;
 	}
 };
 
@@ -141,12 +182,18 @@ export
 struct sdf_load{
 	std::variant<
 		msdf::msdf_generator,
-		msdf::msdf_glyph_generator_crop
+		msdf::msdf_glyph_generator_crop,
+		msdf::prebaked_sdf
 	> generator{};
 
 	std::optional<math::usize2> extent{};
 	std::uint32_t prov_levels{3};
 
+	/**
+	 * @brief Invoked on the loader cpu worker after each mip level is generated, used to persist the result.
+	 */
+	std::function<void(std::uint32_t level, const bitmap&)> on_generated{};
+
 	[[nodiscard]] math::usize2 get_extent() const {
 		return extent.value_or(std::visit<math::usize2>(overload{
 			[this](const msdf::msdf_generator& generator){
@@ -160,13 +207,23 @@ struct sdf_load{
 			},
 			[this](const msdf::msdf_glyph_generator_crop& generator){
 				return math::usize2{generator.font_w, generator.font_h};
+			},
+			[](const msdf::prebaked_sdf& baked){
+				return baked.extent;
 			}
 		}, generator));
 	}
 
 	bitmap_represent operator()(unsigned w, unsigned h, unsigned level) const{
-		return std::visit<bitmap>([&]<vk::texture_source_prov T>(const T& prov){
-			return prov.operator()(w, h, level);
+		return std::visit<bitmap_represent>(overload{
+			[&](const msdf::prebaked_sdf& baked) -> bitmap_represent{
+				return baked(w, h, level);
+			},
+			[&]<vk::texture_source_prov T>(const T& prov) -> bitmap_represent{
+				bitmap generated = prov.operator()(w, h, level);
+				if(on_generated) on_generated(level, generated);
+				return generated;
+			}
 		}, generator);
 	}
 };
@@ -279,15 +336,20 @@ private:
 
 	std::multimap<VkDeviceSize, vk::buffer> stagings{};
 
-	std::mutex load_queue_mutex_{};
-	std::condition_variable load_queue_cond_{};
+	//load work goes through the lock-free ring, the locked overflow only takes what does not fit
+	mpmc_queue<allocated_image_load_description> load_queue_{load_queue_capacity_};
+	std::mutex load_overflow_mutex_{};
+	circular_queue<allocated_image_load_description> load_overflow_{};
+	std::atomic_bool has_load_overflow_{false};
+
+	std::atomic_uint32_t load_wake_epoch_{0};
+	std::atomic_uint sleeping_cpu_workers_{0};
 
 	std::mutex gpu_queue_mutex_{};
 	ccur::condition_variable_single gpu_queue_cond_{};
 
 
 	circular_queue<texture_allocation_request> alloc_queue{};
-	circular_queue<allocated_image_load_description> load_queue{};
 	ccur::mpsc_queue<prepared_image_upload> prepared_queue_{};
 	std::atomic_uint outstanding_work_count_{0};
 	std::atomic_bool stop_requested_{false};
@@ -298,16 +360,67 @@ private:
 	std::vector<async_image_loader_cpu_worker> cpu_workers_{};
 
 
-	static constexpr unsigned max_cpu_worker_count_ = 4;
+	static constexpr std::size_t load_queue_capacity_ = 1024;
 
-	[[nodiscard]] static unsigned calculate_cpu_worker_count() noexcept{
+	[[nodiscard]] static unsigned calculate_cpu_worker_count(unsigned requested) noexcept{
+		if(requested != 0) return requested;
 		const auto hc = std::thread::hardware_concurrency();
-		const auto available = hc > 2 ? hc - 2 : 1u;
-		return std::min(max_cpu_worker_count_, available);
+		return hc > 2 ? hc - 2 : 1u;
 	}
 
 	void notify_cpu_workers_() noexcept{
-		load_queue_cond_.notify_all();
+		load_wake_epoch_.fetch_add(1, std::memory_order::seq_cst);
+		load_wake_epoch_.notify_all();
+	}
+
+	/**
+	 * @brief Wake up to `count` sleeping workers, no-op while every worker is busy.
+	 */
+	void wake_cpu_workers_(unsigned count) noexcept{
+		std::atomic_thread_fence(std::memory_order::seq_cst);
+		load_wake_epoch_.fetch_add(1, std::memory_order::seq_cst);
+		const auto sleeping = sleeping_cpu_workers_.load(std::memory_order::seq_cst);
+		if(sleeping == 0) return;
+
+		if(count >= sleeping){
+			load_wake_epoch_.notify_all();
+		} else{
+			for(unsigned i = 0; i < count; ++i) load_wake_epoch_.notify_one();
+		}
+	}
+
+	[[nodiscard]] bool has_load_work_() const noexcept{
+		return !load_queue_.empty_approx() || has_load_overflow_.load(std::memory_order::seq_cst);
+	}
+
+	[[nodiscard]] std::optional<allocated_image_load_description> pop_load_work_() noexcept{
+		if(auto item = load_queue_.try_pop()) return item;
+		if(!has_load_overflow_.load(std::memory_order::acquire)) return std::nullopt;
+
+		std::lock_guard lock(load_overflow_mutex_);
+		if(load_overflow_.empty()) return std::nullopt;
+		std::optional item{std::move(load_overflow_.front())};
+		load_overflow_.pop_front();
+		if(load_overflow_.empty()) has_load_overflow_.store(false, std::memory_order::release);
+		return item;
+	}
+
+	void wait_for_load_work_(const std::stop_token& stop_token) noexcept{
+		const auto epoch = load_wake_epoch_.load(std::memory_order::seq_cst);
+		sleeping_cpu_workers_.fetch_add(1, std::memory_order::seq_cst);
+		std::atomic_thread_fence(std::memory_order::seq_cst);
+		if(!has_load_work_() && !stop_token.stop_requested()){
+			load_wake_epoch_.wait(epoch, std::memory_order::seq_cst);
+		}
+		sleeping_cpu_workers_.fetch_sub(1, std::memory_order::seq_cst);
+	}
+
+	void discard_load_work_() noexcept{
+		std::size_t discard_count{};
+		while(pop_load_work_()){
+			++discard_count;
+		}
+		abandon_work_items_(discard_count);
 	}
 
 	void on_work_item_finished_() noexcept{
@@ -347,12 +460,7 @@ private:
 	}
 
 	void discard_pending_work_() noexcept{
-		{
-			std::lock_guard lock(load_queue_mutex_);
-			const auto discard_count = load_queue.size();
-			load_queue.clear();
-			abandon_work_items_(discard_count);
-		}
+		discard_load_work_();
 
 		{
 			std::lock_guard lock(gpu_queue_mutex_);
@@ -389,11 +497,15 @@ private:
 public:
 	[[nodiscard]] async_image_loader() = default;
 
+	/**
+	 * @param cpu_worker_count decoding and SDF generation threads, 0 picks one per hardware thread but two
+	 */
 	[[nodiscard]] explicit async_image_loader(
 		vk::context_info context,
 		std::uint32_t graphic_family_index,
 		VkQueue working_queue,
-		image_view_registry& image_view_registry
+		image_view_registry& image_view_registry,
+		unsigned cpu_worker_count = 0
 	);
 
 	[[nodiscard]] registered_image_view register_image_view(
@@ -413,15 +525,48 @@ public:
 	[[nodiscard]] bool push(allocated_image_load_description&& desc){
 		if(stop_requested())return false;
 		outstanding_work_count_.fetch_add(1, std::memory_order::acq_rel);
-		{
-			std::lock_guard lock(load_queue_mutex_);
-			if(stop_requested()){
-				abandon_work_items_(1);
-				return false;
+		if(!load_queue_.try_push(std::move(desc))){
+			std::lock_guard lock(load_overflow_mutex_);
+			load_overflow_.emplace_back(std::move(desc));
+			has_load_overflow_.store(true, std::memory_order::seq_cst);
+		}
+
+		if(stop_requested()){
+			//raced with request_stop, which may already have drained the queue
+			discard_load_work_();
+			return false;
+		}
+		wake_cpu_workers_(1);
+		return true;
+	}
+
+	/**
+	 * @brief Queue a batch of loads at once, waking as many workers as there are loads instead of one per push.
+	 *
+	 * The descriptions are moved from.
+	 */
+	[[nodiscard]] bool push(const std::span<allocated_image_load_description> descs){
+		if(descs.empty()) return true;
+		if(stop_requested())return false;
+		outstanding_work_count_.fetch_add(static_cast<unsigned>(descs.size()), std::memory_order::acq_rel);
+
+		auto itr = descs.begin();
+		for(; itr != descs.end(); ++itr){
+			if(!load_queue_.try_push(std::move(*itr))) break;
+		}
+		if(itr != descs.end()){
+			std::lock_guard lock(load_overflow_mutex_);
+			for(; itr != descs.end(); ++itr){
+				load_overflow_.emplace_back(std::move(*itr));
 			}
-			load_queue.emplace_back(std::move(desc));
+			has_load_overflow_.store(true, std::memory_order::seq_cst);
 		}
-		load_queue_cond_.notify_one();
+
+		if(stop_requested()){
+			discard_load_work_();
+			return false;
+		}
+		wake_cpu_workers_(static_cast<unsigned>(descs.size()));
 		return true;
 	}
 
@@ -473,19 +618,33 @@ public:
 };
 
 
+/**
+ * @brief Region as stored in the page's maps, remembers its slot so retiring it also invalidates its handles.
+ */
+struct registered_image_region : allocated_image_region{
+	std::uint32_t slot{image_region_handle::invalid_index};
+
+	[[nodiscard]] registered_image_region(allocated_image_region&& region, const std::uint32_t slot) noexcept
+		: allocated_image_region(std::move(region)), slot(slot){
+	}
+};
+
 struct image_register_result{
 	allocated_image_region& region;
 	bool inserted;
+	image_region_handle handle{};
 
-	image_register_result(allocated_image_region& region, bool inserted)
+	image_register_result(allocated_image_region& region, bool inserted, image_region_handle handle = {})
 		: region(region),
-		inserted(inserted){
+		inserted(inserted),
+		handle(handle){
 		region.ref_incr();
 	}
 
-	image_register_result(allocated_image_region& region, bool inserted, std::adopt_lock_t)
+	image_register_result(allocated_image_region& region, bool inserted, std::adopt_lock_t, image_region_handle handle = {})
 		: region(region),
-		inserted(inserted){
+		inserted(inserted),
+		handle(handle){
 	}
 
 	~image_register_result(){
@@ -498,6 +657,39 @@ struct image_register_result{
 	image_register_result& operator=(image_register_result&& other) noexcept = delete;
 };
 
+/**
+ * @brief One region of a bulk registration, see `image_page::register_named_regions`.
+ */
+export
+template <typename Key>
+struct image_batch_entry{
+	Key key;
+	image_load_description desc;
+	bool mark_as_protected{};
+};
+
+/**
+ * @brief Texel usage of a page's sub pages, margins count as used.
+ */
+export
+struct image_page_occupancy{
+	std::size_t sub_page_count{};
+	std::uint64_t capacity_area{};
+	std::uint64_t used_area{};
+
+	[[nodiscard]] double ratio() const noexcept{
+		return capacity_area == 0 ? 0. : static_cast<double>(used_area) / static_cast<double>(capacity_area);
+	}
+};
+
+export
+struct image_batch_result{
+	/** @brief Handle of every entry, in the order they were passed. */
+	std::vector<image_region_handle> handles{};
+	std::size_t inserted_count{};
+	image_page_occupancy occupancy{};
+};
+
 export
 struct image_page_config{
 	math::usize2 extent{DefaultTexturePageSize};
@@ -505,6 +697,14 @@ struct image_page_config{
 	VkFormat format{};
 	std::uint32_t margin{4};
 	image_page_usage usage{image_page_usage::regular};
+
+	/**
+	 * @brief Texture memory (in bytes) the page may grow to before it starts evicting unreferenced regions instead.
+	 *
+	 * Regions still borrowed are never evicted, so a live set larger than the budget still grows the page.
+	 * 0 evicts before every growth.
+	 */
+	std::size_t memory_budget{};
 };
 
 struct image_page{
@@ -521,7 +721,19 @@ private:
 	image_page_usage usage_{image_page_usage::regular};
 	sampler_descriptor_index default_sampler_index_{auto_sampler_index};
 
-	concurrent_node_string_map<allocated_image_region> named_image_regions{};
+	region_slot_table<allocated_image_region> region_slots_{};
+	concurrent_node_string_map<registered_image_region> named_image_regions{};
+	concurrent_node_key_map<registered_image_region> keyed_image_regions{};
+
+	/**
+	 * @brief Current use epoch, read by every lookup and advanced by each eviction.
+	 *
+	 * Regions used within one epoch are not ordered among each other, which keeps lookups free of shared writes.
+	 */
+	std::atomic_uint64_t use_epoch_{1};
+
+	/** @brief Unreferenced regions are retired in batches of this size, retrying the allocation in between. */
+	static constexpr std::size_t eviction_batch_size = 32;
 
 	void register_sub_page_(sub_page& sub_page) const{
 		const auto registered = loader_->register_image_view(sub_page.texture.get_image_view(), default_sampler_index_);
@@ -532,7 +744,9 @@ private:
 public:
 	[[nodiscard]] image_page() = default;
 
-	//TODO support format spec
+	//TODO support format spec, `image_page_config::format` is ignored and pages are RGBA8.
+	//Block compressed formats additionally need regions aligned to 4x4 blocks, a CPU encode stage on the
+	//loader workers and mip chains uploaded by buffer copies, compressed images cannot be cleared or blitted.
 
 	[[nodiscard]] explicit image_page(
 		async_image_loader& loader,
@@ -605,33 +819,209 @@ public:
 		}
 
 		const auto extent = desc.get_extent();
+		check_fits_(extent);
+		return async_load(std::move(desc), acquire_region_(extent));
+	}
+
+	template <typename T>
+		requires (std::constructible_from<image_load_description, T>)
+	image_register_result register_named_region(
+		std::string_view name,
+		T&& desc,
+		const bool mark_as_protected = false) {
+		return register_region_in_(named_image_regions, name, std::forward<T>(desc), mark_as_protected);
+	}
+
+	/**
+	 * @brief Same as `register_named_region`, but keyed by an integer pair so hot lookups never format or hash strings.
+	 */
+	template <typename T>
+		requires (std::constructible_from<image_load_description, T>)
+	image_register_result register_keyed_region(
+		const image_region_key key,
+		T&& desc,
+		const bool mark_as_protected = false) {
+		return register_region_in_(keyed_image_regions, key, std::forward<T>(desc), mark_as_protected);
+	}
+
+	/**
+	 * @brief Register many regions at once, packing them in one pass instead of in arrival order.
+	 *
+	 * Regions not registered yet are placed largest first, which fills sub pages much tighter than placing them as
+	 * they come; their loads are dispatched together once everything is placed. Entries already registered
+	 * (or repeated in the batch) resolve to the existing region. The descriptions are moved from.
+	 *
+	 * Unlike `register_named_region` no reference is held on return, protect the entries that must survive `clear_unused`.
+	 */
+	image_batch_result register_named_regions(const std::span<image_batch_entry<std::string_view>> entries){
+		return register_regions_in_(named_image_regions, entries);
+	}
+
+	image_batch_result register_keyed_regions(const std::span<image_batch_entry<image_region_key>> entries){
+		return register_regions_in_(keyed_image_regions, entries);
+	}
+
+	/**
+	 * @brief Retire every unreferenced, unprotected region in a single pass, one sub map lock at a time.
+	 */
+	void clear_unused() noexcept {
+		clear_unused_in_(named_image_regions);
+		clear_unused_in_(keyed_image_regions);
+	}
+
+	/**
+	 * @brief Handle of a registered region, resolve it with `find` instead of hashing the name on every lookup.
+	 */
+	[[nodiscard]] image_region_handle handle_of(const std::string_view localName) const noexcept {
+		image_region_handle rst{};
+		named_image_regions.if_contains(localName, [&](const auto& pair) {
+			rst = region_slots_.handle_of(pair.second.slot);
+		});
+		return rst;
+	}
+
+	[[nodiscard]] image_region_handle handle_of(const image_region_key key) const noexcept {
+		image_region_handle rst{};
+		keyed_image_regions.if_contains(key, [&](const auto& pair) {
+			rst = region_slots_.handle_of(pair.second.slot);
+		});
+		return rst;
+	}
+
+	/**
+	 * @brief Whether the region behind the handle is still registered, it stops being so once evicted or cleaned up.
+	 */
+	[[nodiscard]] bool contains(const image_region_handle handle) const noexcept {
+		return region_slots_.resolve(handle) != nullptr;
+	}
+
+	[[nodiscard]] image_page_occupancy occupancy() noexcept{
+		std::lock_guard _{subpage_mtx_};
+		image_page_occupancy rst{.sub_page_count = subpages_.size()};
+		for(auto& subpage : subpages_){
+			rst.capacity_area += subpage.capacity_area();
+			rst.used_area += subpage.used_area();
+		}
+		return rst;
+	}
+
+	/** @brief Estimated texture memory of all sub pages, assuming 4 bytes per texel plus a full mip chain. */
+	[[nodiscard]] std::size_t memory_usage() noexcept{
+		std::lock_guard _{subpage_mtx_};
+		return subpages_.size() * sub_page_memory_();
+	}
+
+	/**
+	 * @brief Borrow the region behind the handle, empty if it was evicted, cleaned up or is being retired.
+	 *
+	 * The borrow is taken while the slot cannot be released, so the region cannot be freed in between.
+	 */
+	template <typename T>
+	[[nodiscard]] std::optional<universal_borrowed_constant_image_region<T, referenced_object_atomic_lazy>> find(const image_region_handle handle) noexcept {
+		std::optional<universal_borrowed_constant_image_region<T, referenced_object_atomic_lazy>> rst{};
+		region_slots_.visit(handle, [&](allocated_image_region& region) {
+			region.touch(use_stamp_());
+			rst = region.make_universal_borrow<T>();
+		});
+		return rst;
+	}
+
+	/**
+	 * @brief Same as `find(image_region_handle)`, the borrow is taken under the map lock.
+	 */
+	template <typename T>
+	[[nodiscard]] std::optional<universal_borrowed_constant_image_region<T, referenced_object_atomic_lazy>> find(const image_region_key key) noexcept {
+		std::optional<universal_borrowed_constant_image_region<T, referenced_object_atomic_lazy>> rst{};
+		keyed_image_regions.if_contains(key, [&](auto& pair) {
+			pair.second.touch(use_stamp_());
+			rst = pair.second.template make_universal_borrow<T>();
+		});
+		return rst;
+	}
+
+	template <typename T>
+	[[nodiscard]] auto* find(this T& self, const std::string_view localName) noexcept {
+		allocated_image_region* rst = nullptr;
+		self.named_image_regions.if_contains(localName, [&](auto& pair) {
+			pair.second.touch(self.use_stamp_());
+			rst = &pair.second;
+		});
+		return rst;
+	}
+
+	template <typename T>
+	[[nodiscard]] auto& at(this T& self, const std::string_view localName) {
+		allocated_image_region* rst = nullptr;
+		self.named_image_regions.if_contains(localName, [&](auto& pair) {
+			rst = &pair.second;
+		});
+		if (!rst) throw std::out_of_range("Key not found");
+		return *rst;
+	}
+
+	template <typename T>
+	[[nodiscard]] auto& operator[](this T& self, const std::string_view localName){
+		return self.at(localName);
+	}
+
+	~image_page() = default;
+	
+protected:
+	[[nodiscard]] std::uint64_t use_stamp_() const noexcept{
+		return use_epoch_.load(std::memory_order::relaxed);
+	}
+
+	[[nodiscard]] std::uint32_t acquire_slot_(){
+		const auto slot = region_slots_.acquire();
+		if(slot == image_region_handle::invalid_index){
+			throw bad_image_allocation{};
+		}
+		return slot;
+	}
+
+	[[nodiscard]] std::size_t sub_page_memory_() const noexcept{
+		const auto texels = static_cast<std::size_t>(config_.extent.x) * config_.extent.y;
+		return texels * 4 / 3 * 4;
+	}
+
+	[[nodiscard]] std::optional<page_acquire_result> try_acquire_(const math::usize2 extent){
+		std::lock_guard _{subpage_mtx_};
+		for(auto& subpass : subpages_){
+			if(auto rst = subpass.acquire(extent, config_.margin)){
+				return rst;
+			}
+		}
+		return std::nullopt;
+	}
+
+	void check_fits_(const math::usize2 extent) const{
 		if(extent.x + config_.margin > config_.extent.x || extent.y + config_.margin > config_.extent.y){
 			throw bad_image_allocation{};
 		}
+	}
 
+	/**
+	 * @brief Place a region of `extent` in the first sub page that fits, evicting or growing the page otherwise.
+	 */
+	[[nodiscard]] page_acquire_result acquire_region_(const math::usize2 extent){
 		while(true){
 			if(loader_->stop_requested()){
 				throw image_loader_stopped{};
 			}
 
 			//TODO optimize the mutex
-			{
-				std::lock_guard _{subpage_mtx_};
-				for(auto& subpass : subpages_){
-					if(auto rst = subpass.acquire(extent, config_.margin)){
-						return async_load(std::move(desc), std::move(rst.value()));
-					}
-				}
+			if(auto rst = try_acquire_(extent)){
+				return std::move(rst.value());
 			}
 
-			clear_unused();
-
-			{
-				std::lock_guard _{subpage_mtx_};
-				for(auto& subpass : subpages_){
-					if(auto rst = subpass.acquire(extent, config_.margin)){
-						return async_load(std::move(desc), std::move(rst.value()));
-					}
+			if(!can_grow_within_budget_()){
+				std::optional<page_acquire_result> acquired{};
+				evict_least_recently_used_([&]{
+					acquired = try_acquire_(extent);
+					return acquired.has_value();
+				});
+				if(acquired){
+					return std::move(acquired.value());
 				}
 			}
 
@@ -693,31 +1083,85 @@ public:
 			}
 
 			if(auto rst = sub_page->acquire(extent, config_.margin)){
-				return async_load(std::move(desc), std::move(rst.value()));
+				return std::move(rst.value());
 			}
 		}
 	}
 
-	template <typename T>
-		requires (std::constructible_from<image_load_description, T>)
-	image_register_result register_named_region(
-		std::string_view name,
+	[[nodiscard]] bool can_grow_within_budget_() noexcept{
+		std::lock_guard _{subpage_mtx_};
+		return (subpages_.size() + 1) * sub_page_memory_() <= config_.memory_budget;
+	}
+
+	/**
+	 * @brief Retire droppable regions oldest first, in batches, until `done` returns true or nothing is left.
+	 */
+	template <std::predicate<> Fn>
+	bool evict_least_recently_used_(Fn done){
+		struct candidate{
+			std::uint64_t last_use;
+			std::variant<std::string, image_region_key> key;
+		};
+
+		//regions used from now on rank after every candidate
+		use_epoch_.fetch_add(1, std::memory_order::relaxed);
+
+		std::vector<candidate> candidates{};
+		named_image_regions.for_each([&](const decltype(named_image_regions)::value_type& pair) {
+			if (pair.second.droppable()) {
+				candidates.push_back({pair.second.last_use(), pair.first});
+			}
+		});
+		keyed_image_regions.for_each([&](const decltype(keyed_image_regions)::value_type& pair) {
+			if (pair.second.droppable()) {
+				candidates.push_back({pair.second.last_use(), pair.first});
+			}
+		});
+
+		std::ranges::sort(candidates, {}, &candidate::last_use);
+
+		const auto retire = [this]<typename Map>(Map& map, const typename Map::key_type& key){
+			map.erase_if(key, [this](typename Map::value_type& pair) {
+				return retire_(pair.second);
+			});
+		};
+
+		for(auto batch : candidates | std::views::chunk(eviction_batch_size)){
+			for(const auto& [_, key] : batch){
+				if(const auto* name = std::get_if<std::string>(&key)){
+					retire(named_image_regions, *name);
+				}else{
+					retire(keyed_image_regions, std::get<image_region_key>(key));
+				}
+			}
+			if(done()) return true;
+		}
+
+		return done();
+	}
+
+	template <typename Map, typename Key, typename T>
+	image_register_result register_region_in_(
+		Map& map,
+		const Key& key,
 		T&& desc,
-		const bool mark_as_protected = false) {
+		const bool mark_as_protected) {
 
-		allocated_image_region* rst = nullptr;
+		registered_image_region* rst = nullptr;
 
 
-		named_image_regions.if_contains(name, [&](decltype(named_image_regions)::value_type& pair) {
+		map.if_contains(key, [&](typename Map::value_type& pair) {
 			rst = &pair.second;
 		});
 
 		if (rst != nullptr) {
 			if (mark_as_protected) rst->set_protected(true);
-			return {*rst, false};
+			rst->touch(use_stamp_());
+			return {*rst, false, region_slots_.handle_of(rst->slot)};
 		}
 
 		auto val = this->async_allocate(image_load_description{std::forward<T>(desc)});
+		val.touch(use_stamp_());
 
 
 		val.ref_incr();
@@ -725,86 +1169,192 @@ public:
 			val.set_protected(true);
 		}
 
-		bool inserted = named_image_regions.try_emplace_l(
-			name,
-			[&](decltype(named_image_regions)::value_type& pair) {
+		const auto slot = acquire_slot_();
+		bool inserted = map.try_emplace_l(
+			key,
+			[&](typename Map::value_type& pair) {
 				rst = &pair.second;
 			},
-			std::move(val)
+			std::move(val), slot
 		);
 
 		if (inserted) {
-			named_image_regions.if_contains(name, [&](decltype(named_image_regions)::value_type& pair) {
+			map.if_contains(key, [&](typename Map::value_type& pair) {
 				rst = &pair.second;
 			});
 			assert(rst != nullptr);
-			return image_register_result{*rst, true, std::adopt_lock};
+			region_slots_.publish(slot, *rst);
+			return image_register_result{*rst, true, std::adopt_lock, region_slots_.handle_of(slot)};
 		} else {
+			region_slots_.release(slot);
 			if (mark_as_protected) rst->set_protected(true);
 			assert(rst != nullptr);
-			return {*rst, false};
+			return {*rst, false, region_slots_.handle_of(rst->slot)};
 		}
 	}
 
-	void clear_unused() noexcept {
-		std::vector<std::string> keys_to_remove;
+	template <typename Map, typename Key>
+	image_batch_result register_regions_in_(Map& map, const std::span<image_batch_entry<Key>> entries){
+		if(loader_->stop_requested()){
+			throw image_loader_stopped{};
+		}
 
-		named_image_regions.for_each([&](const decltype(named_image_regions)::value_type& pair) {
-			if (pair.second.droppable()) {
-				keys_to_remove.push_back(pair.first);
+		struct placement{
+			std::size_t entry;
+			math::usize2 extent;
+			std::optional<page_acquire_result> acquired{};
+		};
+
+		image_batch_result result{};
+		result.handles.resize(entries.size());
+
+		std::vector<placement> placements{};
+		for(std::size_t i = 0; i < entries.size(); ++i){
+			auto& entry = entries[i];
+			registered_image_region* existing = nullptr;
+			map.if_contains(entry.key, [&](typename Map::value_type& pair) {
+				existing = &pair.second;
+			});
+
+			if(existing != nullptr){
+				if(entry.mark_as_protected) existing->set_protected(true);
+				existing->touch(use_stamp_());
+				result.handles[i] = region_slots_.handle_of(existing->slot);
+				continue;
 			}
-		});
 
-		for (const auto& key : keys_to_remove) {
-			named_image_regions.erase_if(key, [](decltype(named_image_regions)::value_type& pair) {
-				return pair.second.check_droppable_and_retire();
-			});
+			const auto extent = entry.desc.get_extent();
+			check_fits_(extent);
+			placements.push_back({i, extent});
 		}
-	}
 
-	template <typename T>
-	[[nodiscard]] auto* find(this T& self, const std::string_view localName) noexcept {
-		allocated_image_region* rst = nullptr;
-		self.named_image_regions.if_contains(localName, [&](auto& pair) {
-			rst = &pair.second;
+		//tall and wide regions first, they are the hardest to fit once the free space is fragmented
+		std::ranges::sort(placements, [](const placement& lhs, const placement& rhs){
+			const auto lhs_side = std::max(lhs.extent.x, lhs.extent.y);
+			const auto rhs_side = std::max(rhs.extent.x, rhs.extent.y);
+			if(lhs_side != rhs_side) return lhs_side > rhs_side;
+			return lhs.extent.area() > rhs.extent.area();
 		});
-		return rst;
+
+		for(auto& p : placements){
+			p.acquired = acquire_region_(p.extent);
+		}
+
+		std::vector<allocated_image_load_description> loads{};
+		std::vector<registered_image_region*> held{};
+		loads.reserve(placements.size());
+		held.reserve(placements.size());
+
+		try{
+			for(auto& p : placements){
+				auto& entry = entries[p.entry];
+				auto& [region, texture] = p.acquired.value();
+				const auto rect = region.get_region();
+
+				region.touch(use_stamp_());
+				//held until the loads are dispatched, so a concurrent cleanup cannot retire it in between
+				region.ref_incr();
+				if(entry.mark_as_protected) region.set_protected(true);
+
+				registered_image_region* rst = nullptr;
+				const auto slot = acquire_slot_();
+				const bool inserted = map.try_emplace_l(
+					entry.key,
+					[&](typename Map::value_type& pair) {
+						rst = &pair.second;
+					},
+					std::move(region), slot
+				);
+
+				if(inserted){
+					map.if_contains(entry.key, [&](typename Map::value_type& pair) {
+						rst = &pair.second;
+					});
+					assert(rst != nullptr);
+					region_slots_.publish(slot, *rst);
+					result.handles[p.entry] = region_slots_.handle_of(slot);
+					++result.inserted_count;
+					held.push_back(rst);
+
+					loads.push_back({
+						.texture = *texture,
+						.mip_level = texture->get_mip_level(),
+						.layer_index = 0,
+						.desc = std::move(entry.desc),
+						.region = rect
+					});
+				} else{
+					//repeated key in the batch, or registered concurrently
+					region_slots_.release(slot);
+					region.ref_decr();
+					assert(rst != nullptr);
+					if(entry.mark_as_protected) rst->set_protected(true);
+					result.handles[p.entry] = region_slots_.handle_of(rst->slot);
+				}
+			}
+
+			if(!loader_->push(std::span{loads})){
+				throw image_loader_stopped{};
+			}
+		} catch(...){
+			for(auto* region : held) region->ref_decr();
+			throw;
+		}
+
+		for(auto* region : held) region->ref_decr();
+		result.occupancy = occupancy();
+		return result;
 	}
 
-	template <typename T>
-	[[nodiscard]] auto& at(this T& self, const std::string_view localName) {
-		allocated_image_region* rst = nullptr;
-		self.named_image_regions.if_contains(localName, [&](auto& pair) {
-			rst = &pair.second;
-		});
-		if (!rst) throw std::out_of_range("Key not found");
-		return *rst;
+	/**
+	 * @brief Retire the region if nothing references it, its handles stop resolving from then on.
+	 */
+	bool retire_(registered_image_region& region) noexcept{
+		if(!region.check_droppable_and_retire()) return false;
+		region_slots_.release(region.slot);
+		return true;
 	}
 
-	template <typename T>
-	[[nodiscard]] auto& operator[](this T& self, const std::string_view localName){
-		return self.at(localName);
+	template <typename Map>
+	void clear_unused_in_(Map& map) noexcept{
+		for(std::size_t i = 0; i < map.subcnt(); ++i){
+			map.with_submap_m(i, [this](auto& submap){
+				for(auto itr = submap.begin(); itr != submap.end();){
+					if(retire_(itr->second)){
+						submap.erase(itr++);
+					}else{
+						++itr;
+					}
+				}
+			});
+		}
 	}
 
-	~image_page() = default;
-	
-protected:
-	void unlocked_clean_unused_(){
-		auto cur = named_image_regions.begin();
-		while(cur != named_image_regions.end()){
-			auto check = cur->second.check_droppable_and_retire();
+	template <typename Map>
+	void unlocked_clean_unused_(Map& map){
+		auto cur = map.begin();
+		while(cur != map.end()){
+			auto check = retire_(cur->second);
 			if(check){
-				cur = named_image_regions.erase(cur);
+				cur = map.erase(cur);
 			}else{
 				++cur;
 			}
 		}
 	}
 
+	void unlocked_clean_unused_(){
+		unlocked_clean_unused_(named_image_regions);
+		unlocked_clean_unused_(keyed_image_regions);
+	}
+
 	void drop(){
 		for (auto& region : named_image_regions | std::views::values){
 			region.set_protected(false);
 		}
+		for (auto& region : keyed_image_regions | std::views::values){
+			region.set_protected(false);
+		}
 
 		unlocked_clean_unused_();
 	}
@@ -817,6 +1367,9 @@ struct image_atlas_config{
 	VkQueue loader_working_queue{};
 	image_view_registry* image_view_registry{};
 	image_page_sampler_indices page_sampler_indices{};
+
+	/** @brief CPU threads decoding images and generating SDFs, 0 uses all hardware threads but two. */
+	unsigned cpu_worker_count{};
 };
 
 
@@ -849,7 +1402,8 @@ public:
 		config.ctx_info,
 		config.graphic_family_index,
 		config.loader_working_queue,
-		checked_image_view_registry_(config.image_view_registry))},
+		checked_image_view_registry_(config.image_view_registry),
+		config.cpu_worker_count)},
 	page_sampler_indices_{std::move(config.page_sampler_indices)}{
 		auto& image_view_registry = checked_image_view_registry_(config.image_view_registry);
 		for(const auto sampler_index : page_sampler_indices_ | std::views::values){
@@ -68,6 +68,28 @@ struct dumb_propagate_atomic_bool{
 	}
 };
 
+struct dumb_propagate_atomic_stamp{
+	mutable std::atomic_uint64_t stamp;
+
+	[[nodiscard]] dumb_propagate_atomic_stamp() = default;
+
+	dumb_propagate_atomic_stamp(const dumb_propagate_atomic_stamp& other) noexcept : stamp(other.stamp.load(std::memory_order::relaxed)) {
+	}
+
+	dumb_propagate_atomic_stamp(dumb_propagate_atomic_stamp&& other) noexcept : stamp(other.stamp.exchange(0, std::memory_order::relaxed)){
+	}
+
+	dumb_propagate_atomic_stamp& operator=(const dumb_propagate_atomic_stamp& other) noexcept{
+		stamp.store(other.stamp.load(std::memory_order::relaxed), std::memory_order::relaxed);
+		return *this;
+	}
+
+	dumb_propagate_atomic_stamp& operator=(dumb_propagate_atomic_stamp&& other) noexcept{
+		stamp.store(other.stamp.exchange(0, std::memory_order::relaxed), std::memory_order::relaxed);
+		return *this;
+	}
+};
+
 export
 struct allocated_image_region :
 	region_type,
@@ -78,6 +100,7 @@ protected:
 
 private:
 	dumb_propagate_atomic_bool tag;
+	dumb_propagate_atomic_stamp last_use_;
 
 public:
 	[[nodiscard]] constexpr allocated_image_region() = default;
@@ -136,6 +159,18 @@ public:
 		return false;
 	}
 
+	/** @brief Record a use of the region, the owning page evicts unreferenced regions with the oldest stamp first. */
+	void touch(const std::uint64_t stamp) const noexcept{
+		//stamps only change once per epoch, skip the store to keep hot regions' cache lines shared
+		if(last_use_.stamp.load(std::memory_order::relaxed) != stamp){
+			last_use_.stamp.store(stamp, std::memory_order::relaxed);
+		}
+	}
+
+	[[nodiscard]] std::uint64_t last_use() const noexcept{
+		return last_use_.stamp.load(std::memory_order::relaxed);
+	}
+
 	using referenced_object_atomic_lazy::droppable;
 	using referenced_object_atomic_lazy::check_droppable_and_retire;
 	using referenced_object_atomic_lazy::ref_decr;
@@ -290,6 +325,18 @@ public:
 		lock.release();
 	}
 
+	/** @brief Texels currently handed out, margins included. */
+	[[nodiscard]] std::uint64_t used_area() noexcept{
+		lock.acquire();
+		const auto rst = static_cast<std::uint64_t>(allocator.extent().area()) - allocator.remain_area();
+		lock.release();
+		return rst;
+	}
+
+	[[nodiscard]] std::uint64_t capacity_area() const noexcept{
+		return allocator.extent().area();
+	}
+
 public:
 	~sub_page(){
 #ifdef MO_YANXI_IMAGE_ATLAS_DESTRUCTOR_LEAK_CHECK
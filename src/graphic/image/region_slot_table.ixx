@@ -0,0 +1,148 @@
+export module mo_yanxi.graphic.region_slot_table;
+
+import std;
+
+namespace mo_yanxi::graphic{
+
+/**
+ * @brief Generational index of a region registered in an `image_page`.
+ *
+ * Resolving it is a table lookup, a handle of a region that was evicted or cleaned up simply resolves to nothing,
+ * even after its slot has been reused.
+ */
+export
+struct image_region_handle{
+	static constexpr std::uint32_t invalid_index = std::numeric_limits<std::uint32_t>::max();
+
+	std::uint32_t index{invalid_index};
+	std::uint32_t generation{};
+
+	constexpr bool operator==(const image_region_handle&) const noexcept = default;
+
+	constexpr explicit operator bool() const noexcept{
+		return index != invalid_index;
+	}
+};
+
+/**
+ * @brief Slot map from handles to the regions owned by the page's maps.
+ *
+ * Chunks are never moved once published, so resolving runs concurrently with registrations. Releasing a slot bumps
+ * its generation before the slot can be handed out again, and waits for every `visit` still using the old region.
+ */
+export
+template <typename Region>
+struct region_slot_table{
+private:
+	static constexpr std::uint32_t chunk_bits = 10;
+	static constexpr std::uint32_t chunk_size = 1u << chunk_bits;
+	static constexpr std::uint32_t max_chunks = 4096;
+
+	struct slot{
+		std::atomic<std::uint32_t> generation{};
+		std::atomic<Region*> region{};
+		std::uint32_t next_free{image_region_handle::invalid_index};
+	};
+
+	std::array<std::atomic<slot*>, max_chunks> chunks_{};
+	std::mutex mtx_{};
+	std::uint32_t size_{};
+	std::uint32_t free_head_{image_region_handle::invalid_index};
+
+	//held shared while a resolved region is used, the owner frees a region only after releasing its slot
+	mutable std::shared_mutex release_mtx_{};
+
+	[[nodiscard]] slot* find_slot_(const std::uint32_t index) const noexcept{
+		if(index == image_region_handle::invalid_index) return nullptr;
+		auto* chunk = chunks_[index >> chunk_bits].load(std::memory_order::acquire);
+		return chunk ? chunk + (index & (chunk_size - 1)) : nullptr;
+	}
+
+public:
+	[[nodiscard]] region_slot_table() = default;
+
+	region_slot_table(const region_slot_table&) = delete;
+	region_slot_table& operator=(const region_slot_table&) = delete;
+
+	~region_slot_table(){
+		for(auto& chunk : chunks_){
+			delete[] chunk.load(std::memory_order::relaxed);
+		}
+	}
+
+	/**
+	 * @return a free slot, `image_region_handle::invalid_index` once every slot is in use
+	 */
+	[[nodiscard]] std::uint32_t acquire(){
+		std::lock_guard _{mtx_};
+		if(free_head_ != image_region_handle::invalid_index){
+			const auto index = free_head_;
+			free_head_ = find_slot_(index)->next_free;
+			return index;
+		}
+
+		const auto index = size_;
+		if((index >> chunk_bits) >= max_chunks){
+			return image_region_handle::invalid_index;
+		}
+		if((index & (chunk_size - 1)) == 0){
+			chunks_[index >> chunk_bits].store(new slot[chunk_size], std::memory_order::release);
+		}
+		++size_;
+		return index;
+	}
+
+	void publish(const std::uint32_t index, Region& region) noexcept{
+		find_slot_(index)->region.store(&region);
+	}
+
+	void release(const std::uint32_t index) noexcept{
+		auto* s = find_slot_(index);
+		if(!s) return;
+
+		{
+			std::unique_lock _{release_mtx_};
+			s->generation.fetch_add(1);
+			s->region.store(nullptr);
+		}
+
+		std::lock_guard _{mtx_};
+		s->next_free = free_head_;
+		free_head_ = index;
+	}
+
+	[[nodiscard]] image_region_handle handle_of(const std::uint32_t index) const noexcept{
+		const auto* s = find_slot_(index);
+		if(!s) return {};
+		return {index, s->generation.load()};
+	}
+
+	/**
+	 * @warning The region may be freed as soon as this returns, only compare the result or use `visit`.
+	 */
+	[[nodiscard]] Region* resolve(const image_region_handle handle) const noexcept{
+		const auto* s = find_slot_(handle.index);
+		if(!s) return nullptr;
+
+		//the generation is read around the pointer, a slot released and reused in between is detected
+		if(s->generation.load() != handle.generation) return nullptr;
+		auto* region = s->region.load();
+		if(s->generation.load() != handle.generation) return nullptr;
+		return region;
+	}
+
+	/**
+	 * @brief Invoke `fn` with the region behind `handle`, a concurrent `release` of its slot waits until it returns.
+	 * @return whether the handle resolved
+	 */
+	template <std::invocable<Region&> Fn>
+	bool visit(const image_region_handle handle, Fn&& fn) const{
+		std::shared_lock _{release_mtx_};
+		auto* region = resolve(handle);
+		if(!region) return false;
+		std::invoke(fn, *region);
+		return true;
+	}
+};
+
+}
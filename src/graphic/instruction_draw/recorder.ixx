@@ -115,6 +115,8 @@ export
 struct chunk_start_pos {
     std::uint32_t head_idx;
     std::uint32_t byte_idx;
+
+    constexpr bool operator==(const chunk_start_pos&) const noexcept = default;
 };
 
 export
@@ -93,6 +93,27 @@ public:
 	}
 };
 
+/**
+ * @brief SDF mip chain generated ahead of time (e.g. restored from a persistent cache).
+ *
+ * Level `i` is a tightly packed RGBA8 image of `extent / (1 << i)`, the bytes must outlive the load.
+ */
+export
+struct prebaked_sdf{
+	static constexpr std::uint32_t max_levels = 3;
+
+	std::array<std::span<const std::byte>, max_levels> levels{};
+	math::usize2 extent{};
+	std::uint32_t level_count{};
+	/** @brief Keeps the storage behind `levels` alive while a load referencing it is queued. */
+	std::shared_ptr<const void> owner{};
+
+	[[nodiscard]] std::span<const std::byte> operator()(const unsigned w, const unsigned h, const unsigned mip_lv) const noexcept{
+		if(mip_lv >= level_count) return {};
+		return levels[mip_lv];
+	}
+};
+
 constexpr unsigned border_size = 96;
 constexpr double border_range = 4;
 
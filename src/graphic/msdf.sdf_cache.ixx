@@ -0,0 +1,352 @@
+module;
+
+#include <cassert>
+
+export module mo_yanxi.graphic.msdf.sdf_cache;
+
+import std;
+
+import mo_yanxi.graphic.msdf;
+import mo_yanxi.math.vector2;
+import mo_yanxi.platform.mapped_file;
+
+namespace mo_yanxi::graphic::msdf{
+
+/**
+ * @brief Payload of caches that store nothing beside the SDF itself.
+ */
+export
+struct sdf_cache_no_payload{
+	std::uint64_t reserved{};
+};
+
+struct sdf_cache_header{
+	static constexpr std::array<char, 4> expected_magic{'X', 'S', 'D', 'C'};
+	static constexpr std::uint32_t current_version = 1;
+
+	std::array<char, 4> magic{expected_magic};
+	std::uint32_t version{current_version};
+	std::uint64_t identity{};
+	std::uint32_t entry_count{};
+	std::uint32_t entry_size{};
+};
+
+//written to disk as is, every byte must be an explicit field
+static_assert(sizeof(sdf_cache_header) == 24);
+static_assert(std::is_trivially_copyable_v<sdf_cache_header>);
+
+template <typename Payload>
+struct sdf_cache_entry{
+	std::uint64_t key{};
+	std::uint32_t level_count{};
+	std::uint32_t extent_width{};
+	std::uint32_t extent_height{};
+	std::uint32_t reserved{};
+	std::uint64_t data_offset{};
+	Payload payload{};
+};
+
+export
+[[nodiscard]] constexpr std::size_t sdf_level_bytes(const std::uint32_t w, const std::uint32_t h, const std::uint32_t level) noexcept{
+	const auto scl = 1u << level;
+	return static_cast<std::size_t>(w / scl) * static_cast<std::size_t>(h / scl) * 4;
+}
+
+/**
+ * @brief Entry restored from a persistent_sdf_cache, `sdf` references the mapped file.
+ */
+export
+template <typename Payload>
+struct cached_sdf{
+	Payload payload{};
+	prebaked_sdf sdf{};
+
+	/**
+	 * @return false if the entry was recorded through `record_empty`
+	 */
+	[[nodiscard]] bool drawable() const noexcept{
+		return sdf.level_count != 0;
+	}
+};
+
+/**
+ * @brief Memory mapped file of MSDF mip chains keyed by 64 bit identities, shared by the glyph and the shape caches.
+ *
+ * The file is mapped on construction, restored entries reference the mapping directly. Newly generated entries are
+ * collected through `record_*` (callable from loader workers) and merged into the file by `save`.
+ *
+ * `identity` describes everything the whole file depends on (e.g. the font and the glyph size), a file written with
+ * another identity or payload type is discarded.
+ *
+ * File layout: header | entries (sorted by key) | level data
+ */
+export
+template <typename Payload = sdf_cache_no_payload>
+	requires (std::is_trivially_copyable_v<Payload> && sizeof(Payload) % sizeof(std::uint64_t) == 0)
+struct persistent_sdf_cache{
+	using payload_type = Payload;
+	using entry_type = sdf_cache_entry<Payload>;
+
+	static_assert(sizeof(entry_type) == 32 + sizeof(Payload), "cache entries must not contain padding");
+
+private:
+	struct pending_entry{
+		Payload payload{};
+		math::usize2 extent{};
+		std::uint32_t requested_levels{};
+		std::array<std::vector<std::byte>, prebaked_sdf::max_levels> levels{};
+	};
+
+	std::filesystem::path path_{};
+	std::uint64_t identity_{};
+
+	//shared with the restored entries, so queued loads keep the mapping alive after the file is replaced
+	std::shared_ptr<const platform::mapped_file> file_{};
+	std::vector<entry_type> entries_{};
+
+	mutable std::mutex pending_mtx_{};
+	std::map<std::uint64_t, pending_entry> pending_{};
+
+public:
+	[[nodiscard]] explicit persistent_sdf_cache(std::filesystem::path path, const std::uint64_t identity = 0) :
+		path_(std::move(path)), identity_(identity){
+		open_();
+	}
+
+	persistent_sdf_cache(const persistent_sdf_cache&) = delete;
+	persistent_sdf_cache& operator=(const persistent_sdf_cache&) = delete;
+
+	[[nodiscard]] const std::filesystem::path& path() const noexcept{
+		return path_;
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return entries_.size();
+	}
+
+	[[nodiscard]] std::optional<cached_sdf<Payload>> find(const std::uint64_t key) const noexcept{
+		const auto itr = std::ranges::lower_bound(entries_, key, {}, &entry_type::key);
+		if(itr == entries_.end() || itr->key != key){
+			return std::nullopt;
+		}
+
+		cached_sdf<Payload> rst{itr->payload};
+		rst.sdf.extent = {itr->extent_width, itr->extent_height};
+		rst.sdf.level_count = itr->level_count;
+
+		auto offset = static_cast<std::size_t>(itr->data_offset);
+		for(std::uint32_t lv = 0; lv < itr->level_count; ++lv){
+			const auto sz = sdf_level_bytes(itr->extent_width, itr->extent_height, lv);
+			rst.sdf.levels[lv] = file_->bytes().subspan(offset, sz);
+			offset += sz;
+		}
+		rst.sdf.owner = file_;
+		return rst;
+	}
+
+	/**
+	 * @brief Record an entry without image, restored with `drawable() == false`.
+	 */
+	void record_empty(const std::uint64_t key, const Payload& payload = {}){
+		std::lock_guard _{pending_mtx_};
+		pending_.insert_or_assign(key, pending_entry{.payload = payload});
+	}
+
+	/**
+	 * @brief Start recording an entry, it is only saved once each of its `levels` has been recorded.
+	 */
+	void record_begin(const std::uint64_t key, const math::usize2 extent, const std::uint32_t levels, const Payload& payload = {}){
+		std::uint32_t requested{};
+		while(requested < std::min(levels, prebaked_sdf::max_levels) && sdf_level_bytes(extent.x, extent.y, requested) != 0){
+			++requested;
+		}
+		if(requested == 0) return;
+
+		std::lock_guard _{pending_mtx_};
+		pending_.insert_or_assign(key, pending_entry{.payload = payload, .extent = extent, .requested_levels = requested});
+	}
+
+	void record_level(const std::uint64_t key, const std::uint32_t level, std::span<const std::byte> data){
+		if(level >= prebaked_sdf::max_levels) return;
+
+		std::lock_guard _{pending_mtx_};
+		const auto itr = pending_.find(key);
+		if(itr == pending_.end()) return;
+		auto& entry = itr->second;
+		if(level >= entry.requested_levels || data.size() != sdf_level_bytes(entry.extent.x, entry.extent.y, level)) return;
+		entry.levels[level].assign(data.begin(), data.end());
+	}
+
+	[[nodiscard]] bool has_pending() const noexcept{
+		std::lock_guard _{pending_mtx_};
+		return !pending_.empty();
+	}
+
+	/**
+	 * @brief Merge the recorded entries into the cache file.
+	 *
+	 * Entries whose generation stopped before every requested level was recorded are dropped, they would otherwise
+	 * be restored as a truncated mip chain by every later launch.
+	 *
+	 * Entries restored before keep the old mapping alive through `prebaked_sdf::owner`. Replacing a file that is still
+	 * mapped fails on some platforms, so call it once the loads referencing it have finished.
+	 */
+	bool save(){
+		std::lock_guard _{pending_mtx_};
+		if(pending_.empty()) return true;
+
+		std::vector<entry_type> entries{};
+		std::vector<std::span<const std::byte>> chunks{};
+		entries.reserve(entries_.size() + pending_.size());
+
+		std::uint64_t data_size{};
+		const auto push_entry = [&](entry_type entry, auto&& level_of){
+			entry.data_offset = data_size;
+			for(std::uint32_t lv = 0; lv < entry.level_count; ++lv){
+				auto bytes = level_of(lv);
+				chunks.push_back(bytes);
+				data_size += bytes.size();
+			}
+			entries.push_back(entry);
+		};
+
+		const auto push_restored = [&](const entry_type& entry){
+			push_entry(entry, [&, base = static_cast<std::size_t>(entry.data_offset)](std::uint32_t lv) mutable{
+				auto bytes = file_->bytes().subspan(base, sdf_level_bytes(entry.extent_width, entry.extent_height, lv));
+				base += bytes.size();
+				return bytes;
+			});
+		};
+
+		auto old_itr = entries_.begin();
+		for(const auto& [key, pending] : pending_){
+			for(; old_itr != entries_.end() && old_itr->key < key; ++old_itr){
+				push_restored(*old_itr);
+			}
+
+			const bool complete = std::ranges::none_of(pending.levels | std::views::take(pending.requested_levels), [](const std::vector<std::byte>& level){
+				return level.empty();
+			});
+			if(!complete){
+				//generation was cut off, keep the entry restored before (if any) instead
+				continue;
+			}
+			if(old_itr != entries_.end() && old_itr->key == key) ++old_itr;
+
+			push_entry(entry_type{
+				.key = key,
+				.level_count = pending.requested_levels,
+				.extent_width = pending.extent.x,
+				.extent_height = pending.extent.y,
+				.payload = pending.payload
+			}, [&](std::uint32_t lv){
+				return std::span<const std::byte>{pending.levels[lv]};
+			});
+		}
+
+		for(; old_itr != entries_.end(); ++old_itr){
+			push_restored(*old_itr);
+		}
+
+		const sdf_cache_header header{
+			.identity = identity_,
+			.entry_count = static_cast<std::uint32_t>(entries.size()),
+			.entry_size = static_cast<std::uint32_t>(sizeof(entry_type))
+		};
+		const auto data_base = sizeof(header) + entries.size() * sizeof(entry_type);
+		for(auto& entry : entries){
+			entry.data_offset += data_base;
+		}
+
+		std::error_code ec;
+		std::filesystem::create_directories(path_.parent_path(), ec);
+		auto temp_path = path_;
+		temp_path += ".tmp";
+
+		{
+			std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+			if(!out.is_open()) return false;
+			out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+			out.write(reinterpret_cast<const char*>(entries.data()), static_cast<std::streamsize>(entries.size() * sizeof(entry_type)));
+			for(const auto chunk : chunks){
+				out.write(reinterpret_cast<const char*>(chunk.data()), static_cast<std::streamsize>(chunk.size()));
+			}
+			if(!out) return false;
+		}
+
+		//drop our reference to the old mapping before replacing the file, restored entries still hold theirs
+		file_.reset();
+		entries_.clear();
+		pending_.clear();
+
+		std::filesystem::rename(temp_path, path_, ec);
+		if(ec){
+			std::filesystem::remove(temp_path, ec);
+			return false;
+		}
+
+		open_();
+		return true;
+	}
+
+private:
+	void open_() noexcept{
+		entries_.clear();
+		try{
+			file_ = std::make_shared<const platform::mapped_file>(path_);
+		} catch(...){
+			file_.reset();
+			return;
+		}
+		if(file_->size() < sizeof(sdf_cache_header)) return;
+
+		sdf_cache_header header;
+		std::memcpy(&header, file_->data(), sizeof(header));
+		if(
+			header.magic != sdf_cache_header::expected_magic ||
+			header.version != sdf_cache_header::current_version ||
+			header.identity != identity_ ||
+			header.entry_size != sizeof(entry_type)
+		){
+			file_.reset();
+			return;
+		}
+
+		const auto entries_size = static_cast<std::size_t>(header.entry_count) * sizeof(entry_type);
+		if(file_->size() < sizeof(header) + entries_size){
+			file_.reset();
+			return;
+		}
+
+		try{
+			entries_.resize(header.entry_count);
+		} catch(...){
+			file_.reset();
+			return;
+		}
+		std::memcpy(entries_.data(), file_->data() + sizeof(header), entries_size);
+
+		//reject truncated or corrupted files as a whole rather than handing out dangling spans
+		for(const auto& entry : entries_){
+			if(entry.level_count > prebaked_sdf::max_levels){
+				entries_.clear();
+				file_.reset();
+				return;
+			}
+
+			std::size_t total{};
+			for(std::uint32_t lv = 0; lv < entry.level_count; ++lv){
+				total += sdf_level_bytes(entry.extent_width, entry.extent_height, lv);
+			}
+			if(entry.data_offset > file_->size() || file_->size() - entry.data_offset < total){
+				entries_.clear();
+				file_.reset();
+				return;
+			}
+		}
+
+		assert(std::ranges::is_sorted(entries_, {}, &entry_type::key));
+	}
+};
+
+}
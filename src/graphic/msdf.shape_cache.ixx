@@ -0,0 +1,65 @@
+export module mo_yanxi.graphic.msdf.shape_cache;
+
+import std;
+
+export import mo_yanxi.graphic.msdf.sdf_cache;
+
+import mo_yanxi.graphic.msdf;
+import mo_yanxi.math.vector2;
+
+namespace mo_yanxi::graphic::msdf{
+
+/**
+ * @brief Version of the built-in shape generators, bump it whenever one of them (e.g. `create_capsule`) changes its output.
+ */
+export constexpr inline std::uint64_t shape_generator_version = 1;
+
+/**
+ * @brief Identity of a baked shape: its source bytes, the generator version and every parameter that changes the generated SDF.
+ */
+export
+[[nodiscard]] std::uint64_t hash_shape_source(
+	std::span<const std::byte> source,
+	const math::usize2 extent,
+	const std::uint32_t levels,
+	const bool orient_contours,
+	const double range = sdf_image_range,
+	const int border = sdf_image_border) noexcept{
+	static constexpr std::uint64_t prime = 0x100000001b3ULL;
+	std::uint64_t h = 0xcbf29ce484222325ULL ^ source.size();
+
+	for(const auto b : source){
+		h = (h ^ std::to_integer<std::uint64_t>(b)) * prime;
+	}
+
+	const std::array<std::uint64_t, 7> params{
+			shape_generator_version, extent.x, extent.y, levels, orient_contours,
+			std::bit_cast<std::uint64_t>(range), static_cast<std::uint64_t>(border)
+		};
+	for(const auto p : params){
+		h = (h ^ p) * prime;
+		h ^= h >> 29;
+	}
+
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
+export
+[[nodiscard]] std::uint64_t hash_shape_source(std::string_view source, const math::usize2 extent, const std::uint32_t levels, const bool orient_contours) noexcept{
+	return hash_shape_source(std::as_bytes(std::span{source}), extent, levels, orient_contours);
+}
+
+/**
+ * @brief Persistent MSDF mip chains of built-in shapes, so later launches upload them without running msdfgen.
+ *
+ * Shapes are looked up by `hash_shape_source`, a miss is generated as usual and recorded for `save`.
+ */
+export
+struct persistent_shape_cache : persistent_sdf_cache<>{
+	[[nodiscard]] explicit persistent_shape_cache(std::filesystem::path path) : persistent_sdf_cache(std::move(path)){}
+};
+
+}
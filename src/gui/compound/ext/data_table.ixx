@@ -19,6 +19,7 @@ import mo_yanxi.snap_shot;
 import mo_yanxi.math.vector2;
 import mo_yanxi.math.matrix3;
 import mo_yanxi.csv;
+import mo_yanxi.thread_pool;
 
 namespace mo_yanxi::gui::cpd{
 
@@ -26,17 +27,299 @@ export
 struct data_table_config{
 	float entry_height{80};
 	math::vec2 pad{16, 4};
+
+	/** @brief Rows laid out beyond each edge of the visible window. */
+	std::size_t overscan_rows{8};
+
+	/** @brief Laid out rows kept around after leaving the window, grown to fit the window if smaller. */
+	std::size_t row_cache_capacity{256};
+};
+
+export
+struct data_table_cell{
+	mr::string data{};
+	typesetting::line_alignment line_alignment{};
 };
+
+export
+/**
+ * @brief Read only view of a source row, handed to the filter of a query.
+ */
+struct data_table_row{
+	std::size_t index;
+	std::span<const data_table_cell> cells;
+
+	[[nodiscard]] std::string_view operator[](std::size_t col) const noexcept{
+		return cells[col].data;
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return cells.size();
+	}
+};
+
+export
+/**
+ * @brief Cells of a table in row major order, held in blocks of whole rows.
+ *
+ * A copy shares the blocks with its source, a block still shared is copied on its first write. A worker can hold a
+ * snapshot while the table keeps being edited, and an edit only copies the block it touches.
+ */
+class data_table_cells{
+public:
+	static constexpr std::size_t block_rows = 1024;
+
+private:
+	using block = mr::vector<data_table_cell>;
+
+	std::vector<std::shared_ptr<block>> blocks_{};
+	/**
+	 * @brief Epoch each block was created or last copied in, only blocks of the current epoch are written in place.
+	 *
+	 * Every `share` starts a new epoch on both sides, so a block a snapshot may still read is never written again
+	 * without relying on `shared_ptr::use_count`.
+	 */
+	std::vector<std::uint64_t> block_epochs_{};
+	std::uint64_t epoch_{};
+	std::size_t col_count_{};
+	std::size_t row_count_{};
+
+	[[nodiscard]] data_table_cells(const data_table_cells&) = default;
+
+public:
+	[[nodiscard]] data_table_cells() = default;
+
+	[[nodiscard]] explicit data_table_cells(std::size_t col_count) noexcept
+		: col_count_(col_count){
+	}
+
+	data_table_cells(data_table_cells&&) noexcept = default;
+	data_table_cells& operator=(data_table_cells&&) noexcept = default;
+	data_table_cells& operator=(const data_table_cells&) = delete;
+
+	/**
+	 * @brief Snapshot sharing every block, either side copies a block before its next write to it.
+	 */
+	[[nodiscard]] data_table_cells share(){
+		data_table_cells rst{*this};
+		++epoch_;
+		rst.epoch_ = epoch_;
+		return rst;
+	}
+
+	[[nodiscard]] std::size_t col_count() const noexcept{
+		return col_count_;
+	}
+
+	[[nodiscard]] std::size_t row_count() const noexcept{
+		return row_count_;
+	}
+
+	[[nodiscard]] std::span<const data_table_cell> row(std::size_t row) const noexcept{
+		return std::span{*blocks_[row / block_rows]}.subspan((row % block_rows) * col_count_, col_count_);
+	}
+
+	[[nodiscard]] const data_table_cell& operator[](std::size_t row_index, std::size_t col) const noexcept{
+		return row(row_index)[col];
+	}
+
+	[[nodiscard]] std::span<data_table_cell> mutable_row(std::size_t row){
+		return std::span{mutable_block_(row / block_rows)}.subspan((row % block_rows) * col_count_, col_count_);
+	}
+
+	/**
+	 * @return the default constructed cells of the new row
+	 */
+	std::span<data_table_cell> append_row(){
+		if(row_count_ % block_rows == 0){
+			auto& b = *blocks_.emplace_back(std::make_shared<block>());
+			block_epochs_.push_back(epoch_);
+			b.reserve(block_rows * col_count_);
+		}
+
+		auto& b = mutable_block_(blocks_.size() - 1);
+		b.resize(b.size() + col_count_);
+		++row_count_;
+		return std::span{b}.last(col_count_);
+	}
+
+private:
+	block& mutable_block_(std::size_t index){
+		auto& b = blocks_[index];
+		if(block_epochs_[index] != epoch_){
+			b = std::make_shared<block>(std::as_const(*b));
+			block_epochs_[index] = epoch_;
+		}
+		return *b;
+	}
+};
+
+export
+/**
+ * @brief Row order and visibility of a table, evaluated on a worker thread.
+ *
+ * The filter is invoked concurrently from the worker and must not touch the scene.
+ */
+struct data_table_query{
+	static constexpr std::size_t no_sort = std::numeric_limits<std::size_t>::max();
+
+	std::size_t sort_column{no_sort};
+	bool descending{};
+	std::function<bool(const data_table_row&)> filter{};
+};
+
+namespace data_table_detail{
+constexpr std::size_t parallel_sort_grain = 1uz << 15;
+
+/**
+ * @brief Sort chunks on the worker pool, then merge them pairwise.
+ *
+ * @return false if stopped before the range has been sorted
+ */
+template <typename T, typename Comp>
+bool parallel_sort(std::span<T> values, Comp comp, thread_pool& pool, const async_task_context& context){
+	const auto count = values.size();
+	const auto chunks = std::clamp<std::size_t>(count / parallel_sort_grain, 1, pool.size() + 1);
+	if(chunks == 1){
+		std::ranges::sort(values, comp);
+		return !context.stop_requested();
+	}
+
+	std::vector<std::size_t> bounds(chunks + 1);
+	for(std::size_t i = 0; i <= chunks; ++i){
+		bounds[i] = count * i / chunks;
+	}
+
+	pool.parallel_for(chunks, [&](std::size_t i){
+		std::ranges::sort(values.subspan(bounds[i], bounds[i + 1] - bounds[i]), comp);
+	});
+
+	for(std::size_t width = 1; width < chunks; width *= 2){
+		if(context.stop_requested()) return false;
+
+		pool.parallel_for((chunks - width + width * 2 - 1) / (width * 2), [&](std::size_t pair){
+			const auto i = pair * width * 2;
+			std::inplace_merge(
+				values.begin() + bounds[i],
+				values.begin() + bounds[i + width],
+				values.begin() + bounds[math::min(i + width * 2, chunks)],
+				comp);
+		});
+	}
+
+	return !context.stop_requested();
+}
+
+struct sort_key{
+	enum struct kind : std::uint8_t{
+		number,
+		text,
+		empty
+	};
+
+	double number;
+	std::string_view text;
+	std::uint32_t row;
+	kind type;
+
+	[[nodiscard]] static sort_key make(std::string_view field, std::uint32_t row) noexcept{
+		if(csv::is_numeric(field)){
+			auto first = field.data();
+			auto last = field.data() + field.size();
+			while(first != last && std::isspace(static_cast<unsigned char>(*first))) ++first;
+			if(first != last && *first == '+') ++first;
+
+			double value{};
+			if(std::from_chars(first, last, value).ec == std::errc{}){
+				return {value, field, row, kind::number};
+			}
+		}
+
+		return {0, field, row, field.empty() ? kind::empty : kind::text};
+	}
+};
+
+/**
+ * @brief Numbers compare by value before any text, empty cells always go last, ties keep the source order.
+ */
+[[nodiscard]] constexpr auto make_sort_key_comp(bool descending) noexcept{
+	return [descending](const sort_key& l, const sort_key& r) noexcept{
+		if(l.type != r.type) return l.type < r.type;
+
+		std::partial_ordering order = std::partial_ordering::equivalent;
+		switch(l.type){
+		case sort_key::kind::number : order = l.number <=> r.number;
+			break;
+		case sort_key::kind::text : order = l.text <=> r.text;
+			break;
+		default : break;
+		}
+
+		if(order != 0 && order != std::partial_ordering::unordered){
+			return descending ? order > 0 : order < 0;
+		}
+		return l.row < r.row;
+	};
+}
+}
+
 export
 struct data_table_desc{
 private:
 	using instr_recorder = graphic::g2d::draw_record_chunked_storage<mr::unvs_allocator<std::byte>>;
 
-	struct entry{
-		mr::string data{};
+	static void record_layout_instructions(
+		const typesetting::glyph_layout_draw_only& glyph_layout,
+		typesetting::line_alignment line_alignment,
+		instr_recorder& buffer){
+		using namespace mo_yanxi::graphic;
+		using namespace mo_yanxi::graphic::g2d;
+
+		for(const auto& current_line : glyph_layout.lines){
+			auto [line_src, spacing] = current_line.calculate_alignment(
+				glyph_layout.extent, line_alignment, typesetting::layout_direction::ltr);
+
+			for(const auto& [idx, val] : std::span{
+				    glyph_layout.elems.begin() + current_line.glyph_range.pos, current_line.glyph_range.size
+			    } | std::views::enumerate){
+				if(!val.texture->view) continue;
+				auto start = math::fma(static_cast<float>(idx), spacing, line_src + val.aabb.src);
+				buffer.push(rect_aabb{
+						.generic = {.image = val.texture->texture_binding()},
+						.v00 = start,
+						.v11 = start + val.aabb.extent(),
+						.uv00 = val.texture->uv.v00(),
+						.uv11 = val.texture->uv.v11(),
+						.vert_color = {val.color},
+						.slant_factor_asc = val.slant_factor_asc,
+						.slant_factor_desc = val.slant_factor_desc,
+						.sdf_expand = -val.weight_offset
+					});
+			}
+		}
+
+		buffer.split(true);
+	}
+
+	static void layout_text(
+		std::string_view data,
+		typesetting::glyph_layout_draw_only& glyph_layout,
+		typesetting::fast_plain_layout_context& ctx,
+		typesetting::tokenized_text& cache){
+		if(data.empty()){
+			glyph_layout.clear();
+			return;
+		}
+		cache.reset(data, typesetting::tokenize_tag::raw);
+		ctx.layout(cache, typesetting::layout_config{}, glyph_layout);
+	}
+
+	/** @brief Raw cell content, only rows inside the row cache own a glyph layout. */
+	using cell = data_table_cell;
+
+	struct entry : cell{
 		typesetting::glyph_layout_draw_only glyph_layout{};
 		bool dirty{true};
-		typesetting::line_alignment line_alignment{};
 
 		[[nodiscard]] entry() = default;
 
@@ -45,48 +328,16 @@ private:
 		}
 
 		bool try_update(
-			const typesetting::layout_config& cfg,
 			typesetting::fast_plain_layout_context& ctx,
 			typesetting::tokenized_text& cache){
 			if(!dirty) return false;
 			dirty = false;
-			if(data.empty()){
-				glyph_layout.clear();
-				return true;
-			}
-			cache.reset(data, typesetting::tokenize_tag::raw);
-			ctx.layout(cache, cfg, glyph_layout);
+			layout_text(data, glyph_layout, ctx, cache);
 			return true;
 		}
 
-		void record_instructions(instr_recorder& buffer){
-			using namespace mo_yanxi::graphic;
-			using namespace mo_yanxi::graphic::g2d;
-
-			for(const auto& current_line : glyph_layout.lines){
-				auto [line_src, spacing] = current_line.calculate_alignment(
-					glyph_layout.extent, line_alignment, typesetting::layout_direction::ltr);
-
-				for(const auto& [idx, val] : std::span{
-					    glyph_layout.elems.begin() + current_line.glyph_range.pos, current_line.glyph_range.size
-				    } | std::views::enumerate){
-					if(!val.texture->view) continue;
-					auto start = math::fma(static_cast<float>(idx), spacing, line_src + val.aabb.src);
-					buffer.push(rect_aabb{
-							.generic = {.image = val.texture->texture_binding()},
-							.v00 = start,
-							.v11 = start + val.aabb.extent(),
-							.uv00 = val.texture->uv.v00(),
-							.uv11 = val.texture->uv.v11(),
-							.vert_color = {val.color},
-							.slant_factor_asc = val.slant_factor_asc,
-							.slant_factor_desc = val.slant_factor_desc,
-							.sdf_expand = -val.weight_offset
-						});
-				}
-			}
-
-			buffer.split(true);
+		void record_instructions(instr_recorder& buffer) const{
+			record_layout_instructions(glyph_layout, line_alignment, buffer);
 		}
 	};
 
@@ -96,13 +347,49 @@ private:
 		snap_shot<float> actual_size;
 	};
 
+	/**
+	 * @brief A laid out row, with one instruction chunk per column.
+	 */
+	struct cached_row{
+		static constexpr std::size_t no_row = std::numeric_limits<std::size_t>::max();
+
+		std::size_t row{no_row};
+		std::uint64_t last_use{};
+		bool dirty{true};
+		mr::vector<typesetting::glyph_layout_draw_only> cells{};
+		instr_recorder instructions{};
+
+		[[nodiscard]] bool has_pending_glyphs() const noexcept{
+			return std::ranges::any_of(cells, &typesetting::glyph_layout_draw_only::has_pending_glyphs);
+		}
+
+		[[nodiscard]] bool is_pending_glyphs_landed() const noexcept{
+			return std::ranges::any_of(cells, &typesetting::glyph_layout_draw_only::is_pending_glyphs_landed);
+		}
+	};
+
+	using row_slot_map = std::unordered_map<
+		std::size_t, std::size_t, std::hash<std::size_t>, std::equal_to<std::size_t>,
+		mr::unvs_allocator<std::pair<const std::size_t, std::size_t>>>;
 
 	bool any_changed_{true};
+	bool has_pending_glyphs_{};
 	instr_recorder glyph_instructions{};
 	typesetting::fast_plain_layout_context plain_layout_context{};
 	typesetting::tokenized_text cache{};
 	mr::vector<head> table_heads_{};
-	mr::vector<entry> table_entries_{};
+	//blocks are shared with the workers evaluating a query, copied on write while they hold them
+	data_table_cells table_entries_{};
+
+	//source row of each displayed row, identity if there is no query
+	mr::vector<std::uint32_t> row_order_{};
+	bool has_row_order_{};
+
+	mr::vector<cached_row> row_cache_{};
+	row_slot_map row_slots_{};
+	std::uint64_t row_use_clock_{};
+	std::size_t window_row_begin_{};
+	std::size_t window_row_end_{};
 
 	data_table_config config_{};
 
@@ -124,26 +411,114 @@ public:
 	}
 
 	[[nodiscard]] std::size_t get_row_count() const noexcept{
-		const auto col = get_col_count();
-		if(!col) return 0;
-		return (table_entries_.size() + col - 1) / col;
+		return table_entries_.row_count();
+	}
+
+	/** @brief Rows shown by the table, the rows passing the query if there is one. */
+	[[nodiscard]] std::size_t get_displayed_row_count() const noexcept{
+		return has_row_order_ ? row_order_.size() : get_row_count();
+	}
+
+	[[nodiscard]] std::size_t get_source_row(std::size_t displayed_row) const noexcept{
+		return has_row_order_ ? row_order_[displayed_row] : displayed_row;
 	}
 
 	std::optional<math::vec2> pre_acquire_size(layout::optional_mastering_extent extent){
 		auto head_requried_ext = layout_heads();
-		head_requried_ext.y += (config_.entry_height + config_.pad.y) * get_row_count();
+		head_requried_ext.y += (config_.entry_height + config_.pad.y) * get_displayed_row_count();
 		extent_ = head_requried_ext;
 		return head_requried_ext;
 	}
 
+	/**
+	 * @brief Replace the content of a cell, only the row holding it is laid out again.
+	 *
+	 * The row order of an applied query is kept until the next query.
+	 *
+	 * @param row source row index
+	 * @return true if the cell is inside the table
+	 */
+	bool set_cell(std::size_t row, std::size_t col, std::string_view data){
+		const auto cols = get_col_count();
+		if(col >= cols || row >= get_row_count()) return false;
+
+		auto& c = table_entries_.mutable_row(row)[col];
+		c.data.assign(data);
+		c.line_alignment = csv::is_numeric(c.data)
+			                   ? typesetting::line_alignment::end
+			                   : typesetting::line_alignment::start;
+
+		invalidate_row(row);
+		return true;
+	}
+
+	void invalidate_row(std::size_t row) noexcept{
+		if(const auto itr = row_slots_.find(row); itr != row_slots_.end()){
+			row_cache_[itr->second].dirty = true;
+			any_changed_ = true;
+		}
+	}
+
+	/**
+	 * @brief Set the vertical range of the table to keep laid out, in table local coordinates.
+	 *
+	 * @return true if rows not laid out yet may have entered the window
+	 */
+	bool set_visible_window(float top, float height) noexcept{
+		const auto rows = get_displayed_row_count();
+		const float row_step = config_.entry_height + config_.pad.y;
+		std::size_t begin = 0;
+		std::size_t end = rows;
+
+		if(rows > 0 && row_step > 0.0f){
+			const float rows_top = rows_origin_y_();
+			begin = math::floor_to_integral<std::size_t>(math::max((top - rows_top) / row_step, 0.f));
+			end = math::ceil<std::size_t>(math::max((top + height - rows_top) / row_step, 0.f));
+
+			begin = begin > config_.overscan_rows ? begin - config_.overscan_rows : 0;
+			end = math::min(end + config_.overscan_rows, rows);
+			begin = math::min(begin, end);
+		}
+
+		const bool changed = begin != window_row_begin_ || end != window_row_end_;
+		window_row_begin_ = begin;
+		window_row_end_ = end;
+		return changed;
+	}
+
+	/**
+	 * @brief Lay out and record the rows inside the window that are not cached or have been invalidated.
+	 *
+	 * @return true if any row has been laid out
+	 */
+	bool update_visible_rows(){
+		bool any{};
+		const auto stamp = ++row_use_clock_;
+		const auto window = window_row_end_ - window_row_begin_;
+		const auto capacity = math::max(config_.row_cache_capacity, window + 1);
+		if(row_cache_.capacity() < capacity) row_cache_.reserve(capacity);
+
+		bool pending = std::ranges::any_of(table_heads_, [](const head& e){ return e.glyph_layout.has_pending_glyphs(); });
+		for(auto row = window_row_begin_; row < window_row_end_; ++row){
+			auto& slot = acquire_row_slot_(get_source_row(row), capacity);
+			slot.last_use = stamp;
+			if(slot.dirty){
+				layout_row_(slot);
+				any = true;
+			}
+			pending |= slot.has_pending_glyphs();
+		}
+
+		has_pending_glyphs_ = pending;
+		return any;
+	}
+
 	bool try_update_glyph_layouts(){
 		bool any{};
-		using namespace typesetting;
-		const layout_config cfg{};
 		math::vec2 extent{};
 
 		for(auto&& entry : table_heads_){
-			if(entry.try_update(cfg, plain_layout_context, cache)){
+			if(entry.try_update(plain_layout_context, cache)){
 				entry.actual_size = entry.glyph_layout.extent.x;
 				any = true;
 			}
@@ -151,39 +526,123 @@ public:
 			extent.x += config_.pad.x + entry.actual_size.temp;
 		}
 
-		for(auto&& entry : table_entries_){
-			any |= entry.try_update(cfg, plain_layout_context, cache);
-		}
-		extent.y += (config_.entry_height + config_.pad.y) * get_row_count() + config_.pad.y;
+		extent.y += (config_.entry_height + config_.pad.y) * get_displayed_row_count() + config_.pad.y;
 		extent_ = extent;
 
 		glyph_instructions.clear();
 		for(auto&& entry : table_heads_){
 			entry.record_instructions(glyph_instructions);
 		}
-		for(auto&& entry : table_entries_){
-			entry.record_instructions(glyph_instructions);
+
+		any |= update_visible_rows();
+		return any;
+	}
+
+	[[nodiscard]] bool has_pending_glyphs() const noexcept{
+		return has_pending_glyphs_;
+	}
+
+	/**
+	 * @brief Mark the heads and cached rows whose missing glyphs have been generated since their layout as dirty.
+	 *
+	 * @return true if any cell requires relayout
+	 */
+	bool refresh_landed_glyphs() noexcept{
+		if(!has_pending_glyphs_) return false;
+
+		bool any{};
+		for(auto& e : table_heads_){
+			if(e.glyph_layout.is_pending_glyphs_landed()){
+				e.dirty = true;
+				any = true;
+			}
+		}
+		for(auto& slot : row_cache_){
+			if(!slot.dirty && slot.is_pending_glyphs_landed()){
+				slot.dirty = true;
+				any = true;
+			}
 		}
 
+		any_changed_ |= any;
 		return any;
 	}
 
-	auto get_entry_grid() const noexcept{
-		return std::mdspan{table_entries_.data(), get_row_count(), get_col_count()};
+	[[nodiscard]] const data_table_cells& get_entries() const noexcept{
+		return table_entries_;
+	}
+
+	/** @brief Snapshot of the cells to hand to a worker, the table copies a block it shares before editing it. */
+	[[nodiscard]] data_table_cells share_entries(){
+		return table_entries_.share();
+	}
+
+	/**
+	 * @brief Display the source rows in the given order, rows not listed are hidden.
+	 *
+	 * Cached row layouts are kept since they are indexed by source row.
+	 */
+	void set_row_order(mr::vector<std::uint32_t> order) noexcept{
+		row_order_ = std::move(order);
+		has_row_order_ = true;
+		on_row_order_changed_();
+	}
+
+	void clear_row_order() noexcept{
+		row_order_.clear();
+		has_row_order_ = false;
+		on_row_order_changed_();
+	}
+
+	/**
+	 * @brief Filter and sort the source rows by a query, runs on a worker thread.
+	 *
+	 * @return the source row of each displayed row, or nullopt if stopped
+	 */
+	[[nodiscard]] static std::optional<mr::vector<std::uint32_t>> evaluate_query(
+		const data_table_cells& cells, const data_table_query& query,
+		thread_pool& pool, const async_task_context& context){
+		using namespace data_table_detail;
+
+		const auto col_count = cells.col_count();
+		const auto row_count = cells.row_count();
+		const auto row_cells = [&](std::size_t row){
+			return cells.row(row);
+		};
+
+		mr::vector<std::uint32_t> order{};
+		order.reserve(row_count);
+		for(std::size_t row = 0; row < row_count; ++row){
+			if(!query.filter || query.filter(data_table_row{row, row_cells(row)})){
+				order.push_back(static_cast<std::uint32_t>(row));
+			}
+
+			if((row & 0xffff) == 0 && context.stop_requested()) return std::nullopt;
+		}
+
+		if(query.sort_column >= col_count) return order;
+
+		std::vector<sort_key> keys{};
+		keys.reserve(order.size());
+		for(const auto row : order){
+			keys.push_back(sort_key::make(row_cells(row)[query.sort_column].data, row));
+		}
+
+		if(!parallel_sort(std::span{keys}, make_sort_key_comp(query.descending), pool, context)) return std::nullopt;
+
+		std::ranges::transform(keys, order.begin(), &sort_key::row);
+		return order;
 	}
 
 	void draw(gui::renderer_frontend& renderer, math::frect clipspace, math::vec2 draw_offset) const{
     renderer.top_viewport().push_local_transform();
 
-    const auto grid = get_entry_grid();
-    const auto num_rows = grid.extent(0);
-    const auto num_cols = grid.extent(1);
+    const auto& grid = get_entries();
+    const auto num_rows = get_displayed_row_count();
+    const auto num_cols = get_col_count();
 
 
-    float head_max_height = 0.0f;
-    for(const auto& entry : table_heads_){
-       head_max_height = math::max(head_max_height, entry.glyph_layout.extent.y);
-    }
+    const float head_max_height = head_height_();
 
 
 
@@ -340,26 +799,26 @@ public:
        return align::get_offset_of(p, layout_size, math::frect{cell_size});
     };
 
-    auto draw_entry = [&](const entry& e, math::vec2 src_offset, math::vec2 cell_size, math::usize2 coord){
-       if(e.empty()) return;
+    auto draw_entry = [&](
+       const typesetting::glyph_layout_draw_only& glyph_layout, typesetting::line_alignment line_alignment,
+       const graphic::g2d::instr_chunk& instr, math::vec2 src_offset, math::vec2 cell_size){
+       if(glyph_layout.elems.empty()) return;
 
        if(!math::frect{tags::from_extent, src_offset, cell_size}.overlap_exclusive(clipspace)) return;
 
        math::vec2 target_size;
-       if(cell_size.y >= e.glyph_layout.extent.y){
-          target_size = e.glyph_layout.extent;
+       if(cell_size.y >= glyph_layout.extent.y){
+          target_size = glyph_layout.extent;
        } else{
-          target_size = align::embed_to(align::scale::fillY, e.glyph_layout.extent, cell_size);
+          target_size = align::embed_to(align::scale::fillY, glyph_layout.extent, cell_size);
        }
 
-       const math::vec2 offset = src_offset + get_align_off(e.line_alignment, target_size, cell_size);
+       const math::vec2 offset = src_offset + get_align_off(line_alignment, target_size, cell_size);
 
-		mat3.set_rect_transform({}, e.glyph_layout.extent, offset, target_size);
+		mat3.set_rect_transform({}, glyph_layout.extent, offset, target_size);
 		renderer.top_viewport().set_local_transform(mat3);
 		renderer.notify_viewport_changed();
 
-		auto instr_idx = get_col_count() * coord.y + coord.x;
-		auto instr = glyph_instructions[instr_idx];
 		renderer << instr;
 	};
 
@@ -382,7 +841,7 @@ public:
                    tags::from_extent, draw_offset + current_offset,
                    {
                       head_entry.actual_size.temp + config_.pad.x,
-                      config_.pad.y + head_max_height + (config_.pad.y + config_.entry_height) * get_row_count()
+                      config_.pad.y + head_max_height + (config_.pad.y + config_.entry_height) * num_rows
                    }
                 }
              });
@@ -390,8 +849,8 @@ public:
           current_offset += config_.pad * .5f;
 
 
-          draw_entry(head_entry, current_offset + draw_offset, {head_entry.actual_size.temp, head_max_height},
-                     math::usize2((unsigned)col));
+          draw_entry(head_entry.glyph_layout, head_entry.line_alignment, glyph_instructions[col],
+                     current_offset + draw_offset, {head_entry.actual_size.temp, head_max_height});
 
 
 
@@ -400,9 +859,12 @@ public:
           current_offset.y += visible_row_start * row_step;
 
           for(std::size_t row = visible_row_start; row < visible_row_end; ++row){
-             auto& grid_entry = grid[row, col];
-             draw_entry(grid_entry, current_offset + draw_offset, {head_entry.actual_size.temp, config_.entry_height},
-                        math::usize2((unsigned)col, (unsigned)(row + 1)));
+             //rows scrolled in after the last layout are drawn once they have been laid out
+             const auto source_row = get_source_row(row);
+             if(const auto slot = find_cached_row_(source_row); slot && slot->cells.size() == num_cols){
+                draw_entry(slot->cells[col], grid[source_row, col].line_alignment, slot->instructions[col],
+                           current_offset + draw_offset, {head_entry.actual_size.temp, config_.entry_height});
+             }
 
              current_offset.y += row_step;
           }
@@ -424,52 +886,71 @@ public:
     renderer.notify_viewport_changed();
 }
 
-	static data_table_desc from_csv(const std::filesystem::path& path, char delimiter = ',', data_table_config config = {}){
+	static data_table_desc from_csv(const std::filesystem::path& path, thread_pool& pool, char delimiter = ',', data_table_config config = {}){
 		data_table_desc desc{config};
 
-		unsigned col_count{};
-
-		csv::parse_file(path, [&](csv::coord coord, std::string_view sv){
-			if(coord.row == 0){
-
-				col_count++;
-				auto& e = desc.table_heads_.emplace_back();
-				csv::unescape_csv_field(e.data, sv);
-				e.line_alignment = (typesetting::line_alignment::center);
-			} else{
-
-				if(coord.col >= col_count){
-					return;
-				}
-
-
+		const csv::mapped_reader reader{path, delimiter};
+		if(!reader){
+			std::error_code ec{};
+			if(std::filesystem::file_size(path, ec) != 0 || ec){
+				throw std::runtime_error("failed to open file: " + path.string());
+			}
+			return desc;
+		}
 
-				unsigned expected_index = (unsigned)((coord.row - 1) * col_count + coord.col);
+		reader.parse_parallel(pool, [&](csv::record_chunk&& chunk){
+			desc.append_records(chunk);
+		});
 
+		return desc;
+	}
 
+	/**
+	 * @brief Append parsed records, the first record of the source becomes the heads.
+	 *
+	 * Records are padded or truncated to the head count. With a query applied, the new rows are shown
+	 * after the ordered rows until the next query.
+	 */
+	void append_records(const csv::record_chunk& chunk){
+		append_records(chunk, 0, chunk.size());
+	}
 
-				while(desc.table_entries_.size() < expected_index){
-					desc.table_entries_.emplace_back();
+	/**
+	 * @brief Append the records [begin, begin + count) of the chunk.
+	 */
+	void append_records(const csv::record_chunk& chunk, std::size_t begin, std::size_t count){
+		const auto end = math::min(begin + count, chunk.size());
+		for(std::size_t i = begin; i < end; ++i){
+			const auto record = chunk[i];
+			if(chunk.first_row + i == 0){
+				for(const auto field : record){
+					auto& e = table_heads_.emplace_back();
+					csv::unescape_csv_field(e.data, field);
+					e.line_alignment = (typesetting::line_alignment::center);
 				}
+				table_entries_ = data_table_cells{get_col_count()};
+				continue;
+			}
 
+			const auto cols = get_col_count();
+			if(!cols) continue;
 
-				auto& e = desc.table_entries_.emplace_back();
-				csv::unescape_csv_field(e.data, sv);
+			if(has_row_order_) row_order_.push_back(static_cast<std::uint32_t>(table_entries_.row_count()));
+			const auto cells = table_entries_.append_row();
+			for(std::size_t col = 0; col < cols && col < record.size(); ++col){
+				auto& e = cells[col];
+				csv::unescape_csv_field(e.data, record[col]);
 				e.line_alignment = (csv::is_numeric(e.data)
 					                    ? typesetting::line_alignment::end
 					                    : typesetting::line_alignment::start);
 			}
-		}, delimiter);
-
-
-
-		if(col_count > 0){
-			while(desc.table_entries_.size() % col_count != 0){
-				desc.table_entries_.emplace_back();
-			}
 		}
 
-		return desc;
+		any_changed_ = true;
+	}
+
+	[[nodiscard]] const data_table_config& get_config() const noexcept{
+		return config_;
 	}
 
 	[[nodiscard]] math::vec2 get_extent() const{
@@ -514,11 +995,9 @@ public:
 
 private:
 	math::vec2 layout_heads(){
-		using namespace typesetting;
-		const layout_config cfg{};
 		math::vec2 extent{};
 		for(auto&& table_head : table_heads_){
-			if(table_head.try_update(cfg, plain_layout_context, cache)){
+			if(table_head.try_update(plain_layout_context, cache)){
 				table_head.actual_size = table_head.glyph_layout.extent.x;
 			}
 
@@ -528,6 +1007,68 @@ private:
 		extent.x += config_.pad.x;
 		return extent;
 	}
+
+	void on_row_order_changed_() noexcept{
+		//force the next window to be laid out for the new order
+		window_row_begin_ = window_row_end_ = 0;
+		any_changed_ = true;
+	}
+
+	[[nodiscard]] float head_height_() const noexcept{
+		float height = 0.0f;
+		for(const auto& entry : table_heads_){
+			height = math::max(height, entry.glyph_layout.extent.y);
+		}
+		return height;
+	}
+
+	[[nodiscard]] float rows_origin_y_() const noexcept{
+		return head_height_() + config_.pad.y * .5f;
+	}
+
+	[[nodiscard]] const cached_row* find_cached_row_(std::size_t row) const noexcept{
+		const auto itr = row_slots_.find(row);
+		if(itr == row_slots_.end()) return nullptr;
+		const auto& slot = row_cache_[itr->second];
+		return slot.dirty ? nullptr : &slot;
+	}
+
+	cached_row& acquire_row_slot_(std::size_t row, std::size_t capacity){
+		if(const auto itr = row_slots_.find(row); itr != row_slots_.end()){
+			return row_cache_[itr->second];
+		}
+
+		std::size_t index;
+		if(row_cache_.size() < capacity){
+			index = row_cache_.size();
+			row_cache_.emplace_back();
+		} else{
+			//rows of the current window carry the newest stamp, so the victim always lies outside of it
+			index = std::ranges::min_element(row_cache_, {}, &cached_row::last_use) - row_cache_.begin();
+			row_slots_.erase(row_cache_[index].row);
+		}
+
+		auto& slot = row_cache_[index];
+		slot.row = row;
+		slot.dirty = true;
+		row_slots_.emplace(row, index);
+		return slot;
+	}
+
+	void layout_row_(cached_row& slot){
+		const auto cells = table_entries_.row(slot.row);
+		slot.cells.resize(cells.size());
+		slot.instructions.clear();
+
+		for(std::size_t col = 0; col < cells.size(); ++col){
+			const auto& c = cells[col];
+			auto& glyph_layout = slot.cells[col];
+			layout_text(c.data, glyph_layout, plain_layout_context, cache);
+			record_layout_instructions(glyph_layout, c.line_alignment, slot.instructions);
+		}
+
+		slot.dirty = false;
+	}
 };
 
 }
@@ -566,13 +1107,108 @@ export
 struct data_table : public scroll_adaptor<data_table_desc>{
 private:
 	static constexpr std::size_t no_modified = std::numeric_limits<std::size_t>::max();
+	static constexpr std::size_t load_rows_per_update = 4096;
 	std::size_t last_modified_col = no_modified;
+	bool awaiting_glyphs_{};
+	bool in_update_{};
+
+	std::uint64_t query_serial_{};
+	async_operation_handle query_operation_{};
+
+	//the parser and the chunk being appended view the mapping, declared first so it is released last
+	std::shared_ptr<const csv::mapped_reader> load_reader_{};
+	std::optional<csv::parallel_chunk_parser> load_parser_{};
+	csv::record_chunk loading_chunk_{};
+	std::size_t loading_row_{};
 
 public:
 	[[nodiscard]] data_table(scene& scene, elem* parent)
 		: scroll_adaptor(scene, parent, layout::layout_specifier::fixed(layout::layout_policy::none)){
 	}
 
+	bool update(const float delta_in_ticks) override{
+		if(!scroll_adaptor::update(delta_in_ticks)) return false;
+
+		if(get_item().refresh_landed_glyphs()){
+			notify_isolated_layout_changed();
+		}
+		append_loaded_rows_();
+		sync_window_();
+		return true;
+	}
+
+	void layout_elem() override{
+		scroll_adaptor::layout_elem();
+		sync_window_();
+	}
+
+	void set_cell(std::size_t row, std::size_t col, std::string_view data){
+		if(get_item().set_cell(row, col, data)){
+			notify_isolated_layout_changed();
+		}
+	}
+
+	/**
+	 * @brief Sort and filter the rows on a worker, the table keeps its current order until the result arrives.
+	 *
+	 * A newer query or `clear_query` supersedes a pending one.
+	 */
+	async_operation_handle apply_query(data_table_query query){
+		const auto serial = supersede_query_();
+
+		query_operation_ = gui::request_async(
+			*this,
+			[cells = get_item().share_entries(), &pool = get_scene().get_worker_pool(), query = std::move(query)](
+			async_task_context& context){
+				//the pool outlives every task it runs
+				return data_table_desc::evaluate_query(cells, query, pool, context);
+			},
+			[serial, snapshot_rows = get_item().get_row_count()](data_table& table, std::optional<mr::vector<std::uint32_t>> order){
+				if(serial != table.query_serial_ || !order) return;
+				//rows appended while the query ran (e.g. by load_csv) were not in the snapshot, show them after the result
+				auto& item = table.get_item();
+				for(auto row = snapshot_rows; row < item.get_row_count(); ++row){
+					order->push_back(static_cast<std::uint32_t>(row));
+				}
+				item.set_row_order(std::move(*order));
+				table.notify_isolated_layout_changed();
+			});
+
+		return query_operation_;
+	}
+
+	/**
+	 * @brief Replace the table with a csv file parsed on the scene's worker pool, rows show up as chunks of the file complete.
+	 *
+	 * At most `load_rows_per_update` rows are appended per update, the rest of a parsed chunk waits for the next
+	 * ones. The workers stop parsing ahead while `max_parsed_ahead` chunks are waiting for the table.
+	 *
+	 * @return false if the file could not be mapped
+	 */
+	bool load_csv(const std::filesystem::path& path, char delimiter = ',', std::size_t max_parsed_ahead = 2){
+		supersede_query_();
+		stop_loading_();
+
+		get_item() = data_table_desc{get_item().get_config()};
+		notify_isolated_layout_changed();
+
+		auto reader = std::make_shared<const csv::mapped_reader>(path, delimiter);
+		if(!*reader) return false;
+
+		load_reader_ = std::move(reader);
+		load_parser_.emplace(get_scene().get_worker_pool(), load_reader_->data(), delimiter, load_reader_,
+			math::max(max_parsed_ahead, 1uz));
+
+		sync_update_();
+		return true;
+	}
+
+	void clear_query(){
+		supersede_query_();
+		get_item().clear_row_order();
+		notify_isolated_layout_changed();
+	}
+
 	void on_pointer_button(events::event_context& ctx, const events::pointer_button_event& event) override{
 		if(!ctx.is_target_or_bubble_phase()) return;
 		if(event.key.action == input_handle::act::press){
@@ -638,6 +1274,72 @@ public:
 
 		scroll_adaptor::on_pointer_drag(ctx, event);
 	}
+
+private:
+	std::uint64_t supersede_query_() noexcept{
+		query_operation_.request_stop();
+		query_operation_ = {};
+		return ++query_serial_;
+	}
+
+	void stop_loading_() noexcept{
+		//queued chunks hold the reader, they are dropped without waiting for the ones being parsed
+		load_parser_.reset();
+		loading_chunk_ = {};
+		loading_row_ = 0;
+		load_reader_.reset();
+	}
+
+	[[nodiscard]] bool loading_() const noexcept{
+		return load_reader_ != nullptr;
+	}
+
+	void append_loaded_rows_(){
+		if(!loading_()) return;
+
+		std::size_t budget = load_rows_per_update;
+		while(budget){
+			if(loading_row_ == loading_chunk_.size()){
+				auto chunk = load_parser_->try_next();
+				if(!chunk) break;
+				loading_chunk_ = std::move(*chunk);
+				loading_row_ = 0;
+			}
+
+			const auto count = math::min(budget, loading_chunk_.size() - loading_row_);
+			get_item().append_records(loading_chunk_, loading_row_, count);
+			loading_row_ += count;
+			budget -= count;
+		}
+
+		if(budget != load_rows_per_update){
+			notify_isolated_layout_changed();
+		}
+
+		if(loading_row_ == loading_chunk_.size() && load_parser_->done()){
+			stop_loading_();
+		}
+	}
+
+	void sync_update_(){
+		if(util::try_modify(in_update_, awaiting_glyphs_ || loading_())){
+			if(in_update_){
+				util::update_insert(*this, update_channel::custom);
+			} else{
+				util::update_erase(*this, update_channel::custom);
+			}
+		}
+	}
+
+	void sync_window_(){
+		auto& table = get_item();
+		if(table.set_visible_window(get_scroll_offset().y, get_viewport_extent().y)){
+			table.update_visible_rows();
+		}
+
+		awaiting_glyphs_ = table.has_pending_glyphs();
+		sync_update_();
+	}
 };
 }
 
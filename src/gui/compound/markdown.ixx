@@ -8,14 +8,19 @@ import mo_yanxi.utility;
 namespace mo_yanxi::gui::md {
 
 export struct ast_node;
-export using node_list = std::vector<ast_node>;
+
+/**
+ * @brief Nodes and their text live in the arena of the owning `markdown_document`,
+ * text is viewed from the source whenever the parser does not need to rewrite it.
+ */
+export using node_list = std::pmr::vector<ast_node>;
 
 export struct text {
-	std::u32string content;
+	std::u32string_view content;
 };
 
 export struct code_span {
-	std::u32string content;
+	std::u32string_view content;
 };
 
 export struct emphasis {
@@ -27,13 +32,13 @@ export struct strong_emphasis {
 };
 
 export struct link {
-	std::u32string url;
-	std::u32string title;
+	std::u32string_view url;
+	std::u32string_view title;
 	node_list children;
 };
 
 export struct image {
-	std::u32string url;
+	std::u32string_view url;
 	node_list alt;
 };
 
@@ -47,8 +52,8 @@ export struct heading {
 };
 
 export struct code_block {
-	std::u32string language;
-	std::u32string content;
+	std::u32string_view language;
+	std::u32string_view content;
 };
 
 export struct list_item {
@@ -58,7 +63,7 @@ export struct list_item {
 export struct list {
 	bool ordered{};
 	std::uint32_t start_number{1};
-	std::vector<list_item> items;
+	std::pmr::vector<list_item> items;
 };
 
 export struct thematic_break {
@@ -82,8 +87,8 @@ export struct table_cell {
 export struct table {
 	std::uint32_t cols{};
 	std::uint32_t rows{};
-	std::vector<table_align> alignments{};
-	std::vector<table_cell> cells{};
+	std::pmr::vector<table_align> alignments{};
+	std::pmr::vector<table_cell> cells{};
 
 	auto get_grid() noexcept {
 		assert(cells.size() == static_cast<std::size_t>(rows) * cols);
@@ -126,17 +131,35 @@ struct list_marker_info {
 	std::size_t marker_width{};
 };
 
+/**
+ * @brief Parses into nodes allocated from `arena`, which must outlive them.
+ *
+ * Text nodes view `input` directly, only text rewritten during parsing (stripped quotes and list items,
+ * normalized line breaks) is copied into the arena, so `input` must outlive the nodes as well.
+ */
 export class markdown_parser {
 public:
-	constexpr explicit markdown_parser(std::u32string_view input) : input_data_(input) {
+	explicit markdown_parser(std::u32string_view input, std::pmr::memory_resource& arena) : input_data_(input), arena_(&arena) {
 	}
 
-	constexpr node_list parse() const {
+	node_list parse() const {
 		return parse_blocks(input_data_, 0);
 	}
 
 private:
 	std::u32string_view input_data_;
+	std::pmr::memory_resource* arena_;
+
+	std::u32string_view intern(std::u32string_view s) const {
+		if(s.empty()) return {};
+		const std::less_equal<const char32_t*> le{};
+		if(le(input_data_.data(), s.data()) && le(s.data() + s.size(), input_data_.data() + input_data_.size())) {
+			return s;
+		}
+		auto* buffer = std::pmr::polymorphic_allocator<>{arena_}.allocate_object<char32_t>(s.size());
+		std::ranges::copy(s, buffer);
+		return {buffer, s.size()};
+	}
 
 	static constexpr std::size_t max_block_depth = 128;
 	static constexpr std::size_t max_inline_depth = 64;
@@ -496,9 +519,9 @@ private:
 		return line.starts_with(U">");
 	}
 
-	constexpr node_list parse_blocks(std::u32string_view text_block, std::size_t base_pos, std::size_t depth = 0) const {
-		if(depth >= max_block_depth) return {};
-		node_list blocks;
+	node_list parse_blocks(std::u32string_view text_block, std::size_t base_pos, std::size_t depth = 0) const {
+		if(depth >= max_block_depth) return node_list{arena_};
+		node_list blocks{arena_};
 		std::size_t current_pos = 0;
 
 		while(current_pos < text_block.size()) {
@@ -518,9 +541,10 @@ private:
 
 			if(auto h_level = count_heading_level(line); h_level > 0) {
 				std::u32string_view content = trim_left(line.substr(h_level));
-				heading h_node;
-				h_node.level = h_level;
-				h_node.children = parse_inlines(content, current_abs_pos + (content.data() - line.data()));
+				heading h_node{
+					.level = h_level,
+					.children = parse_inlines(content, current_abs_pos + (content.data() - line.data()))
+				};
 				blocks.push_back(ast_node{current_abs_pos, std::move(h_node)});
 				current_pos = std::min(line_end + 1, text_block.size());
 				continue;
@@ -537,15 +561,15 @@ private:
 				std::size_t block_end = text_block.find(U"\n```", line_end);
 
 				code_block cb_node;
-				cb_node.language = lang;
+				cb_node.language = intern(lang);
 
 				if(block_end != std::u32string_view::npos) {
 					auto content = text_block.substr(line_end + 1, block_end - (line_end + 1));
-				cb_node.content = content;
+				cb_node.content = intern(content);
 				current_pos = std::min(block_end + 4, text_block.size());
 			} else {
 				auto content = text_block.substr(std::min(line_end + 1, text_block.size()));
-				cb_node.content = content;
+				cb_node.content = intern(content);
 					current_pos = text_block.size();
 				}
 				blocks.push_back(ast_node{current_abs_pos, std::move(cb_node)});
@@ -573,17 +597,18 @@ private:
 					scan_pos = std::min(next_line_end + 1, text_block.size());
 				}
 
-				blockquote quote_node;
-				quote_node.children = parse_blocks(content, quote_start, depth + 1);
+				blockquote quote_node{.children = parse_blocks(content, quote_start, depth + 1)};
 				blocks.push_back(ast_node{quote_start, std::move(quote_node)});
 				current_pos = scan_pos;
 				continue;
 			}
 
 			if(auto marker = parse_list_marker(line); marker.valid) {
-				list list_node;
-				list_node.ordered = marker.ordered;
-				list_node.start_number = marker.number;
+				list list_node{
+					.ordered = marker.ordered,
+					.start_number = marker.number,
+					.items = std::pmr::vector<list_item>{arena_}
+				};
 
 				std::size_t scan_pos = current_pos;
 				while(scan_pos < text_block.size()) {
@@ -626,9 +651,9 @@ private:
 						next_pos = std::min(nested_line_end + 1, text_block.size());
 					}
 
-					list_item item;
-					item.blocks = parse_blocks(item_content, item_abs_pos + item_marker.indent + item_marker.marker_width, depth + 1);
-					list_node.items.push_back(std::move(item));
+					list_node.items.push_back(list_item{
+						.blocks = parse_blocks(item_content, item_abs_pos + item_marker.indent + item_marker.marker_width, depth + 1)
+					});
 					scan_pos = next_pos;
 				}
 
@@ -638,14 +663,16 @@ private:
 			}
 
 		if(auto ppt = preparse_table_header(text_block, current_pos); ppt.valid) {
-			table tbl_node;
-			tbl_node.cols = static_cast<std::uint32_t>(ppt.header_cells.size());
-			tbl_node.alignments = std::move(ppt.alignments);
+			table tbl_node{
+				.cols = static_cast<std::uint32_t>(ppt.header_cells.size()),
+				.alignments = std::pmr::vector<table_align>{ppt.alignments.begin(), ppt.alignments.end(), arena_},
+				.cells = std::pmr::vector<table_cell>{arena_}
+			};
 
 			for(auto& cv : ppt.header_cells) {
-				table_cell cell;
-				cell.children = parse_inlines(cv, base_pos + static_cast<std::size_t>(cv.data() - text_block.data()));
-				tbl_node.cells.push_back(std::move(cell));
+				tbl_node.cells.push_back(table_cell{
+					.children = parse_inlines(cv, base_pos + static_cast<std::size_t>(cv.data() - text_block.data()))
+				});
 			}
 			++tbl_node.rows;
 
@@ -658,11 +685,11 @@ private:
 
 				auto cells_text = split_table_cells(scan_line);
 				for(std::uint32_t i = 0; i < tbl_node.cols; ++i) {
-					table_cell cell;
-					if(i < cells_text.size()) {
-						cell.children = parse_inlines(cells_text[i], base_pos + static_cast<std::size_t>(cells_text[i].data() - text_block.data()));
-					}
-					tbl_node.cells.push_back(std::move(cell));
+					tbl_node.cells.push_back(table_cell{
+						.children = i < cells_text.size()
+							? parse_inlines(cells_text[i], base_pos + static_cast<std::size_t>(cells_text[i].data() - text_block.data()))
+							: node_list{arena_}
+					});
 				}
 				++tbl_node.rows;
 				scan_pos = std::min(next_line_end + 1, text_block.size());
@@ -688,7 +715,6 @@ private:
 			}
 
 		std::u32string_view para_content = text_block.substr(current_pos, para_end - current_pos);
-		paragraph p_node;
 		std::u32string normalize_buffer;
 		std::u32string_view content_for_inlines;
 		if(needs_line_break_normalize(para_content)) {
@@ -697,7 +723,7 @@ private:
 		} else {
 			content_for_inlines = trim_whitespace(para_content);
 		}
-		p_node.children = parse_inlines(content_for_inlines, current_abs_pos);
+		paragraph p_node{.children = parse_inlines(content_for_inlines, current_abs_pos)};
 		blocks.push_back(ast_node{current_abs_pos, std::move(p_node)});
 		current_pos = para_end;
 		}
@@ -705,23 +731,20 @@ private:
 		return blocks;
 	}
 
-	constexpr node_list parse_inlines(std::u32string_view inline_text, std::size_t base_pos, std::size_t depth = 0) const {
+	node_list parse_inlines(std::u32string_view inline_text, std::size_t base_pos, std::size_t depth = 0) const {
+		node_list inlines{arena_};
 		if(depth >= max_inline_depth) {
-			text t_node;
-			t_node.content.assign(inline_text.begin(), inline_text.end());
-			return {ast_node{base_pos, std::move(t_node)}};
+			inlines.push_back(ast_node{base_pos, text{intern(inline_text)}});
+			return inlines;
 		}
-		node_list inlines;
 		inlines.reserve(std::max<std::size_t>(1, inline_text.size() / 16));
 		std::size_t current_pos = 0;
 		std::size_t text_start = 0;
 
 			auto flush_text = [&]() {
 			if(current_pos > text_start) {
-				text t_node;
 				std::u32string_view t_content = inline_text.substr(text_start, current_pos - text_start);
-				t_node.content.assign(t_content.begin(), t_content.end());
-				inlines.push_back(ast_node{base_pos + text_start, std::move(t_node)});
+				inlines.push_back(ast_node{base_pos + text_start, text{intern(t_content)}});
 			}
 		};
 
@@ -733,10 +756,8 @@ private:
 				std::size_t end_backtick = inline_text.find(U'`', current_pos + 1);
 				if(end_backtick != std::u32string_view::npos) {
 					flush_text();
-					code_span cs_node;
 					auto content = inline_text.substr(current_pos + 1, end_backtick - current_pos - 1);
-					cs_node.content.assign(content.begin(), content.end());
-					inlines.push_back(ast_node{current_abs_pos, std::move(cs_node)});
+					inlines.push_back(ast_node{current_abs_pos, code_span{intern(content)}});
 					current_pos = end_backtick + 1;
 					text_start = current_pos;
 					continue;
@@ -753,13 +774,9 @@ private:
 					flush_text();
 					std::u32string_view inner_content = inline_text.substr(current_pos + offset, end_star - current_pos - offset);
 					if(is_strong) {
-				strong_emphasis se_node;
-				se_node.children = parse_inlines(inner_content, current_abs_pos + offset, depth + 1);
-				inlines.push_back(ast_node{current_abs_pos, std::move(se_node)});
+				inlines.push_back(ast_node{current_abs_pos, strong_emphasis{parse_inlines(inner_content, current_abs_pos + offset, depth + 1)}});
 			} else {
-				emphasis e_node;
-				e_node.children = parse_inlines(inner_content, current_abs_pos + offset, depth + 1);
-						inlines.push_back(ast_node{current_abs_pos, std::move(e_node)});
+						inlines.push_back(ast_node{current_abs_pos, emphasis{parse_inlines(inner_content, current_abs_pos + offset, depth + 1)}});
 					}
 					current_pos = end_star + offset;
 					text_start = current_pos;
@@ -770,12 +787,12 @@ private:
 			if(c == U'!' && current_pos + 1 < inline_text.size() && inline_text[current_pos + 1] == U'[') {
 				if(auto match = parse_inline_destination(inline_text, current_pos, true); match.valid) {
 						flush_text();
-						image img_node;
 						std::u32string_view alt_content = inline_text.substr(match.label_start, match.label_end - match.label_start);
-						img_node.alt = parse_inlines(alt_content, current_abs_pos + 2, depth + 1);
 						auto url = inline_text.substr(match.destination_start, match.destination_end - match.destination_start);
-						img_node.url.assign(url.begin(), url.end());
-						inlines.push_back(ast_node{current_abs_pos, std::move(img_node)});
+						inlines.push_back(ast_node{current_abs_pos, image{
+							.url = intern(url),
+							.alt = parse_inlines(alt_content, current_abs_pos + 2, depth + 1)
+						}});
 						current_pos = match.end_pos;
 						text_start = current_pos;
 						continue;
@@ -785,12 +802,12 @@ private:
 			if(c == U'[') {
 				if(auto match = parse_inline_destination(inline_text, current_pos, false); match.valid) {
 						flush_text();
-						link l_node;
 						std::u32string_view title_content = inline_text.substr(match.label_start, match.label_end - match.label_start);
-						l_node.children = parse_inlines(title_content, current_abs_pos + 1, depth + 1);
 						auto url = inline_text.substr(match.destination_start, match.destination_end - match.destination_start);
-						l_node.url.assign(url.begin(), url.end());
-						inlines.push_back(ast_node{current_abs_pos, std::move(l_node)});
+						inlines.push_back(ast_node{current_abs_pos, link{
+							.url = intern(url),
+							.children = parse_inlines(title_content, current_abs_pos + 1, depth + 1)
+						}});
 						current_pos = match.end_pos;
 						text_start = current_pos;
 						continue;
@@ -804,6 +821,47 @@ private:
 		return inlines;
 	}
 	};
+
+/**
+ * @brief A parsed markdown document whose source copy, nodes and text all live in one monotonic arena.
+ *
+ * Nothing in the arena owns memory elsewhere, so node destructors are never run and the whole document is
+ * released by dropping the arena.
+ */
+export class markdown_document {
+public:
+	[[nodiscard]] markdown_document() = default;
+
+	[[nodiscard]] explicit markdown_document(std::u32string_view source)
+		: arena_(std::make_unique<std::pmr::monotonic_buffer_resource>(initial_arena_size(source))) {
+		std::pmr::polymorphic_allocator<> alloc{arena_.get()};
+
+		auto* buffer = alloc.allocate_object<char32_t>(source.size());
+		std::ranges::copy(source, buffer);
+		source_ = {buffer, source.size()};
+
+		blocks_ = alloc.new_object<node_list>(markdown_parser{source_, *arena_}.parse());
+	}
+
+	[[nodiscard]] std::u32string_view source() const noexcept {
+		return source_;
+	}
+
+	[[nodiscard]] const node_list& blocks() const noexcept {
+		static const node_list empty{};
+		return blocks_ ? *blocks_ : empty;
+	}
+
+private:
+	std::unique_ptr<std::pmr::monotonic_buffer_resource> arena_{};
+	std::u32string_view source_{};
+	node_list* blocks_{};
+
+	static constexpr std::size_t initial_arena_size(std::u32string_view source) noexcept {
+		//the source copy plus roughly as much again for the nodes, later chunks grow geometrically
+		return source.size() * sizeof(char32_t) * 2 + 1024;
+	}
+};
 }
 
 namespace mo_yanxi::gui::md {
@@ -35,6 +35,8 @@ export struct markdown_image_config {
 	graphic::image_atlas* atlas{};
 	std::filesystem::path base_path{};
 	math::vec2 max_extent{1024.f, 640.f};
+	/** @brief Pixels per gui unit the images are drawn with, `max_extent` is multiplied by it to get the decoded size. */
+	math::vec2 render_scale{1.f, 1.f};
 	align::scale scaling{align::scale::fit};
 	align::pos align{align::pos::center_left};
 	bool wait_for_load{};
@@ -592,10 +594,15 @@ constant_image_region_borrow load_markdown_image_region(
 
 	const auto path = resolve_markdown_image_path(image_config, node.url);
 	const std::string path_string = path.string();
-	const std::string region_name = std::format("markdown:{}", path_string);
+	//decoded at the pixel size it is drawn with, views with different bounds must not share the downscaled image
+	const auto max_extent = (image_config.max_extent * image_config.render_scale).ceil().as<unsigned>();
+	const std::string region_name = std::format("markdown:{}@{}x{}", path_string, max_extent.x, max_extent.y);
 	auto result = image_config.page->register_named_region(
 		region_name,
-		graphic::image_load_description{graphic::bitmap_path_load{path_string}});
+		graphic::image_load_description{graphic::bitmap_path_load{
+			.path = path_string,
+			.max_extent = max_extent
+		}});
 	return constant_image_region_borrow{result.region};
 }
 
@@ -653,7 +660,7 @@ sequence& append_block_container(sequence& parent, const markdown_config& config
 	return hdl.elem();
 }
 
-void build_blocks(sequence& parent, const md::node_list& nodes, const markdown_config& config, std::uint32_t depth = 0);
+void build_blocks(sequence& parent, std::span<const md::ast_node> nodes, const markdown_config& config, std::uint32_t depth = 0);
 
 void build_list(sequence& parent, const md::list& node, const markdown_config& config, std::uint32_t depth = 0) {
 	if(depth > 128) return;
@@ -876,7 +883,7 @@ void build_blockquote(sequence& parent, const md::blockquote& node, const markdo
 	build_blocks(container, node.children, config, depth);
 }
 
-void build_blocks(sequence& parent, const node_list& nodes, const markdown_config& config, std::uint32_t depth) {
+void build_blocks(sequence& parent, std::span<const ast_node> nodes, const markdown_config& config, std::uint32_t depth) {
 	if(depth > 128) return;
 	inline_renderer render{config};
 
@@ -923,11 +930,9 @@ export inline void append_markdown(
 	const markdown_config& config = {},
 	std::uint32_t depth = 0
 ) {
-	markdown_parser parser{markdown_text};
+	const markdown_document document{markdown_text};
 
-	auto ast = parser.parse();
-
-	build_blocks(parent, ast, config, depth);
+	build_blocks(parent, document.blocks(), config, depth);
 	wait_markdown_images_if_requested(parent, config);
 }
 
@@ -969,4 +974,280 @@ export inline elem_ptr build_markdown(
 	return root;
 }
 
+/**
+ * @brief Block list of a `markdown_view`, only blocks near the visible window exist as elements.
+ *
+ * Every top level block starts with a height estimated from its source length, it is replaced by the measured
+ * height once the block has been built, blocks leaving the window (with some hysteresis) are destroyed again.
+ */
+export struct markdown_blocks : basic_group {
+private:
+	struct block_slot {
+		const ast_node* node{};
+		elem* element{};
+		float offset{};
+		float height{};
+		bool measured{};
+	};
+
+	markdown_document document_{};
+	markdown_config config_{};
+	std::vector<block_slot> slots_{};
+
+	float estimated_width_{-1.f};
+	float total_height_{};
+	float window_top_{};
+	float window_height_{};
+
+	/** @brief Extra distance, in viewports, built ahead of the window; blocks are released at twice that distance. */
+	static constexpr float overscan_ratio = .5f;
+	static constexpr std::size_t max_settle_passes = 4;
+
+public:
+	[[nodiscard]] markdown_blocks(scene& scene, elem* parent)
+		: basic_group(scene, parent) {
+	}
+
+	void set_document(markdown_document&& document, const markdown_config& config) {
+		basic_group::clear();
+		document_ = std::move(document);
+		config_ = config;
+
+		slots_.clear();
+		slots_.reserve(document_.blocks().size());
+		for(const ast_node& node : document_.blocks()) {
+			slots_.push_back({.node = &node});
+		}
+		estimated_width_ = -1.f;
+
+		notify_layout_changed(propagate_mask::upper | propagate_mask::force_upper);
+	}
+
+	[[nodiscard]] const markdown_document& document() const noexcept {
+		return document_;
+	}
+
+	[[nodiscard]] std::size_t materialized_count() const noexcept {
+		return children_.size();
+	}
+
+	[[nodiscard]] layout::layout_policy get_layout_policy() const noexcept override {
+		return layout::layout_policy::hori_major;
+	}
+
+	/**
+	 * @brief Move the visible window, in content coordinates of this element.
+	 */
+	void set_visible_window(const float top, const float height) {
+		const bool moved = util::try_modify(window_top_, top);
+		const bool resized = util::try_modify(window_height_, height);
+		if(!moved && !resized) return;
+		sync_blocks_(false);
+	}
+
+	void layout_elem() override {
+		prepare_estimates_(content_width());
+		//built blocks may have changed on their own, e.g. an image finished loading
+		sync_blocks_(true);
+		elem::layout_elem();
+		refresh_overflowed_state_from_children();
+	}
+
+protected:
+	std::optional<math::vec2> pre_acquire_size_impl(layout::optional_mastering_extent extent) override {
+		if(extent.width_pending()) return std::nullopt;
+		prepare_estimates_(extent.potential_width());
+		return math::vec2{extent.potential_width(), total_height_};
+	}
+
+	void notify_layout_changed_on_element_change() override {
+		//materializing or releasing blocks never changes the document height by itself
+	}
+
+private:
+	[[nodiscard]] float line_height_px_() const noexcept {
+		return config_.body_font_size_px() * 1.5f;
+	}
+
+	[[nodiscard]] float estimate_height_(std::size_t index, float width) const noexcept {
+		const auto source = document_.source();
+		const ast_node& node = *slots_[index].node;
+		const std::size_t end = index + 1 < slots_.size() ? slots_[index + 1].node->start_pos : source.size();
+		const auto text = source.substr(node.start_pos, end - node.start_pos);
+
+		float font_px = config_.body_font_size_px();
+		if(const auto* h = std::get_if<heading>(&node.data)) {
+			font_px = config_.heading_size_px(h->level);
+		} else if(std::holds_alternative<code_block>(node.data)) {
+			font_px = config_.code_block_font_size_px();
+		}
+
+		//rough advance of a latin glyph, wide glyphs are underestimated and corrected once measured
+		const float chars_per_line = std::max(1.f, width / (font_px * .55f));
+		float lines{};
+		for(const auto line : text | std::views::split(U'\n')) {
+			lines += std::max(1.f, std::ceil(static_cast<float>(std::ranges::distance(line)) / chars_per_line));
+		}
+
+		float height = lines * font_px * 1.5f + config_.block_pad * 2.f;
+		if(const auto* p = std::get_if<paragraph>(&node.data); p && config_.image && contains_top_level_image(p->children)) {
+			height += config_.image->max_extent.y;
+		}
+		return height;
+	}
+
+	void prepare_estimates_(const float width) {
+		if(width <= 0.f || !util::try_modify(estimated_width_, width)) return;
+
+		for(auto&& [index, slot] : slots_ | std::views::enumerate) {
+			slot.measured = false;
+			slot.height = estimate_height_(static_cast<std::size_t>(index), width);
+		}
+		for(auto& slot : slots_) {
+			if(slot.element) place_block_(slot, width);
+		}
+		recompute_offsets_();
+	}
+
+	void recompute_offsets_() noexcept {
+		float offset{};
+		for(auto& slot : slots_) {
+			slot.offset = offset;
+			offset += slot.height;
+		}
+		total_height_ = offset;
+	}
+
+	/** @brief Size and position a built block, returns true if its measured height differs from what was assumed. */
+	bool place_block_(block_slot& slot, const float width) {
+		elem& e = *slot.element;
+		e.set_scaling(get_scaling());
+		e.restriction_extent = {width, layout::pending_size};
+
+		const auto size = e.pre_acquire_size({width, layout::pending_size}).value_or(math::vec2{width, slot.height});
+		e.resize({width, size.y}, propagate_mask::lower);
+		e.try_layout();
+
+		const bool changed = !slot.measured || slot.height != size.y;
+		slot.height = size.y;
+		slot.measured = true;
+		return changed;
+	}
+
+	bool materialize_(block_slot& slot, const float width) {
+		markdown_config config = config_;
+		if(config.image) config.image->render_scale = config.image->render_scale * get_scaling();
+
+		elem_ptr block{get_scene(), this, [&](sequence& seq) {
+			seq.set_style();
+			seq.set_layout_spec(layout::directional_layout_specifier::fixed(layout::layout_policy::hori_major));
+			seq.template_cell.set_pending();
+			seq.template_cell.set_pad({config.block_pad, config.block_pad});
+			build_blocks(seq, std::span{slot.node, 1}, config);
+		}};
+		slot.element = block.get();
+		basic_group::insert(children_.size(), std::move(block));
+		return place_block_(slot, width);
+	}
+
+	void release_(block_slot& slot) {
+		basic_group::erase_instantly(find_index(std::exchange(slot.element, nullptr)));
+	}
+
+	void sync_blocks_(const bool remeasure) {
+		const float width = content_width();
+		if(width <= 0.f || slots_.empty()) return;
+
+		const float overscan = window_height_ * overscan_ratio;
+		const float total_before = total_height_;
+
+		if(remeasure) {
+			bool height_changed = false;
+			for(auto& slot : slots_) {
+				if(slot.element) height_changed = place_block_(slot, width) || height_changed;
+			}
+			if(height_changed) recompute_offsets_();
+		}
+
+		for(std::size_t pass = 0; pass < max_settle_passes; ++pass) {
+			const float build_top = window_top_ - overscan;
+			const float build_bottom = window_top_ + window_height_ + overscan;
+
+			bool height_changed = false;
+			for(auto& slot : slots_) {
+				const float top = slot.offset;
+				const float bottom = slot.offset + slot.height;
+
+				if(!slot.element) {
+					if(bottom >= build_top && top <= build_bottom) {
+						height_changed = materialize_(slot, width) || height_changed;
+					}
+				} else if(bottom < build_top - overscan || top > build_bottom + overscan) {
+					release_(slot);
+				}
+			}
+
+			if(!height_changed) break;
+			recompute_offsets_();
+		}
+
+		for(const auto& slot : slots_) {
+			if(!slot.element) continue;
+			slot.element->set_rel_pos({0.f, slot.offset});
+			slot.element->update_abs_src(content_src_pos_abs());
+		}
+
+		if(total_height_ != total_before) {
+			//the scroll pane intercepts this and re-queries the document height
+			notify_layout_changed(propagate_mask::upper | propagate_mask::force_upper);
+		}
+	}
+};
+
+/**
+ * @brief Scrollable markdown document that builds block elements lazily, see `markdown_blocks`.
+ *
+ * Use it for long documents, `append_markdown` builds every block up front.
+ * Images are loaded asynchronously, `markdown_image_config::wait_for_load` is ignored.
+ */
+export struct markdown_view : scroll_adaptor<markdown_blocks> {
+	[[nodiscard]] markdown_view(scene& scene, elem* parent)
+		: scroll_adaptor(scene, parent, layout::layout_specifier::fixed(layout::layout_policy::hori_major)) {
+	}
+
+	void set_markdown(std::u32string_view markdown_text, const markdown_config& config = {}) {
+		get_elem().set_document(markdown_document{markdown_text}, config);
+	}
+
+	void set_markdown_file(const std::filesystem::path& path, markdown_config config = {}) {
+		if(config.image && config.image->base_path.empty()) {
+			config.image->base_path = path.parent_path();
+		}
+
+		if(auto text = try_read_markdown_utf8_file(path)) {
+			set_markdown(*text, config);
+		} else {
+			std::u32string message = U"Failed to load markdown file:\n";
+			message.append(path.u32string());
+			set_markdown(message, config);
+		}
+	}
+
+	bool update(const float delta_in_ticks) override {
+		if(!scroll_adaptor::update(delta_in_ticks)) return false;
+		sync_window_();
+		return true;
+	}
+
+	void layout_elem() override {
+		scroll_adaptor::layout_elem();
+		sync_window_();
+	}
+
+private:
+	void sync_window_() {
+		get_elem().set_visible_window(get_scroll_offset().y, get_viewport_extent().y);
+	}
+};
+
 }
@@ -26,6 +26,7 @@ import mo_yanxi.byte_pool;
 import mo_yanxi.math.rect_ortho;
 import mo_yanxi.math.vector2;
 import mo_yanxi.math.matrix3;
+import mo_yanxi.gui.renderer.scissor_bound;
 import mo_yanxi.math;
 
 import mo_yanxi.meta_programming;
@@ -508,6 +509,16 @@ public:
 		return self.top_viewport().get_element_to_root_screen() * local_pt;
 	}
 
+	/**
+	 * @brief Bound of the current scissor in the current local space, anything outside of it is clipped anyway.
+	 */
+	[[nodiscard]] inline math::frect get_local_scissor_bound(this const renderer_frontend& self) noexcept {
+		assert(!self.viewports_.empty());
+		const auto& vp = self.top_viewport();
+		const auto scissor = vp.top_scissor();
+		return scissor_bound_in_local(scissor.rect, scissor.margin, vp.get_element_to_root_screen());
+	}
+
 
 
 
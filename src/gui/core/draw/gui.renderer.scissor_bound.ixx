@@ -0,0 +1,43 @@
+export module mo_yanxi.gui.renderer.scissor_bound;
+
+import mo_yanxi.math;
+import mo_yanxi.math.rect_ortho;
+import mo_yanxi.math.vector2;
+import mo_yanxi.math.matrix3;
+import std;
+
+namespace mo_yanxi::gui{
+
+/**
+ * @brief Bound of a scissor in an element's local space.
+ *
+ * Scissors are kept in root screen space, so the whole element to root screen transform is inverted, including the
+ * transforms of the viewports the element is drawn in.
+ *
+ * @param scissor scissor rect in root screen space
+ * @param margin extent the scissor is expanded by on every side
+ * @param element_to_root_screen transform from the element local space to the root screen
+ */
+export
+[[nodiscard]] inline math::frect scissor_bound_in_local(
+	const math::frect scissor, const float margin, const math::mat3& element_to_root_screen) noexcept{
+	math::mat3 to_local = element_to_root_screen;
+	to_local.inv();
+
+	const math::vec2 src = scissor.get_src() - math::vec2{margin, margin};
+	const math::vec2 end = scissor.get_end() + math::vec2{margin, margin};
+	const std::array corners{
+		to_local * src, to_local * math::vec2{end.x, src.y},
+		to_local * math::vec2{src.x, end.y}, to_local * end
+	};
+
+	math::vec2 min = corners[0];
+	math::vec2 max = corners[0];
+	for(const auto& p : corners){
+		min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+		max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+	}
+	return math::frect{tags::from_vertex, min, max};
+}
+
+}
@@ -605,6 +605,13 @@ public:
 		return layer_altitude_record_.get_max();
 	}
 
+	/**
+	 * @brief Pool running the work of `request_async`, tasks on it may split their work with `parallel_for`.
+	 */
+	[[nodiscard]] thread_pool& get_worker_pool() noexcept{
+		return worker_pool_;
+	}
+
 	void set_current_time(const float current_time){
 		current_time_ = current_time;
 	}
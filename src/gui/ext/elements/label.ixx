@@ -106,12 +106,27 @@ protected:
 private:
 
 	label_fit_type fit_type_{label_fit_type::fix};
+	bool awaiting_glyphs_{};
 
 
 	inline bool is_layout_expired_() const noexcept{
 		return change_mark_ != change_type{};
 	}
 
+	/**
+	 * @brief Listen on the update channel while the layout still misses glyph textures, so the label relayouts once they land.
+	 */
+	inline void sync_glyph_await_(){
+		const bool pending = glyph_layout_.has_pending_glyphs();
+		if(pending == awaiting_glyphs_) return;
+		awaiting_glyphs_ = pending;
+		if(pending){
+			util::update_insert(*this, update_channel::custom);
+		}else{
+			util::update_erase(*this, update_channel::custom);
+		}
+	}
+
 public:
 	align::pos text_entire_align{align::pos::top_left};
 	math::vec2 max_fit_scale_bound{math::vectors::constant2<float>::inf_positive_vec2};
@@ -232,6 +247,16 @@ public:
 		}
 	}
 
+	inline bool update(float delta_in_ticks) override{
+		if(!elem::update(delta_in_ticks)) return false;
+
+		if(awaiting_glyphs_ && glyph_layout_.is_pending_glyphs_landed()){
+			change_mark_ |= change_type::config;
+			notify_isolated_layout_changed();
+		}
+		return true;
+	}
+
 	inline void record_draw_layer(draw_recorder& call_stack_builder) const override{
 		elem::record_draw_layer(call_stack_builder);
 
@@ -373,6 +398,7 @@ protected:
 					get_layout()->layout(tokenized_text_, layout_config_, glyph_layout_);
 					render_cache_.update_buffer(glyph_layout_);
 					change_mark_ = change_type::none;
+					sync_glyph_await_();
 
 					return {process_result_ext(), true};
 				}
@@ -382,6 +408,7 @@ protected:
 			get_layout()->layout(tokenized_text_, layout_config_, glyph_layout_);
 			render_cache_.update_buffer(glyph_layout_);
 			change_mark_ = change_type::none;
+			sync_glyph_await_();
 
 			return {process_result_ext(), true};
 		}
@@ -10,6 +10,7 @@ import std;
 export import mo_yanxi.gui.text_edit_core;
 export import mo_yanxi.gui.text_render;
 import mo_yanxi.typesetting.rich_text;
+import mo_yanxi.typesetting.segmented_layout;
 import mo_yanxi.gui.infrastructure;
 import mo_yanxi.graphic.color;
 import mo_yanxi.math;
@@ -48,6 +49,29 @@ struct ime_composition_state{
 	std::uint32_t cursor{};
 };
 
+/**
+ * @brief Lets the segmented layout copy single paragraphs out of the document instead of flattening it.
+ */
+struct document_paragraph_source final : typesetting::paragraph_source{
+	const text_document* document;
+
+	[[nodiscard]] explicit document_paragraph_source(const text_document& document) noexcept : document(&document){
+	}
+
+	[[nodiscard]] std::uint32_t size() const noexcept override{
+		return static_cast<std::uint32_t>(document->size());
+	}
+
+	[[nodiscard]] std::uint32_t paragraph_end(const std::uint32_t pos) const noexcept override{
+		return static_cast<std::uint32_t>(document->line_end(document->line_of(pos)));
+	}
+
+	void copy_text(const std::uint32_t pos, const std::uint32_t length, std::u32string& out) const override{
+		out.clear();
+		document->copy_to(pos, length, out);
+	}
+};
+
 export enum struct text_edit_view_type : std::uint8_t {
 	fix,
 	fit,
@@ -61,19 +85,26 @@ private:
 
 protected:
 	text_editor_core core_{};
+	text_document document_{};
+	document_paragraph_source document_paragraphs_{document_};
+	//flattened copy of document_ for full layouts, synchronized lazily by prepare_layout_text_source
 	typesetting::tokenized_text tokenized_text_{};
 	typesetting::tokenized_text ime_display_tokenized_text_{};
 	std::u32string ime_display_text_{};
 	ime_composition_state ime_composition_{};
 	typesetting::layout_config layout_config_{};
 	typesetting::glyph_layout glyph_layout_{};
+	//scrollable mode only, relayouts the edited paragraphs and stitches them into glyph_layout_
+	typesetting::segmented_layout_manager segmented_layout_{};
 	text_render_cache render_cache_{};
 
 	layout::expand_policy expand_policy_{};
 	text_edit_change_type change_mark_{};
 	text_edit_view_type view_mode_{text_edit_view_type::fix};
 	bool is_idle_{true};
+	bool awaiting_glyphs_{};
 	bool apply_tokens_{false};
+	bool tokenized_text_expired_{true};
 
 	bool is_code_filter_whitelist_{false};
 	mr::heap_uset<char32_t> filter_code_points{mr::get_default_heap_allocator()};
@@ -170,10 +201,6 @@ protected:
 		return ime_composition_.active;
 	}
 
-	[[nodiscard]] inline std::u32string_view get_layout_text() const noexcept{
-		return has_active_ime_composition() ? std::u32string_view{ime_display_text_} : tokenized_text_.get_text();
-	}
-
 	[[nodiscard]] caret_section get_effective_caret() const noexcept{
 		if(!has_active_ime_composition()){
 			return core_.get_caret();
@@ -212,9 +239,12 @@ public:
 		}
 	}
 
-	[[nodiscard]] std::u32string_view get_text() const noexcept{
+	/**
+	 * @brief Contiguous copy of the text, flattened from the document on the first call after an edit.
+	 */
+	[[nodiscard]] std::u32string_view get_text() const{
 		if(is_idle_) return {};
-		return tokenized_text_.get_text();
+		return document_.view();
 	}
 
 	[[nodiscard]] bool is_idle() const noexcept{ return is_idle_; }
@@ -252,6 +282,7 @@ public:
 
 	void set_apply_tokens(const bool allow){
 		if(util::try_modify(apply_tokens_, allow)){
+			tokenized_text_expired_ = true;
 			change_mark_ |= text_edit_change_type::text;
 			notify_isolated_layout_changed();
 		}
@@ -280,18 +311,26 @@ public:
 #pragma endregion
 
 #pragma region EditActions
-	template <std::predicate<std::u32string&> Action>
+	template <std::predicate<text_document&> Action>
 	void apply_edit(Action&& action){
 		if(has_active_ime_composition()){
 			return;
 		}
 
-		bool actually_changed = tokenized_text_.modify(apply_tokens_ ? typesetting::tokenize_tag::kep : typesetting::tokenize_tag::raw,
-			[&](std::u32string& text) -> bool{
-				return std::invoke(std::forward<Action>(action), text);
-			});
+		const bool actually_changed = std::invoke(std::forward<Action>(action), document_);
+		const auto edit_range = core_.take_last_edit();
 
 		if(actually_changed){
+			tokenized_text_expired_ = true;
+			if(edit_range && !apply_tokens_){
+				segmented_layout_.apply_edit(
+					static_cast<std::uint32_t>(edit_range->position),
+					static_cast<std::uint32_t>(edit_range->removed),
+					static_cast<std::uint32_t>(edit_range->inserted));
+			}else{
+				segmented_layout_.reset();
+			}
+
 			if(is_idle()){
 				is_idle_ = false;
 			}
@@ -309,19 +348,19 @@ public:
 		}
 	}
 
-	void undo(){ apply_edit([&](std::u32string& text){ return core_.undo(text); }); }
-	void redo(){ apply_edit([&](std::u32string& text){ return core_.redo(text); }); }
+	void undo(){ apply_edit([&](text_document& text){ return core_.undo(text); }); }
+	void redo(){ apply_edit([&](text_document& text){ return core_.redo(text); }); }
 
 	void action_do_insert(std::u32string_view str){
-		apply_edit([&](std::u32string& text){ return core_.insert_text(text, str); });
+		apply_edit([&](text_document& text){ return core_.insert_text(text, str); });
 	}
 
-	void action_do_delete(){ apply_edit([&](std::u32string& text){ return core_.action_delete(text); }); }
-	void action_do_backspace(){ apply_edit([&](std::u32string& text){ return core_.action_backspace(text); }); }
+	void action_do_delete(){ apply_edit([&](text_document& text){ return core_.action_delete(text); }); }
+	void action_do_backspace(){ apply_edit([&](text_document& text){ return core_.action_backspace(text); }); }
 
 	virtual void action_enter(){
 		if(is_character_allowed(U'\n')){
-			apply_edit([&](std::u32string& text){ return core_.insert_text(text, U"\n"); });
+			apply_edit([&](text_document& text){ return core_.insert_text(text, U"\n"); });
 		} else{
 			set_input_invalid();
 		}
@@ -329,7 +368,7 @@ public:
 
 	void action_tab(){
 		if(is_character_allowed(U'\t')){
-			apply_edit([&](std::u32string& text){ return core_.insert_text(text, U"\t"); });
+			apply_edit([&](text_document& text){ return core_.insert_text(text, U"\t"); });
 		} else{
 			set_input_invalid();
 		}
@@ -337,45 +376,45 @@ public:
 
 	void action_move_left(bool select, bool jump){
 		if(has_active_ime_composition()) return;
-		if(jump) core_.action_jump_left(glyph_layout_, tokenized_text_.get_text(), select);
-		else core_.action_move_left(tokenized_text_.get_text(), select);
+		if(jump) core_.action_jump_left(glyph_layout_, document_, select);
+		else core_.action_move_left(document_, select);
 		reset_blink();
 	}
 
 	void action_move_right(bool select, bool jump){
 		if(has_active_ime_composition()) return;
-		if(jump) core_.action_jump_right(glyph_layout_, tokenized_text_.get_text(), select);
-		else core_.action_move_right(tokenized_text_.get_text(), select);
+		if(jump) core_.action_jump_right(glyph_layout_, document_, select);
+		else core_.action_move_right(document_, select);
 		reset_blink();
 	}
 
 	void action_move_up(bool select){
 		if(has_active_ime_composition()) return;
-		core_.action_move_up(glyph_layout_, tokenized_text_.get_text(), render_cache_.get_line_align(), select);
+		core_.action_move_up(glyph_layout_, document_, render_cache_.get_line_align(), select);
 		reset_blink();
 	}
 
 	void action_move_down(bool select){
 		if(has_active_ime_composition()) return;
-		core_.action_move_down(glyph_layout_, tokenized_text_.get_text(), render_cache_.get_line_align(), select);
+		core_.action_move_down(glyph_layout_, document_, render_cache_.get_line_align(), select);
 		reset_blink();
 	}
 
 	void action_move_line_begin(bool select){
 		if(has_active_ime_composition()) return;
-		core_.action_move_line_begin(glyph_layout_, tokenized_text_.get_text(), select);
+		core_.action_move_line_begin(glyph_layout_, document_, select);
 		reset_blink();
 	}
 
 	void action_move_line_end(bool select){
 		if(has_active_ime_composition()) return;
-		core_.action_move_line_end(glyph_layout_, tokenized_text_.get_text(), select);
+		core_.action_move_line_end(glyph_layout_, document_, select);
 		reset_blink();
 	}
 
 	void action_select_all(){
 		if(has_active_ime_composition()) return;
-		core_.action_select_all(tokenized_text_.get_text());
+		core_.action_select_all(document_);
 		reset_blink();
 	}
 
@@ -411,12 +450,12 @@ public:
 		if(maximum_code_points_ == max_code_points) return;
 		maximum_code_points_ = max_code_points;
 
-		if(!is_idle_ && tokenized_text_.get_text().size() > maximum_code_points_){
-			apply_edit([this](std::u32string& text){
-				text.resize(maximum_code_points_);
+		if(!is_idle_ && document_.size() > maximum_code_points_){
+			apply_edit([this](text_document& text){
+				(void)text.erase(maximum_code_points_, text.size() - maximum_code_points_);
 				return true;
 			});
-			core_.action_move_line_end(glyph_layout_, tokenized_text_.get_text(), false);
+			core_.action_move_line_end(glyph_layout_, document_, false);
 		}
 	}
 
@@ -439,6 +478,11 @@ protected:
 	std::optional<math::vec2> pre_acquire_size_impl(layout::optional_mastering_extent extent) override;
 	text_layout_result layout_text(math::vec2 bound);
 
+	/**
+	 * @brief Listen on the update channel while the layout still misses glyph textures, so the text relayouts once they land.
+	 */
+	void sync_glyph_await_();
+
 	[[nodiscard]] math::vec2 get_glyph_draw_extent() const noexcept{
 		math::vec2 abs_scale = math::vec2{std::abs(scale_.x), std::abs(scale_.y)} * get_scaling();
 		math::vec2 base_ext = glyph_layout_.extent * abs_scale;
@@ -519,7 +563,7 @@ public:
 			auto t_params = get_transform_params();
 			math::vec2 raw_hit_pos = t_params.inverse_local(event.local_pos);
 
-			if(core_.action_hit_test(glyph_layout_, tokenized_text_.get_text(), raw_hit_pos,
+			if(core_.action_hit_test(glyph_layout_, document_, raw_hit_pos,
 				render_cache_.get_line_align(), false)){
 				reset_blink();
 				if(!is_layout_expired_()){
@@ -593,7 +637,7 @@ struct text_edit_key_binding : input_handle::key_mapping<text_edit&>{
 export struct text_edit_prov : text_edit{
 private:
 	struct trans{
-		static std::u32string_view operator()(const text_edit_prov* src) noexcept{
+		static std::u32string_view operator()(const text_edit_prov* src){
 			assert(src != nullptr);
 			return src->get_text();
 		}
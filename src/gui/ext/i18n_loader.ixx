@@ -66,11 +66,7 @@ export inline i18n_load_result apply_i18n_bundle_to_resources(
 	}
 
 	auto& root = resources.i18n_prov.node;
-	root.update_value(i18n::text_snapshot{
-		.tree = std::move(bundle.tree),
-		.revision = root.get_raw_cache().revision + 1,
-		.locale = std::string{std::string_view{result.locale}},
-	});
+	(void)root.switch_tree(std::move(bundle.tree), std::string_view{result.locale});
 	result.applied = true;
 	return result;
 }
@@ -72,7 +72,7 @@ void direct_label::draw_text(float opacityScl) const {
 	color_guard g_{renderer(), get_draw_scl_color(opacityScl)};
 	state_guard guard{renderer(), fx::batch_draw_mode::msdf};
 	transform_guard _t{renderer(), mat_abs};
-	renderer() << render_cache_;
+	render_cache_.push_visible_to_renderer(renderer());
 }
 
 }
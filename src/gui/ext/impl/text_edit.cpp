@@ -42,7 +42,7 @@ void text_edit::apply_committed_text(std::u32string rst){
 
 	auto caret = core_.get_caret();
 	std::size_t sel_len = caret.has_region() ? caret.get_ordered().length() : 0;
-	std::size_t current_len = tokenized_text_.get_text().size();
+	std::size_t current_len = document_.size();
 
 	if(current_len - sel_len + rst.size() > maximum_code_points_){
 		std::size_t allowed_len = maximum_code_points_ - (current_len - sel_len);
@@ -59,10 +59,16 @@ void text_edit::apply_committed_text(std::u32string rst){
 
 typesetting::tokenized_text& text_edit::prepare_layout_text_source(){
 	if(!has_active_ime_composition()){
+		if(tokenized_text_expired_){
+			tokenized_text_.reset(document_.substr(0),
+				apply_tokens_ ? typesetting::tokenize_tag::kep : typesetting::tokenize_tag::raw);
+			tokenized_text_expired_ = false;
+		}
 		return tokenized_text_;
 	}
 
-	ime_display_text_ = tokenized_text_.get_text();
+	ime_display_text_.clear();
+	document_.copy_to(0, document_.size(), ime_display_text_);
 	const auto replacement = ime_composition_.replacement.get_ordered();
 	const auto replace_src = std::min<std::size_t>(replacement.src, ime_display_text_.size());
 	const auto replace_dst = std::min<std::size_t>(replacement.dst, ime_display_text_.size());
@@ -99,7 +105,7 @@ void text_edit::cancel_ime_composition_preview(){
 	ime_composition_ = {};
 	ime_display_text_.clear();
 	ime_display_tokenized_text_.reset(
-		tokenized_text_.get_text(),
+		std::u32string_view{},
 		apply_tokens_ ? typesetting::tokenize_tag::kep : typesetting::tokenize_tag::raw);
 	mark_ime_composition_layout_changed();
 }
@@ -120,7 +126,7 @@ void text_edit::action_copy() const{
 	auto ordered = caret.get_ordered();
 
 	if(const auto cmt = get_scene().get_communicator()){
-		auto sel_u32 = tokenized_text_.get_text().substr(ordered.src, ordered.length());
+		auto sel_u32 = document_.substr(ordered.src, ordered.length());
 		cmt->set_clipboard(unicode::utf32_to_utf8(sel_u32));
 	}
 }
@@ -161,7 +167,10 @@ void text_edit::update_caret_cache(){
 
 	bool has_sel = !has_active_ime_composition() && caret.has_region();
 	auto ordered = caret.get_ordered();
-	auto text_u32 = get_layout_text();
+	const auto text_size = has_active_ime_composition() ? ime_display_text_.size() : document_.size();
+	const auto char_at = [&](const std::size_t pos){
+		return has_active_ime_composition() ? ime_display_text_[pos] : document_[pos];
+	};
 
 	bool caret_found = false;
 	math::vec2 final_caret_pos{};
@@ -195,9 +204,9 @@ void text_edit::update_caret_cache(){
 		std::size_t line_end_idx = line_start_idx;
 
 		if(line.cluster_range.size > 0){
-			line_start_idx = glyph_layout_.clusters[line.cluster_range.pos].cluster_index;
+			line_start_idx = line.text_offset + glyph_layout_.clusters[line.cluster_range.pos].cluster_index;
 			const auto& last_cluster = glyph_layout_.clusters[line.cluster_range.pos + line.cluster_range.size - 1];
-			line_end_idx = last_cluster.cluster_index + last_cluster.cluster_span;
+			line_end_idx = line.text_offset + last_cluster.cluster_index + last_cluster.cluster_span;
 		}
 		next_line_start_idx = line_end_idx;
 
@@ -217,13 +226,14 @@ void text_edit::update_caret_cache(){
 			} else{
 				for(std::size_t i = 0; i < line.cluster_range.size; ++i){
 					const auto& cluster = glyph_layout_.clusters[line.cluster_range.pos + i];
-					if(cluster.cluster_index >= ordered.src && cluster.cluster_index < ordered.dst){
+					const std::size_t cluster_index = line.text_offset + cluster.cluster_index;
+					if(cluster_index >= ordered.src && cluster_index < ordered.dst){
 						line_has_sel = true;
 						sel_min_x = std::min(sel_min_x, cluster.logical_rect.vert_00().x);
 						sel_max_x = std::max(sel_max_x, cluster.logical_rect.vert_11().x);
 
-						if(cluster.cluster_index < text_u32.size() && (text_u32[cluster.cluster_index] == U'\n' ||
-							text_u32[cluster.cluster_index] == U'\r')){
+						if(cluster_index < text_size && (char_at(cluster_index) == U'\n' ||
+							char_at(cluster_index) == U'\r')){
 							extend_to_edge = true;
 						}
 					}
@@ -263,13 +273,14 @@ void text_edit::update_caret_cache(){
 		if(!caret_found){
 			for(std::size_t i = 0; i < line.cluster_range.size; ++i){
 				const auto& cluster = glyph_layout_.clusters[line.cluster_range.pos + i];
+				const std::size_t cluster_index = line.text_offset + cluster.cluster_index;
 
-				if(caret.dst >= cluster.cluster_index && caret.dst < cluster.cluster_index + cluster.cluster_span){
+				if(caret.dst >= cluster_index && caret.dst < cluster_index + cluster.cluster_span){
 					final_caret_ext = {2.0f, line_height};
 
 					float span_ratio = 0.0f;
 					if(cluster.cluster_span > 1){
-						span_ratio = static_cast<float>(caret.dst - cluster.cluster_index) / static_cast<float>(cluster.
+						span_ratio = static_cast<float>(caret.dst - cluster_index) / static_cast<float>(cluster.
 							cluster_span);
 					}
 
@@ -285,8 +296,7 @@ void text_edit::update_caret_cache(){
 
 			if(!caret_found && caret.dst == line_end_idx){
 				bool is_last_line = (line_idx == glyph_layout_.lines.size() - 1);
-				bool ends_with_newline = (caret.dst > 0 && caret.dst <= text_u32.size() && text_u32[caret.dst - 1] ==
-					U'\n');
+				bool ends_with_newline = (caret.dst > 0 && caret.dst <= text_size && char_at(caret.dst - 1) == U'\n');
 
 				if(line.cluster_range.size == 0){
 					final_caret_ext = {2.0f, line_height};
@@ -433,9 +443,31 @@ text_layout_result text_edit::layout_text(math::vec2 bound){
 
 		if(is_layout_expired_()){
 			layout_config_.set_max_extent(mo_yanxi::math::vectors::constant2<float>::inf_positive_vec2);
-			get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
-			render_cache_.update_buffer(glyph_layout_);
+
+			//only text edits can be applied per paragraph, anything else invalidates every paragraph
+			if((change_mark_ & ~text_edit_change_type::text) != text_edit_change_type::none){
+				segmented_layout_.reset();
+			}
+
+			if(!has_active_ime_composition() && !apply_tokens_ && !document_.empty()){
+				//paragraphs are copied out of the document on demand, the flattened text is only built for the fallback
+				segmented_layout_.bind(document_paragraphs_, glyph_layout_);
+				if(!segmented_layout_.update_layouts(*get_layout(), layout_config_)){
+					get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
+				}
+			}else{
+				segmented_layout_.reset();
+				get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
+			}
+
+			//only the paragraphs laid out again are recorded, the other lines are moved
+			if(const auto changes = segmented_layout_.is_bound() ? segmented_layout_.get_line_changes() : std::nullopt){
+				render_cache_.update_buffer(glyph_layout_, *changes);
+			}else{
+				render_cache_.update_buffer(glyph_layout_);
+			}
 			change_mark_ = text_edit_change_type::none;
+			sync_glyph_await_();
 
 			update_caret_cache();
 			scroll_to_caret();
@@ -456,9 +488,11 @@ text_layout_result text_edit::layout_text(math::vec2 bound){
 			if(layout_config_.set_max_extent(mo_yanxi::math::vectors::constant2<float>::inf_positive_vec2) ||
 				((change_mark_ & text_edit_change_type::config) != text_edit_change_type::none) || ((change_mark_ &
 					text_edit_change_type::text) != text_edit_change_type::none)){
+				segmented_layout_.reset();
 				get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
 				render_cache_.update_buffer(glyph_layout_);
 				change_mark_ = text_edit_change_type::none;
+				sync_glyph_await_();
 
 				update_caret_cache();
 				update_ime_position();
@@ -471,19 +505,19 @@ text_layout_result text_edit::layout_text(math::vec2 bound){
 	} else if(layout_config_.set_max_extent(local_bound) || is_layout_expired_()){
 
 		bool is_text_changed = (change_mark_ & text_edit_change_type::text) != text_edit_change_type::none;
+		segmented_layout_.reset();
 		get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
 		if(!glyph_layout_.is_exhausted && is_text_changed){
-			tokenized_text_.modify(apply_tokens_ ? typesetting::tokenize_tag::kep : typesetting::tokenize_tag::raw,
-			                       [&](std::u32string& text) -> bool{
-				                       core_.undo(text);
-				                       core_.clear_redo();
-				                       return true;
-			                       });
+			core_.undo(document_);
+			core_.clear_redo();
+			(void)core_.take_last_edit();
+			tokenized_text_expired_ = true;
 			set_input_invalid();
 			get_layout()->layout(prepare_layout_text_source(), layout_config_, glyph_layout_);
 		}
 		render_cache_.update_buffer(glyph_layout_);
 		change_mark_ = text_edit_change_type::none;
+		sync_glyph_await_();
 		update_caret_cache();
 		update_ime_position();
 
@@ -533,7 +567,7 @@ void text_edit::record_draw_layer(draw_recorder& call_stack_builder) const{
 			transform_guard _t{r, mat};
 			color_guard g_{r, e.get_draw_scl_color(opacityScl)};
 
-			r << e.render_cache_;
+			e.render_cache_.push_visible_to_renderer(r);
 		}
 
 		if (e.is_scrollable_mode()) {
@@ -554,9 +588,31 @@ void text_edit::layout_elem(){
 	}
 }
 
+void text_edit::sync_glyph_await_(){
+	const bool pending = glyph_layout_.has_pending_glyphs();
+	if(pending == awaiting_glyphs_) return;
+	awaiting_glyphs_ = pending;
+	if(pending){
+		util::update_insert(*this, update_channel::custom);
+	} else{
+		util::update_erase(*this, update_channel::custom);
+	}
+}
+
 bool text_edit::update(float delta_in_ticks){
 	if(!elem::update(delta_in_ticks)) return false;
 
+	if(awaiting_glyphs_ && glyph_layout_.is_pending_glyphs_landed()){
+		if(segmented_layout_.is_bound()){
+			//scrollable mode, where the text flag only relayouts the paragraphs waiting for the glyphs
+			segmented_layout_.invalidate_landed_glyphs();
+			change_mark_ |= text_edit_change_type::text;
+		}else{
+			change_mark_ |= text_edit_change_type::config;
+		}
+		notify_isolated_layout_changed();
+	}
+
 	bool ime_position_dirty = false;
 
 	if(is_scrollable_mode()) {
@@ -601,7 +657,7 @@ bool text_edit::update(float delta_in_ticks){
 				math::vec2 new_raw_hit_pos = new_t_params.inverse_local(last_drag_dst_);
 
 
-				core_.action_hit_test(glyph_layout_, tokenized_text_.get_text(), new_raw_hit_pos, render_cache_.get_line_align(), true);
+				core_.action_hit_test(glyph_layout_, document_, new_raw_hit_pos, render_cache_.get_line_align(), true);
 
 
 				if(!is_layout_expired_()){
@@ -625,7 +681,7 @@ bool text_edit::update(float delta_in_ticks){
 	}
 
 	if(!is_focused_key() && core_.get_caret().has_region()){
-		core_.action_move_left(tokenized_text_.get_text(), false);
+		core_.action_move_left(document_, false);
 	}
 
 	if(is_focused_key()){
@@ -672,7 +728,7 @@ void text_edit::on_pointer_drag(events::event_context& ctx, const events::pointe
 	auto t_params = get_transform_params();
 	math::vec2 raw_hit_pos = t_params.inverse_local(event.local_dst);
 
-	core_.action_hit_test(glyph_layout_, tokenized_text_.get_text(), raw_hit_pos, render_cache_.get_line_align(), true);
+	core_.action_hit_test(glyph_layout_, document_, raw_hit_pos, render_cache_.get_line_align(), true);
 	reset_blink();
 
 	if(!is_layout_expired_()){
@@ -707,7 +763,7 @@ void text_edit::on_text(events::event_context& ctx, const events::text_event& ev
 		auto caret = core_.get_caret();
 		std::size_t sel_len = caret.has_region() ? caret.get_ordered().length() : 0;
 
-		if(tokenized_text_.get_text().size() - sel_len + 1 > maximum_code_points_){
+		if(document_.size() - sel_len + 1 > maximum_code_points_){
 			set_input_invalid();
 		} else{
 			const std::u32string_view buf{&event.value, 1};
@@ -886,8 +942,10 @@ void text_edit::set_focus(bool keyFocused){
 			on_changed();
 		}
 		util::update_erase(*this, update_channel::all);
+		//keep waiting for glyphs still being generated
+		if(awaiting_glyphs_) util::update_insert(*this, update_channel::custom);
 
-		if(tokenized_text_.get_text().empty()){
+		if(document_.empty()){
 			is_idle_ = true;
 			set_text_internal(hint_text_when_idle_);
 		}
@@ -911,7 +969,9 @@ void text_edit::set_focus(bool keyFocused){
 }
 
 void text_edit::set_text_internal(std::u32string_view str){
-	tokenized_text_.reset(str, apply_tokens_ ? typesetting::tokenize_tag::kep : typesetting::tokenize_tag::raw);
+	segmented_layout_.reset();
+	document_.assign(str);
+	tokenized_text_expired_ = true;
 	change_mark_ |= text_edit_change_type::text;
 	notify_isolated_layout_changed();
 }
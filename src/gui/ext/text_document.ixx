@@ -0,0 +1,341 @@
+module;
+
+#include <cassert>
+
+export module mo_yanxi.gui.text_document;
+
+import std;
+
+namespace mo_yanxi::gui{
+
+/**
+ * @brief Block of text referenced by the pieces of a text_document, written once and never modified afterwards.
+ */
+export struct text_chunk{
+	std::unique_ptr<char32_t[]> chars{};
+	/**
+	 * @brief Ascending offsets of every line feed written into the chunk.
+	 */
+	std::vector<std::uint32_t> line_feeds{};
+};
+
+/**
+ * @brief A range of a text_chunk, used as piece of a text_document and as the text of an undo record.
+ */
+export struct edit_text_span{
+	std::shared_ptr<const text_chunk> chunk{};
+	std::uint32_t offset{};
+	std::uint32_t length{};
+
+	[[nodiscard]] std::u32string_view view() const noexcept{
+		if(!chunk) return {};
+		return {chunk->chars.get() + offset, length};
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return length;
+	}
+
+	[[nodiscard]] std::size_t line_feed_count() const noexcept{
+		if(!chunk) return 0;
+		return first_line_feed_(offset + length) - first_line_feed_(offset);
+	}
+
+	/**
+	 * @return offset inside the span of its `nth` line feed
+	 */
+	[[nodiscard]] std::uint32_t line_feed_at(const std::size_t nth) const noexcept{
+		return chunk->line_feeds[first_line_feed_(offset) + nth] - offset;
+	}
+
+private:
+	[[nodiscard]] std::size_t first_line_feed_(const std::uint32_t at) const noexcept{
+		return std::ranges::lower_bound(chunk->line_feeds, at) - chunk->line_feeds.begin();
+	}
+};
+
+/**
+ * @brief Append-only buffer holding every text inserted into a text_document.
+ *
+ * Small insertions are packed into shared fixed-size chunks so consecutive typing stays contiguous, a large paste
+ * gets a dedicated chunk. A chunk is released once no piece and no undo record references it.
+ */
+export class edit_text_arena{
+private:
+	static constexpr std::size_t chunk_capacity = 16384;
+
+	std::shared_ptr<text_chunk> current_{};
+	std::size_t used_{chunk_capacity};
+
+	static void write_(text_chunk& chunk, const std::size_t at, const std::u32string_view text){
+		std::ranges::copy(text, chunk.chars.get() + at);
+		for(std::size_t i = 0; i < text.size(); ++i){
+			if(text[i] == U'\n') chunk.line_feeds.push_back(static_cast<std::uint32_t>(at + i));
+		}
+	}
+
+public:
+	[[nodiscard]] edit_text_span store(const std::u32string_view text){
+		if(text.empty()) return {};
+
+		if(text.size() > chunk_capacity / 4){
+			auto dedicated = std::make_shared<text_chunk>();
+			dedicated->chars = std::make_unique_for_overwrite<char32_t[]>(text.size());
+			write_(*dedicated, 0, text);
+			return {std::move(dedicated), 0, static_cast<std::uint32_t>(text.size())};
+		}
+
+		if(used_ + text.size() > chunk_capacity){
+			current_ = std::make_shared<text_chunk>();
+			current_->chars = std::make_unique_for_overwrite<char32_t[]>(chunk_capacity);
+			used_ = 0;
+		}
+
+		write_(*current_, used_, text);
+		edit_text_span span{current_, static_cast<std::uint32_t>(used_), static_cast<std::uint32_t>(text.size())};
+		used_ += text.size();
+		return span;
+	}
+};
+
+/**
+ * @brief Piece table text storage.
+ *
+ * The document is a sequence of spans into immutable chunks: the assigned text is one chunk, everything inserted
+ * afterwards goes to the append-only arena. An edit only splits and moves pieces, so its cost depends on the number
+ * of pieces rather than on the length of the text, and removed pieces can be handed to the undo history without
+ * copying their text.
+ *
+ * Line feeds are indexed per chunk, so mapping between positions and lines is a binary search as well.
+ */
+export class text_document{
+private:
+	std::vector<edit_text_span> pieces_{};
+	/**
+	 * @brief Document position past each piece.
+	 */
+	std::vector<std::size_t> piece_ends_{};
+	/**
+	 * @brief Line feeds contained in each piece and the ones before it.
+	 */
+	std::vector<std::size_t> line_feed_ends_{};
+	edit_text_arena arena_{};
+
+	mutable std::u32string flattened_{};
+	mutable bool flattened_expired_{false};
+
+public:
+	[[nodiscard]] text_document() = default;
+
+	[[nodiscard]] explicit text_document(const std::u32string_view text){
+		assign(text);
+	}
+
+	void assign(const std::u32string_view text){
+		pieces_.clear();
+		arena_ = {};
+		flattened_.clear();
+		flattened_expired_ = true;
+
+		if(!text.empty()){
+			auto chunk = std::make_shared<text_chunk>();
+			chunk->chars = std::make_unique_for_overwrite<char32_t[]>(text.size());
+			std::ranges::copy(text, chunk->chars.get());
+			for(std::size_t i = 0; i < text.size(); ++i){
+				if(text[i] == U'\n') chunk->line_feeds.push_back(static_cast<std::uint32_t>(i));
+			}
+			pieces_.push_back({std::move(chunk), 0, static_cast<std::uint32_t>(text.size())});
+		}
+		update_prefix_(0);
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return piece_ends_.empty() ? 0 : piece_ends_.back();
+	}
+
+	[[nodiscard]] bool empty() const noexcept{
+		return size() == 0;
+	}
+
+	[[nodiscard]] std::size_t piece_count() const noexcept{
+		return pieces_.size();
+	}
+
+	[[nodiscard]] std::size_t line_count() const noexcept{
+		return (line_feed_ends_.empty() ? 0 : line_feed_ends_.back()) + 1;
+	}
+
+	[[nodiscard]] char32_t operator[](const std::size_t pos) const noexcept{
+		assert(pos < size());
+		const auto idx = find_piece_(pos);
+		const auto& piece = pieces_[idx];
+		return piece.chunk->chars[piece.offset + (pos - piece_begin_(idx))];
+	}
+
+	/**
+	 * @return index of the line containing `pos`, i.e. the number of line feeds before it
+	 */
+	[[nodiscard]] std::size_t line_of(const std::size_t pos) const noexcept{
+		const auto idx = find_piece_(pos);
+		if(idx == pieces_.size()) return line_count() - 1;
+
+		const auto& piece = pieces_[idx];
+		const edit_text_span before{piece.chunk, piece.offset, static_cast<std::uint32_t>(pos - piece_begin_(idx))};
+		return line_feeds_before_(idx) + before.line_feed_count();
+	}
+
+	/**
+	 * @return position of the first character of `line`, size() if the document has fewer lines
+	 */
+	[[nodiscard]] std::size_t line_begin(const std::size_t line) const noexcept{
+		if(line == 0) return 0;
+		if(line >= line_count()) return size();
+
+		const auto idx = static_cast<std::size_t>(std::ranges::lower_bound(line_feed_ends_, line) - line_feed_ends_.begin());
+		const auto nth = line - line_feeds_before_(idx) - 1;
+		return piece_begin_(idx) + pieces_[idx].line_feed_at(nth) + 1;
+	}
+
+	/**
+	 * @return position past the line feed ending `line`, size() for the last line
+	 */
+	[[nodiscard]] std::size_t line_end(const std::size_t line) const noexcept{
+		return line_begin(line + 1);
+	}
+
+	/**
+	 * @brief Appends [pos, pos + length) to `out`.
+	 */
+	void copy_to(std::size_t pos, std::size_t length, std::u32string& out) const{
+		length = std::min(length, size() - std::min(pos, size()));
+		if(length == 0) return;
+		out.reserve(out.size() + length);
+
+		for(auto idx = find_piece_(pos); length > 0; ++idx){
+			const auto text = pieces_[idx].view().substr(pos - piece_begin_(idx), length);
+			out.append(text);
+			pos += text.size();
+			length -= text.size();
+		}
+	}
+
+	[[nodiscard]] std::u32string substr(const std::size_t pos, const std::size_t length = std::u32string::npos) const{
+		std::u32string rst;
+		copy_to(pos, length, rst);
+		return rst;
+	}
+
+	/**
+	 * @brief Contiguous copy of the whole text, cached until the next edit.
+	 */
+	[[nodiscard]] std::u32string_view view() const{
+		if(flattened_expired_){
+			flattened_.clear();
+			copy_to(0, size(), flattened_);
+			flattened_expired_ = false;
+		}
+		return flattened_;
+	}
+
+	/**
+	 * @brief Store `text` in the arena and insert it at `pos`.
+	 * @return the stored text, can be inserted again without copying
+	 */
+	edit_text_span insert(const std::size_t pos, const std::u32string_view text){
+		auto span = arena_.store(text);
+		insert(pos, {&span, 1});
+		return span;
+	}
+
+	void insert(const std::size_t pos, const std::span<const edit_text_span> spans){
+		assert(pos <= size());
+		auto idx = split_(pos);
+		const auto first = idx;
+
+		for(const auto& span : spans){
+			if(span.length == 0) continue;
+			//consecutive typing is contiguous in the arena, extend the previous piece instead of adding one
+			if(idx > 0){
+				auto& prev = pieces_[idx - 1];
+				if(prev.chunk == span.chunk && prev.offset + prev.length == span.offset){
+					prev.length += span.length;
+					continue;
+				}
+			}
+			pieces_.insert(pieces_.begin() + idx, span);
+			++idx;
+		}
+
+		invalidate_(first > 0 ? first - 1 : 0);
+	}
+
+	/**
+	 * @return the removed pieces, they still reference the text so they can be inserted again
+	 */
+	std::vector<edit_text_span> erase(const std::size_t pos, std::size_t length){
+		length = std::min(length, size() - std::min(pos, size()));
+		if(length == 0) return {};
+
+		const auto first = split_(pos);
+		const auto last = split_(pos + length);
+
+		std::vector<edit_text_span> removed{
+				std::make_move_iterator(pieces_.begin() + first), std::make_move_iterator(pieces_.begin() + last)
+			};
+		pieces_.erase(pieces_.begin() + first, pieces_.begin() + last);
+		invalidate_(first);
+		return removed;
+	}
+
+private:
+	[[nodiscard]] std::size_t piece_begin_(const std::size_t idx) const noexcept{
+		return idx == 0 ? 0 : piece_ends_[idx - 1];
+	}
+
+	[[nodiscard]] std::size_t line_feeds_before_(const std::size_t idx) const noexcept{
+		return idx == 0 ? 0 : line_feed_ends_[idx - 1];
+	}
+
+	/**
+	 * @return index of the piece containing `pos`, the piece count if `pos` is the end of the document
+	 */
+	[[nodiscard]] std::size_t find_piece_(const std::size_t pos) const noexcept{
+		return std::ranges::upper_bound(piece_ends_, pos) - piece_ends_.begin();
+	}
+
+	/**
+	 * @brief Make `pos` a piece boundary.
+	 * @return index of the piece starting at `pos`
+	 */
+	std::size_t split_(const std::size_t pos){
+		const auto idx = find_piece_(pos);
+		if(idx == pieces_.size()) return idx;
+
+		const auto begin = piece_begin_(idx);
+		if(begin == pos) return idx;
+
+		auto& piece = pieces_[idx];
+		const auto head = static_cast<std::uint32_t>(pos - begin);
+		edit_text_span tail{piece.chunk, piece.offset + head, piece.length - head};
+		piece.length = head;
+		pieces_.insert(pieces_.begin() + idx + 1, std::move(tail));
+		update_prefix_(idx);
+		return idx + 1;
+	}
+
+	void update_prefix_(const std::size_t from){
+		piece_ends_.resize(pieces_.size());
+		line_feed_ends_.resize(pieces_.size());
+		for(auto idx = from; idx < pieces_.size(); ++idx){
+			piece_ends_[idx] = piece_begin_(idx) + pieces_[idx].length;
+			line_feed_ends_[idx] = line_feeds_before_(idx) + pieces_[idx].line_feed_count();
+		}
+	}
+
+	void invalidate_(const std::size_t from){
+		update_prefix_(from);
+		flattened_expired_ = true;
+	}
+};
+
+}
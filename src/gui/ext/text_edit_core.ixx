@@ -5,6 +5,7 @@ module;
 export module mo_yanxi.gui.text_edit_core;
 
 import std;
+export import mo_yanxi.gui.text_document;
 import mo_yanxi.typesetting;
 import mo_yanxi.history_stack;
 import mo_yanxi.math.vector2;
@@ -39,87 +40,110 @@ enum class text_edit_type{
 	insert, del, replace
 };
 
+/**
+ * @brief Text range changed by the last edit, in positions of the text before the edit.
+ */
+export struct text_edit_range{
+	std::size_t position;
+	std::size_t removed;
+	std::size_t inserted;
+};
+
 struct text_edit_delta{
 	text_edit_type type{};
 	caret_section caret_state{};
 	std::size_t position{};
-	std::u32string text_before{};
-	std::u32string text_after{};
+	/**
+	 * @brief Pieces removed from the document, they keep referencing its chunks instead of copying the text.
+	 */
+	std::vector<edit_text_span> text_before{};
+	std::size_t length_before{};
+	edit_text_span text_after{};
 };
 
 class edit_history{
 private:
 	mo_yanxi::procedure_history_stack<text_edit_delta, std::deque<text_edit_delta>> history_{};
 
+	static std::size_t length_of(const std::span<const edit_text_span> spans) noexcept{
+		std::size_t length{};
+		for(const auto& span : spans) length += span.size();
+		return length;
+	}
+
 public:
 	edit_history() = default;
 
 	inline explicit edit_history(const std::size_t capacity) : history_(capacity){
 	}
 
-	inline void commit_insertion(const std::u32string_view content, const caret_section caret, const std::size_t where,
-		const std::u32string_view text){
+	inline void commit_insertion(const caret_section caret, const std::size_t where, edit_text_span inserted){
 		history_.push(text_edit_delta{
 				.type = text_edit_type::insert,
 				.caret_state = caret,
 				.position = where,
-				.text_after = std::u32string{text}
+				.text_after = std::move(inserted)
 			});
 	}
 
-	inline void commit_delete(const std::u32string_view content, const caret_section caret, const std::size_t where,
-		const std::size_t length){
+	inline void commit_delete(const caret_section caret, const std::size_t where, std::vector<edit_text_span> removed){
+		const auto length = length_of(removed);
 		history_.push(text_edit_delta{
 				.type = text_edit_type::del,
 				.caret_state = caret,
 				.position = where,
-				.text_before = std::u32string{content.substr(where, length)}
+				.text_before = std::move(removed),
+				.length_before = length
 			});
 	}
 
-	inline void commit_replace(const std::u32string_view content, const caret_section caret, const std::size_t where,
-		const std::size_t length, const std::u32string_view inserted){
+	inline void commit_replace(const caret_section caret, const std::size_t where, std::vector<edit_text_span> removed,
+		edit_text_span inserted){
+		const auto length = length_of(removed);
 		history_.push(text_edit_delta{
 				.type = text_edit_type::replace,
 				.caret_state = caret,
 				.position = where,
-				.text_before = std::u32string{content.substr(where, length)},
-				.text_after = std::u32string{inserted}
+				.text_before = std::move(removed),
+				.length_before = length,
+				.text_after = std::move(inserted)
 			});
 	}
 
-	inline bool undo(std::u32string& target, caret_section& caret){
+	inline std::optional<text_edit_range> undo(text_document& target, caret_section& caret){
 		if(auto* op = history_.to_prev()){
 			switch(op->type){
-			case text_edit_type::insert : target.erase(op->position, op->text_after.size());
+			case text_edit_type::insert : (void)target.erase(op->position, op->text_after.size());
 				break;
 			case text_edit_type::del : target.insert(op->position, op->text_before);
 				break;
-			case text_edit_type::replace : target.replace(op->position, op->text_after.size(), op->text_before);
+			case text_edit_type::replace : (void)target.erase(op->position, op->text_after.size());
+				target.insert(op->position, op->text_before);
 				break;
 			}
 			caret = op->caret_state;
-			return true;
+			return text_edit_range{op->position, op->text_after.size(), op->length_before};
 		}
-		return false;
+		return std::nullopt;
 	}
 
-	inline bool redo(std::u32string& target, caret_section& caret){
+	inline std::optional<text_edit_range> redo(text_document& target, caret_section& caret){
 		if(auto* op = history_.to_next()){
 			switch(op->type){
-			case text_edit_type::insert : target.insert(op->position, op->text_after);
+			case text_edit_type::insert : target.insert(op->position, {&op->text_after, 1});
 				caret = caret_section(op->caret_state.src + (unsigned)op->text_after.size(), op->caret_state.dst + (unsigned)op->text_after.size());
 				break;
-			case text_edit_type::del : target.erase(op->position, op->text_before.size());
+			case text_edit_type::del : (void)target.erase(op->position, op->length_before);
 				caret = op->caret_state;
 				break;
-			case text_edit_type::replace : target.replace(op->position, op->text_before.size(), op->text_after);
+			case text_edit_type::replace : (void)target.erase(op->position, op->length_before);
+				target.insert(op->position, {&op->text_after, 1});
 				caret = op->caret_state;
 				break;
 			}
-			return true;
+			return text_edit_range{op->position, op->length_before, op->text_after.size()};
 		}
-		return false;
+		return std::nullopt;
 	}
 
 	inline void clear_redo() noexcept {
@@ -133,6 +157,7 @@ private:
 	edit_history history_{64};
 
 	std::optional<float> preferred_cross_pos_{};
+	std::optional<text_edit_range> last_edit_{};
 
 	[[nodiscard]] static constexpr unsigned text_index(const std::size_t index) noexcept{
 		return (unsigned)index;
@@ -160,7 +185,7 @@ private:
 		unsigned visual_end;
 	};
 
-	[[nodiscard]] inline line_bounds get_line_bounds(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, unsigned line_idx) const {
+	[[nodiscard]] inline line_bounds get_line_bounds(const typesetting::glyph_layout& layout, const text_document& text_buffer_, unsigned line_idx) const {
         if (std::cmp_greater_equal(line_idx, layout.lines.size())) {
             return {0, 0, 0};
         }
@@ -168,10 +193,15 @@ private:
         const auto& line = layout.lines[line_idx];
 
         if (line.cluster_range.size == 0) {
+            // clusters of a stitched layout are not stored in line order, take the end of the last non-empty line before
+            unsigned prev_line = line_idx;
+            while (prev_line > 0 && layout.lines[prev_line - 1].cluster_range.size == 0) --prev_line;
+
             unsigned idx = 0;
-            if (line.cluster_range.pos > 0 && line.cluster_range.pos <= layout.clusters.size()) {
-                const auto& prev = layout.clusters[line.cluster_range.pos - 1];
-                idx = prev.cluster_index + prev.cluster_span;
+            if (prev_line > 0) {
+                const auto& l = layout.lines[prev_line - 1];
+                const auto& prev = layout.clusters[l.cluster_range.pos + l.cluster_range.size - 1];
+                idx = l.text_offset + prev.cluster_index + prev.cluster_span;
             } else if (!text_buffer_.empty()) {
                 idx = text_index(text_buffer_.size());
             }
@@ -181,8 +211,8 @@ private:
         const auto& first_c = layout.clusters[line.cluster_range.pos];
         const auto& last_c = layout.clusters[line.cluster_range.pos + line.cluster_range.size - 1];
 
-        unsigned start = first_c.cluster_index;
-        unsigned end = last_c.cluster_index + last_c.cluster_span;
+        unsigned start = line.text_offset + first_c.cluster_index;
+        unsigned end = line.text_offset + last_c.cluster_index + last_c.cluster_span;
         unsigned visual_end = end;
 
         if (visual_end > start && visual_end <= text_buffer_.size()) {
@@ -197,16 +227,24 @@ private:
         return {start, end, visual_end};
     }
 
-    [[nodiscard]] inline unsigned get_line_index(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, unsigned pos) const {
-        if (layout.lines.empty()) return 0;
+	/**
+	 * @brief Line containing `pos`, lines are ordered by their text range so this is a binary search.
+	 */
+	[[nodiscard]] inline unsigned get_line_index(const typesetting::glyph_layout& layout, const text_document& text_buffer_, unsigned pos) const {
+		if (layout.lines.empty()) return 0;
 
-        for (unsigned i = 0; std::cmp_less(i, layout.lines.size()); ++i) {
-            auto b = get_line_bounds(layout, text_buffer_, i);
-            if (pos >= b.start_idx && pos < b.end_idx) return i;
-            if (i == text_index(layout.lines.size() - 1) && pos == b.end_idx) return i;
-        }
-        return layout.lines.size() > 0 ? text_index(layout.lines.size() - 1) : 0;
-    }
+		const auto last_line = text_index(layout.lines.size() - 1);
+		const auto line_indices = std::views::iota(0u, text_index(layout.lines.size()));
+		const auto itr = std::ranges::partition_point(line_indices, [&](unsigned i){
+			return get_line_bounds(layout, text_buffer_, i).start_idx <= pos;
+		});
+
+		const unsigned candidate = itr == line_indices.begin() ? 0u : *std::ranges::prev(itr);
+		const auto b = get_line_bounds(layout, text_buffer_, candidate);
+		if (pos >= b.start_idx && pos < b.end_idx) return candidate;
+		if (candidate == last_line && pos == b.end_idx) return candidate;
+		return last_line;
+	}
 
 public:
 	text_editor_core() = default;
@@ -216,69 +254,81 @@ public:
 	inline void reset_state(){
 		caret_ = {0, 0};
 		history_ = edit_history{64};
+		last_edit_.reset();
 		reset_preferred_cross_pos();
 	}
 
+	/**
+	 * @brief Range changed by the last edit since the previous call, allows the layout to update incrementally.
+	 */
+	[[nodiscard]] inline std::optional<text_edit_range> take_last_edit() noexcept{
+		return std::exchange(last_edit_, std::nullopt);
+	}
+
 
 
-	inline bool insert_text(std::u32string& text_buffer_, std::u32string_view inserted_text){
+	inline bool insert_text(text_document& text_buffer_, std::u32string_view inserted_text){
 		if(inserted_text.empty()) return false;
 		reset_preferred_cross_pos();
 
 		if(caret_.has_region()){
 			auto sorted = caret_.get_ordered();
-			history_.commit_replace(text_buffer_, caret_, sorted.src, sorted.length(), inserted_text);
-			text_buffer_.replace(sorted.src, sorted.length(), inserted_text);
+			auto removed = text_buffer_.erase(sorted.src, sorted.length());
+			auto inserted = text_buffer_.insert(sorted.src, inserted_text);
+			history_.commit_replace(caret_, sorted.src, std::move(removed), std::move(inserted));
+			last_edit_ = text_edit_range{sorted.src, sorted.length(), inserted_text.size()};
 			caret_.dst = sorted.src + text_index(inserted_text.size());
 		} else{
-			history_.commit_insertion(text_buffer_, caret_, caret_.dst, inserted_text);
-			text_buffer_.insert(caret_.dst, inserted_text);
+			history_.commit_insertion(caret_, caret_.dst, text_buffer_.insert(caret_.dst, inserted_text));
+			last_edit_ = text_edit_range{caret_.dst, 0, inserted_text.size()};
 			caret_.dst += text_index(inserted_text.size());
 		}
 		caret_.src = caret_.dst;
 		return true;
 	}
 
-	inline bool delete_selection(std::u32string& text_buffer_){
+	inline bool delete_selection(text_document& text_buffer_){
 		if(!caret_.has_region()) return false;
 		reset_preferred_cross_pos();
 		auto sorted = caret_.get_ordered();
-		history_.commit_delete(text_buffer_, caret_, sorted.src, sorted.length());
-		text_buffer_.erase(sorted.src, sorted.length());
+		history_.commit_delete(caret_, sorted.src, text_buffer_.erase(sorted.src, sorted.length()));
+		last_edit_ = text_edit_range{sorted.src, sorted.length(), 0};
 		caret_ = {sorted.src, sorted.src};
 		return true;
 	}
 
-	inline bool action_backspace(std::u32string& text_buffer_){
+	inline bool action_backspace(text_document& text_buffer_){
 		if(delete_selection(text_buffer_)) return true;
 		if(caret_.dst == 0) return false;
 		reset_preferred_cross_pos();
 
-		history_.commit_delete(text_buffer_, caret_, caret_.dst - 1, 1);
-		text_buffer_.erase(caret_.dst - 1, 1);
+		history_.commit_delete(caret_, caret_.dst - 1, text_buffer_.erase(caret_.dst - 1, 1));
+		last_edit_ = text_edit_range{caret_.dst - 1u, 1, 0};
 		caret_.dst -= 1;
 		caret_.src = caret_.dst;
 		return true;
 	}
 
-	inline bool action_delete(std::u32string& text_buffer_){
+	inline bool action_delete(text_document& text_buffer_){
 		if(delete_selection(text_buffer_)) return true;
 		if(std::cmp_greater_equal(caret_.dst, text_buffer_.size())) return false;
 		reset_preferred_cross_pos();
 
-		history_.commit_delete(text_buffer_, caret_, caret_.dst, 1);
-		text_buffer_.erase(caret_.dst, 1);
+		history_.commit_delete(caret_, caret_.dst, text_buffer_.erase(caret_.dst, 1));
+		last_edit_ = text_edit_range{caret_.dst, 1, 0};
 		return true;
 	}
 
-	inline bool undo(std::u32string& text_buffer_){
+	inline bool undo(text_document& text_buffer_){
 		reset_preferred_cross_pos();
-		return history_.undo(text_buffer_, caret_);
+		last_edit_ = history_.undo(text_buffer_, caret_);
+		return last_edit_.has_value();
 	}
 
-	inline bool redo(std::u32string& text_buffer_){
+	inline bool redo(text_document& text_buffer_){
 		reset_preferred_cross_pos();
-		return history_.redo(text_buffer_, caret_);
+		last_edit_ = history_.redo(text_buffer_, caret_);
+		return last_edit_.has_value();
 	}
 
 	inline void clear_redo() noexcept {
@@ -286,7 +336,7 @@ public:
 	}
 	
 
-	inline void action_move_left(const std::u32string_view text_buffer_, bool select){
+	inline void action_move_left(const text_document& text_buffer_, bool select){
 		reset_preferred_cross_pos();
 		if(!select && caret_.has_region()){
 			merge_caret(caret_.get_ordered().src, false, text_index(text_buffer_.size()));
@@ -295,7 +345,7 @@ public:
 		if(caret_.dst > 0) merge_caret(caret_.dst - 1, select, text_index(text_buffer_.size()));
 	}
 
-	inline void action_move_right(const std::u32string_view text_buffer_, bool select){
+	inline void action_move_right(const text_document& text_buffer_, bool select){
 		reset_preferred_cross_pos();
 		if(!select && caret_.has_region()){
 			merge_caret(caret_.get_ordered().dst, false, text_index(text_buffer_.size()));
@@ -315,7 +365,7 @@ public:
 		return char_class::other;
 	}
 
-	inline void action_jump_left(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, bool select) {
+	inline void action_jump_left(const typesetting::glyph_layout& layout, const text_document& text_buffer_, bool select) {
 		reset_preferred_cross_pos();
 		if (!select && caret_.has_region()) {
 			merge_caret(caret_.get_ordered().src, false, text_index(text_buffer_.size()));
@@ -341,7 +391,7 @@ public:
 		merge_caret(p, select, text_index(text_buffer_.size()));
 	}
 
-	inline void action_jump_right(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, bool select) {
+	inline void action_jump_right(const typesetting::glyph_layout& layout, const text_document& text_buffer_, bool select) {
 		reset_preferred_cross_pos();
 		if (!select && caret_.has_region()) {
 			merge_caret(caret_.get_ordered().dst, false, text_index(text_buffer_.size()));
@@ -369,7 +419,7 @@ public:
 		merge_caret(p, select, text_index(text_buffer_.size()));
 	}
 
-	inline void action_move_line_begin(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, bool select){
+	inline void action_move_line_begin(const typesetting::glyph_layout& layout, const text_document& text_buffer_, bool select){
 		reset_preferred_cross_pos();
 		if(layout.empty()){
 			merge_caret(0, select, text_index(text_buffer_.size()));
@@ -380,7 +430,7 @@ public:
 		merge_caret(bounds.start_idx, select, text_index(text_buffer_.size()));
 	}
 
-	inline void action_move_line_end(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, bool select){
+	inline void action_move_line_end(const typesetting::glyph_layout& layout, const text_document& text_buffer_, bool select){
 		reset_preferred_cross_pos();
 		if(layout.empty()){
 			merge_caret(text_index(text_buffer_.size()), select, text_index(text_buffer_.size()));
@@ -392,13 +442,13 @@ public:
 	}
 
 	
-	inline void action_select_all(const std::u32string_view text_buffer_) noexcept {
+	inline void action_select_all(const text_document& text_buffer_) noexcept {
 		reset_preferred_cross_pos();
 		caret_.src = 0;
 		caret_.dst = text_index(text_buffer_.size());
 	}
 
-	inline bool action_hit_test(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, math::vec2 pos, typesetting::line_alignment align,
+	inline bool action_hit_test(const typesetting::glyph_layout& layout, const text_document& text_buffer_, math::vec2 pos, typesetting::line_alignment align,
 		bool select){
 		reset_preferred_cross_pos();
 		if(layout.empty()){
@@ -409,7 +459,7 @@ public:
 		auto hit = layout.hit_test(pos, align);
 		
 		if(hit && hit.source){
-			unsigned new_index = hit.source->cluster_index + hit.span_offset;
+			unsigned new_index = hit.source_line->text_offset + hit.source->cluster_index + hit.span_offset;
 			unsigned line_idx = static_cast<unsigned>(hit.source_line - layout.lines.data());
 			auto bounds = get_line_bounds(layout, text_buffer_, line_idx);
 			new_index = std::clamp(new_index, bounds.start_idx, bounds.visual_end);
@@ -443,7 +493,7 @@ public:
 
 	
 
-	inline void move_vertical(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, bool move_down, typesetting::line_alignment align, bool select) {
+	inline void move_vertical(const typesetting::glyph_layout& layout, const text_document& text_buffer_, bool move_down, typesetting::line_alignment align, bool select) {
         if (layout.empty() || layout.lines.empty()) return;
         unsigned line_idx = get_line_index(layout, text_buffer_, caret_.dst);
 
@@ -456,10 +506,11 @@ public:
         if (!preferred_cross_pos_) {
             const auto& current_line = layout.lines[line_idx];
             const typesetting::logical_cluster* current_cluster = nullptr;
+            const unsigned caret_in_line = caret_.dst - std::min<unsigned>(caret_.dst, current_line.text_offset);
 
             for (unsigned j = 0; j < current_line.cluster_range.size; ++j) {
                 const auto& c = layout.clusters[current_line.cluster_range.pos + j];
-                if (caret_.dst >= c.cluster_index && caret_.dst < c.cluster_index + c.cluster_span) {
+                if (caret_in_line >= c.cluster_index && caret_in_line < c.cluster_index + c.cluster_span) {
                     current_cluster = &c;
                     break;
                 }
@@ -470,10 +521,10 @@ public:
 
             if (current_cluster) {
                 if (is_vertical_layout) {
-                    preferred_cross_pos_ = (caret_.dst > current_cluster->cluster_index) ?
+                    preferred_cross_pos_ = (caret_in_line > current_cluster->cluster_index) ?
                         current_cluster->logical_rect.vert_11().y : current_cluster->logical_rect.vert_00().y;
                 } else {
-                    preferred_cross_pos_ = (caret_.dst > current_cluster->cluster_index) ?
+                    preferred_cross_pos_ = (caret_in_line > current_cluster->cluster_index) ?
                         current_cluster->logical_rect.vert_11().x : current_cluster->logical_rect.vert_00().x;
                 }
             } else {
@@ -512,7 +563,7 @@ public:
 
 		auto hit = layout.hit_test(target_pos, align);
         if (hit) {
-			unsigned new_index = hit.source->cluster_index + hit.span_offset;
+			unsigned new_index = hit.source_line->text_offset + hit.source->cluster_index + hit.span_offset;
 			auto bounds = get_line_bounds(layout, text_buffer_, target_line_idx);
 			new_index = std::clamp(new_index, bounds.start_idx, bounds.visual_end);
 			merge_caret(new_index, select, text_index(text_buffer_.size()));
@@ -522,11 +573,11 @@ public:
 		}
     }
 
-	inline void action_move_up(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, typesetting::line_alignment align, bool select){
+	inline void action_move_up(const typesetting::glyph_layout& layout, const text_document& text_buffer_, typesetting::line_alignment align, bool select){
 		move_vertical(layout, text_buffer_, false, align, select);
 	}
 
-	inline void action_move_down(const typesetting::glyph_layout& layout, const std::u32string_view text_buffer_, typesetting::line_alignment align, bool select){
+	inline void action_move_down(const typesetting::glyph_layout& layout, const text_document& text_buffer_, typesetting::line_alignment align, bool select){
 		move_vertical(layout, text_buffer_, true, align, select);
 	}
 };
@@ -7,40 +7,114 @@ import mo_yanxi.gui.fx.instruction_extension;
 
 
 namespace mo_yanxi::gui{
-void record_elems(graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
-                  const typesetting::glyph_layout_draw_only& glyph_layout,
-                  typesetting::line_alignment line_align,
-                  typesetting::layout_direction direction
+namespace{
+struct line_bound_builder{
+	math::vec2 min{std::numeric_limits<float>::infinity(), std::numeric_limits<float>::infinity()};
+	math::vec2 max{-std::numeric_limits<float>::infinity(), -std::numeric_limits<float>::infinity()};
+
+	void include(const math::vec2 p) noexcept{
+		min = {std::min(min.x, p.x), std::min(min.y, p.y)};
+		max = {std::max(max.x, p.x), std::max(max.y, p.y)};
+	}
+
+	void include(const math::vec2 a, const math::vec2 b, const float margin = 0.f) noexcept{
+		include({std::min(a.x, b.x) - margin, std::min(a.y, b.y) - margin});
+		include({std::max(a.x, b.x) + margin, std::max(a.y, b.y) + margin});
+	}
+
+	//lines without any instruction stay at their origin to keep the line bounds ordered
+	[[nodiscard]] math::frect get(const math::vec2 fallback) const noexcept{
+		if(min.x > max.x) return math::frect{tags::from_vertex, fallback, fallback};
+		return math::frect{tags::from_vertex, min, max};
+	}
+};
+
+[[nodiscard]] graphic::g2d::chunk_start_pos current_pos(
+	const graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer) noexcept{
+	return {static_cast<std::uint32_t>(buffer.heads().size()), static_cast<std::uint32_t>(buffer.data().size())};
+}
+
+void record_line_elems(graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	line_bound_builder& bound,
+	const typesetting::glyph_layout_draw_only& glyph_layout,
+	const typesetting::line& line,
+	math::vec2 line_src, math::vec2 spacing
 ){
 	using namespace mo_yanxi::graphic::g2d;
 
-	record_elems(glyph_layout, line_align, direction, [&](rect_aabb&& r){
+	record_line_elems(glyph_layout, line, line_src, spacing, [&](rect_aabb&& r){
+		//slanted glyphs lean out horizontally by at most their height
+		const auto slant = std::max(std::abs(r.slant_factor_asc), std::abs(r.slant_factor_desc)) * std::abs(r.v11.y - r.v00.y);
+		bound.include(r.v00, r.v11, slant);
 		buffer.push(r);
 	});
 }
 
-void record_glyph_draw_instructions(
-	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
-	const typesetting::glyph_layout& glyph_layout, typesetting::line_alignment line_align){
+/**
+ * @brief Decorations of lines [first_line, last_line), they are produced in line order.
+ */
+template <typename Decoration>
+std::span<const Decoration> decorations_of(const std::vector<Decoration>& decorations, const std::size_t first_line, const std::size_t last_line) noexcept{
+	const auto first = std::ranges::partition_point(decorations, [&](const Decoration& d){
+		return std::cmp_less(d.line_index, first_line);
+	});
+	const auto last = std::ranges::partition_point(first, decorations.end(), [&](const Decoration& d){
+		return std::cmp_less(d.line_index, last_line);
+	});
+	return {first, last};
+}
+
+/**
+ * @brief Record lines [first_line, last_line) at the end of the buffer and append their ranges to `line_ranges`.
+ *
+ * Every wrap frame of the lines is recorded first, then the glyphs and then the underlines, so frames stay below and
+ * underlines above the text of neighbouring lines as well.
+ */
+void record_lines(graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
+	const typesetting::glyph_layout& glyph_layout,
+	const typesetting::line_alignment line_align,
+	const std::size_t first_line, const std::size_t last_line
+){
 	using namespace mo_yanxi::graphic;
 	using namespace mo_yanxi::graphic::g2d;
 
-	buffer.clear();
-	if(glyph_layout.lines.empty())return;
-	buffer.reserve_heads(glyph_layout.elems.size() + glyph_layout.underlines.size() + glyph_layout.wrap_frames.size() * 3);
-	buffer.reserve_bytes(glyph_layout.elems.size() * sizeof(rect_aabb) + glyph_layout.underlines.size() * sizeof(line));
-
 	const auto& roundRegion = gui::assets::round_square::base();
 	const bool hasRound = static_cast<bool>(roundRegion);
-	for (const auto & range : glyph_layout.wrap_frames | std::views::chunk_by(&typesetting::sub_line_decoration::chunk_by_line)){
-		auto [line_src, spacing] = glyph_layout.lines[range.front().line_index].calculate_alignment(glyph_layout.extent, line_align, glyph_layout.direction);
 
-		for (const auto & val : range){
-			const auto start = math::fma(spacing, static_cast<float>(val.start_gap_count), line_src + val.start);
-			const auto end = math::fma(spacing, static_cast<float>(val.end_gap_count), line_src + val.end);
+	const auto first_range = line_ranges.size();
+	std::vector<typesetting::line_align_result> aligns;
+	std::vector<line_bound_builder> bounds(last_line - first_line);
+	aligns.reserve(last_line - first_line);
+	for(auto line_idx = first_line; line_idx < last_line; ++line_idx){
+		const auto align = glyph_layout.lines[line_idx].calculate_alignment(glyph_layout.extent, line_align, glyph_layout.direction);
+		aligns.push_back(align);
+		line_ranges.push_back({.recorded_src = align.start_pos});
+	}
+	const auto ranges = std::span{line_ranges}.subspan(first_range);
+
+	//decorations are produced in line order, walk them along with the lines
+	const auto record_layer = [&](const text_draw_layer layer, const auto& decorations, auto&& record){
+		auto itr = decorations.begin();
+		for(std::size_t i = 0; i < ranges.size(); ++i){
+			auto& range = ranges[i].layers[std::to_underlying(layer)];
+			range.start = current_pos(buffer);
+			for(; itr != decorations.end() && std::cmp_equal(itr->line_index, first_line + i); ++itr){
+				record(*itr, aligns[i], bounds[i]);
+			}
+			range.end = current_pos(buffer);
+		}
+	};
+
+	record_layer(text_draw_layer::wrap_frame, decorations_of(glyph_layout.wrap_frames, first_line, last_line),
+		[&](const typesetting::wrap_frame& val, const typesetting::line_align_result& align, line_bound_builder& bound){
+			const auto start = math::fma(align.letter_spacing, static_cast<float>(val.start_gap_count), align.start_pos + val.start);
+			const auto end = math::fma(align.letter_spacing, static_cast<float>(val.end_gap_count), align.start_pos + val.end);
 
 			switch(val.type){
-			case typesetting::rich_text_token::wrap_frame_type::rect : buffer.push(rect_aabb_outline{
+			case typesetting::rich_text_token::wrap_frame_type::rect :
+				bound.include(start, end, 2);
+				buffer.push(rect_aabb_outline{
 						.v00 = start,
 						.v11 = end,
 						.stroke = {2},
@@ -49,6 +123,7 @@ void record_glyph_draw_instructions(
 				break;
 			case typesetting::rich_text_token::wrap_frame_type::round :
 				if(hasRound){
+					bound.include(start, end);
 					gui::fx::nine_patch_draw<&image_nine_region::get_axes_axis_scaled>{
 						.patch = &roundRegion,
 						.region = {start, end - start},
@@ -60,40 +135,120 @@ void record_glyph_draw_instructions(
 				break;
 			default : break;
 			}
-		}
+		});
 
+	for(std::size_t i = 0; i < ranges.size(); ++i){
+		auto& range = ranges[i].layers[std::to_underlying(text_draw_layer::glyph)];
+		range.start = current_pos(buffer);
+		record_line_elems(buffer, bounds[i], glyph_layout, glyph_layout.lines[first_line + i], aligns[i].start_pos, aligns[i].letter_spacing);
+		range.end = current_pos(buffer);
 	}
 
-	record_elems(buffer, glyph_layout, line_align, glyph_layout.direction);
-
-	for (const auto & underlines : glyph_layout.underlines | std::views::chunk_by(&typesetting::sub_line_decoration::chunk_by_line)){
-		auto [line_src, spacing] = glyph_layout.lines[underlines.front().line_index].calculate_alignment(glyph_layout.extent, line_align, glyph_layout.direction);
-
-		for (const auto & val : underlines){
-			const auto start = math::fma(spacing, static_cast<float>(val.start_gap_count), line_src + val.start);
-			const auto end = math::fma(spacing, static_cast<float>(val.end_gap_count), line_src + val.end);
+	record_layer(text_draw_layer::underline, decorations_of(glyph_layout.underlines, first_line, last_line),
+		[&](const typesetting::underline& val, const typesetting::line_align_result& align, line_bound_builder& bound){
+			const auto start = math::fma(align.letter_spacing, static_cast<float>(val.start_gap_count), align.start_pos + val.start);
+			const auto end = math::fma(align.letter_spacing, static_cast<float>(val.end_gap_count), align.start_pos + val.end);
 
+			bound.include(start, end, val.thickness);
 			buffer.push(line{
 					.src = start,
 					.dst = end,
 					.color = {val.color, val.color},
 					.stroke = val.thickness,
 				});
+		});
+
+	for(std::size_t i = 0; i < ranges.size(); ++i){
+		ranges[i].bound = bounds[i].get(aligns[i].start_pos);
+	}
+}
+}
+
+void record_glyph_draw_instructions(
+	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
+	const typesetting::glyph_layout& glyph_layout, typesetting::line_alignment line_align){
+	using namespace mo_yanxi::graphic;
+	using namespace mo_yanxi::graphic::g2d;
+
+	buffer.clear();
+	line_ranges.clear();
+	if(glyph_layout.lines.empty())return;
+	buffer.reserve_heads(glyph_layout.elems.size() + glyph_layout.underlines.size() + glyph_layout.wrap_frames.size() * 3);
+	buffer.reserve_bytes(glyph_layout.elems.size() * sizeof(rect_aabb) + glyph_layout.underlines.size() * sizeof(line));
+	line_ranges.reserve(glyph_layout.lines.size());
+
+	record_lines(buffer, line_ranges, glyph_layout, line_align, 0, glyph_layout.lines.size());
+}
+
+bool record_changed_glyph_draw_instructions(
+	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
+	std::size_t& garbage_heads,
+	const typesetting::glyph_layout& glyph_layout,
+	typesetting::line_alignment line_align,
+	std::span<const typesetting::line_change> changes){
+	//justified lines spread their glyphs, they cannot be moved as a whole
+	if(line_align == typesetting::line_alignment::justify) return false;
+
+	std::vector<line_draw_range> inserted{};
+	for(const auto& change : changes){
+		if(change.line + change.removed > line_ranges.size()) return false;
+		if(change.line + change.inserted > glyph_layout.lines.size()) return false;
+
+		const auto removed = std::ranges::subrange{line_ranges.begin() + change.line, line_ranges.begin() + change.line + change.removed};
+		for(const auto& range : removed){
+			for(const auto& layer : range.layers){
+				garbage_heads += layer.end.head_idx - layer.start.head_idx;
+			}
 		}
+
+		inserted.clear();
+		record_lines(buffer, inserted, glyph_layout, line_align, change.line, change.line + change.inserted);
+
+		const auto at = line_ranges.erase(removed.begin(), removed.end());
+		line_ranges.insert_range(at, inserted);
 	}
+
+	if(line_ranges.size() != glyph_layout.lines.size()) return false;
+	if(garbage_heads > buffer.heads().size() / 2) return false;
+
+	for(auto&& [range, current_line] : std::views::zip(line_ranges, glyph_layout.lines)){
+		const auto line_src = current_line.calculate_alignment(glyph_layout.extent, line_align, glyph_layout.direction).start_pos;
+		range.offset = line_src - range.recorded_src;
+		//realigned lines would each need their own translation
+		if(range.offset.x != 0.f) return false;
+	}
+
+	return true;
 }
 
 void record_glyph_draw_instructions_draw_only(
 	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
 	const typesetting::glyph_layout_draw_only& glyph_layout,
 	typesetting::line_alignment line_align, typesetting::layout_direction direction){
 	using namespace mo_yanxi::graphic;
 	using namespace mo_yanxi::graphic::g2d;
 
 	buffer.clear();
+	line_ranges.clear();
 	buffer.reserve_heads(glyph_layout.elems.size());
 	buffer.reserve_bytes(glyph_layout.elems.size() * sizeof(rect_aabb));
-
-	record_elems(buffer, glyph_layout, line_align, direction);
+	line_ranges.reserve(glyph_layout.lines.size());
+
+	for(const auto& current_line : glyph_layout.lines){
+		auto [line_src, spacing] = current_line.calculate_alignment(glyph_layout.extent, line_align, direction);
+		line_draw_range& range = line_ranges.emplace_back(line_draw_range{.recorded_src = line_src});
+		line_bound_builder bound{};
+		//no decoration, every layer but the glyphs is left empty
+		for(auto& layer : range.layers){
+			layer = {current_pos(buffer), current_pos(buffer)};
+		}
+		auto& glyphs = range.layers[std::to_underlying(text_draw_layer::glyph)];
+		record_line_elems(buffer, bound, glyph_layout, current_line, line_src, spacing);
+		glyphs.end = current_pos(buffer);
+		range.bound = bound.get(line_src);
+	}
 }
 }
@@ -14,9 +14,42 @@ import mo_yanxi.gui.renderer.frontend;
 import mo_yanxi.graphic.g2d;
 import mo_yanxi.gui.alloc;
 import mo_yanxi.gui.util;
+import mo_yanxi.math.rect_ortho;
+import mo_yanxi.math.matrix3;
 import align;
 
 namespace mo_yanxi::gui {
+export
+template <std::invocable<graphic::g2d::rect_aabb&&> Fn>
+void record_line_elems(
+	const typesetting::glyph_layout_draw_only& glyph_layout,
+	const typesetting::line& current_line,
+	math::vec2 line_src, math::vec2 spacing,
+	Fn&& fn
+){
+	using namespace mo_yanxi::graphic::g2d;
+
+	for(const auto& [idx, val] : std::span{
+		    glyph_layout.elems.begin() + current_line.glyph_range.pos, current_line.glyph_range.size
+	    } | std::views::enumerate){
+		if(!val.texture->view) continue;
+		auto start = math::fma(static_cast<float>(idx), spacing, line_src + val.aabb.src);
+		std::invoke(
+			fn,
+			rect_aabb{
+				.generic = {.image = val.texture->texture_binding()},
+				.v00 = start,
+				.v11 = start + val.aabb.extent(),
+				.uv00 = val.texture->uv.v00(),
+				.uv11 = val.texture->uv.v11(),
+				.vert_color = {val.color},
+				.slant_factor_asc = val.slant_factor_asc,
+				.slant_factor_desc = val.slant_factor_desc,
+				.sdf_expand = -val.weight_offset
+			});
+	}
+}
+
 export
 template <std::invocable<graphic::g2d::rect_aabb&&> Fn>
 void record_elems(
@@ -29,51 +62,143 @@ void record_elems(
 	for(const auto& current_line : glyph_layout.lines){
 		auto [line_src, spacing] = current_line.calculate_alignment(glyph_layout.extent, line_align,
 		                                                            direction);
-
-		for(const auto& [idx, val] : std::span{
-			    glyph_layout.elems.begin() + current_line.glyph_range.pos, current_line.glyph_range.size
-		    } | std::views::enumerate){
-			if(!val.texture->view) continue;
-			auto start = math::fma(static_cast<float>(idx), spacing, line_src + val.aabb.src);
-			std::invoke(
-				std::forward<Fn>(fn),
-				rect_aabb{
-					.generic = {.image = val.texture->texture_binding()},
-					.v00 = start,
-					.v11 = start + val.aabb.extent(),
-					.uv00 = val.texture->uv.v00(),
-					.uv11 = val.texture->uv.v11(),
-					.vert_color = {val.color},
-					.slant_factor_asc = val.slant_factor_asc,
-					.slant_factor_desc = val.slant_factor_desc,
-					.sdf_expand = -val.weight_offset
-				});
-		}
+		record_line_elems(glyph_layout, current_line, line_src, spacing, fn);
 	}
 }
 
+template <typename Alloc>
+void push(renderer_frontend& r, const graphic::g2d::draw_record_storage<Alloc>& buf){
+	r << buf;
+}
+
+/**
+ * @brief Layers of the recorded text, pushed in this order so frames are below and underlines above every glyph.
+ */
+export enum struct text_draw_layer : std::uint8_t{
+	wrap_frame,
+	glyph,
+	underline,
+};
+
+export struct draw_range{
+	graphic::g2d::chunk_start_pos start;
+	graphic::g2d::chunk_start_pos end;
+
+	[[nodiscard]] constexpr bool empty() const noexcept{
+		return start.head_idx == end.head_idx;
+	}
+};
+
+/**
+ * @brief Instructions of one layout line inside the draw buffer, per layer.
+ *
+ * A full recording stores each layer of the lines one after another, an incremental one appends the layers of the
+ * replaced lines at the end of the buffer and translates the lines that only moved.
+ */
+export struct line_draw_range{
+	std::array<draw_range, 3> layers;
+	/** @brief Bound and line origin at the time the line was recorded. */
+	math::frect bound;
+	math::vec2 recorded_src;
+	/** @brief Translation of the line since it was recorded. */
+	math::vec2 offset;
+
+	[[nodiscard]] math::frect get_bound() const noexcept{
+		return {tags::from_vertex, bound.get_src() + offset, bound.get_end() + offset};
+	}
+};
+
+/**
+ * @brief Record the layout layer by layer, the instructions of each line are in `line_ranges[line].layers`.
+ */
 void record_glyph_draw_instructions(
 	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
 	const typesetting::glyph_layout& glyph_layout,
 	typesetting::line_alignment line_align
 );
 
+/**
+ * @brief Record only the lines replaced by `changes` and translate the other ones to their new origin.
+ *
+ * @param garbage_heads instructions of replaced lines still held by the buffer
+ * @return false if the buffer must be recorded again, e.g. lines moved horizontally or the buffer is mostly garbage
+ */
+bool record_changed_glyph_draw_instructions(
+	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
+	std::size_t& garbage_heads,
+	const typesetting::glyph_layout& glyph_layout,
+	typesetting::line_alignment line_align,
+	std::span<const typesetting::line_change> changes
+);
+
 void record_glyph_draw_instructions_draw_only(
 	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>>& buffer,
+	std::vector<line_draw_range>& line_ranges,
 	const typesetting::glyph_layout_draw_only& glyph_layout,
 	typesetting::line_alignment line_align, typesetting::layout_direction direction
 );
 
-template <typename Alloc>
-void push(renderer_frontend& r, const graphic::g2d::draw_record_storage<Alloc>& buf){
-	r << buf;
-}
-
 export struct text_render_cache {
 private:
 	graphic::g2d::draw_record_storage<mr::unvs_allocator<std::byte>> draw_instr_buffer_{};
+	std::vector<line_draw_range> line_ranges_{};
+	std::size_t garbage_heads_{};
+	//whether line bounds are sorted along y, allowing the visible lines to be binary searched
+	bool lines_ordered_y_{};
 	typesetting::line_alignment line_align_{};
 
+	void on_recorded_() noexcept{
+		lines_ordered_y_ = std::ranges::is_sorted(line_ranges_, {}, [](const line_draw_range& l){ return l.get_bound().get_src().y; })
+			&& std::ranges::is_sorted(line_ranges_, {}, [](const line_draw_range& l){ return l.get_bound().get_end().y; });
+	}
+
+	[[nodiscard]] graphic::g2d::instr_chunk chunk_of_(const draw_range range) const noexcept{
+		const auto heads = draw_instr_buffer_.heads();
+		const auto data = draw_instr_buffer_.data();
+		return {
+				heads.subspan(range.start.head_idx, range.end.head_idx - range.start.head_idx),
+				data.subspan(range.start.byte_idx, range.end.byte_idx - range.start.byte_idx)
+			};
+	}
+
+	void push_chunk_(renderer_frontend& r, const draw_range range, const math::vec2 offset) const{
+		if(offset == math::vec2{}){
+			r << chunk_of_(range);
+			return;
+		}
+		math::mat3 mat = math::mat3_idt;
+		mat.c3.x = offset.x;
+		mat.c3.y = offset.y;
+		transform_guard _t{r, mat};
+		r << chunk_of_(range);
+	}
+
+	/**
+	 * @brief Push lines [first_line, last_line) layer by layer, in as few batches as the buffer layout allows.
+	 */
+	void push_lines_(renderer_frontend& r, const std::size_t first_line, const std::size_t last_line) const{
+		for(std::size_t layer = 0; layer < std::tuple_size_v<decltype(line_draw_range::layers)>; ++layer){
+			for(std::size_t i = first_line; i < last_line;){
+				if(line_ranges_[i].layers[layer].empty()){
+					++i;
+					continue;
+				}
+
+				const auto offset = line_ranges_[i].offset;
+				draw_range run = line_ranges_[i].layers[layer];
+				for(++i; i < last_line; ++i){
+					const auto& next = line_ranges_[i];
+					if(next.layers[layer].empty()) continue;
+					if(next.layers[layer].start != run.end || next.offset != offset) break;
+					run.end = next.layers[layer].end;
+				}
+				push_chunk_(r, run, offset);
+			}
+		}
+	}
+
 public:
 
 	[[nodiscard]] inline bool has_drawable_text() const noexcept {
@@ -93,19 +218,71 @@ public:
 
 	// 核心的指令录制，原 update_draw_buffer
 	inline void update_buffer(const typesetting::glyph_layout& layout) {
-		record_glyph_draw_instructions(draw_instr_buffer_, layout, line_align_);
+		record_glyph_draw_instructions(draw_instr_buffer_, line_ranges_, layout, line_align_);
+		garbage_heads_ = 0;
+		on_recorded_();
 	}
 
-	inline void update_buffer(const typesetting::glyph_layout_draw_only& layout, typesetting::layout_direction direction = typesetting::layout_direction::ltr) {
-		record_glyph_draw_instructions_draw_only(draw_instr_buffer_, layout, line_align_, direction);
+	/**
+	 * @brief Re-record only the lines replaced since the previous update, `changes` must cover every replaced line.
+	 */
+	inline void update_buffer(const typesetting::glyph_layout& layout, std::span<const typesetting::line_change> changes) {
+		if(!record_changed_glyph_draw_instructions(draw_instr_buffer_, line_ranges_, garbage_heads_, layout, line_align_, changes)){
+			update_buffer(layout);
+			return;
+		}
+		on_recorded_();
 	}
 
-	inline void operator()(graphic::g2d::emit_t emit, auto& sink) const {
-		emit(sink, draw_instr_buffer_);
+	inline void update_buffer(const typesetting::glyph_layout_draw_only& layout, typesetting::layout_direction direction = typesetting::layout_direction::ltr) {
+		record_glyph_draw_instructions_draw_only(draw_instr_buffer_, line_ranges_, layout, line_align_, direction);
+		garbage_heads_ = 0;
+		on_recorded_();
 	}
 
 	inline void push_to_renderer(renderer_frontend& r) const {
-		r << *this;
+		push_lines_(r, 0, line_ranges_.size());
+	}
+
+	/**
+	 * @brief Push only the lines intersecting `clip` (in layout space), consecutive visible lines are pushed as one batch.
+	 */
+	inline void push_to_renderer(renderer_frontend& r, const math::frect clip) const {
+		if(line_ranges_.empty()) return;
+
+		const auto overlaps = [&](const line_draw_range& l){
+			const auto bound = l.get_bound();
+			return bound.get_end().x >= clip.get_src().x && bound.get_src().x <= clip.get_end().x
+				&& bound.get_end().y >= clip.get_src().y && bound.get_src().y <= clip.get_end().y;
+		};
+
+		if(lines_ordered_y_){
+			const auto first = std::ranges::partition_point(line_ranges_, [&](const line_draw_range& l){
+				return l.get_bound().get_end().y < clip.get_src().y;
+			});
+			const auto last = std::ranges::partition_point(first, line_ranges_.end(), [&](const line_draw_range& l){
+				return l.get_bound().get_src().y <= clip.get_end().y;
+			});
+			push_lines_(r, first - line_ranges_.begin(), last - line_ranges_.begin());
+			return;
+		}
+
+		for(std::size_t i = 0; i < line_ranges_.size();){
+			if(!overlaps(line_ranges_[i])){
+				++i;
+				continue;
+			}
+			const auto run_begin = i;
+			while(i < line_ranges_.size() && overlaps(line_ranges_[i])) ++i;
+			push_lines_(r, run_begin, i);
+		}
+	}
+
+	/**
+	 * @brief Push the lines visible inside the current scissor, the renderer must already carry the layout transform.
+	 */
+	inline void push_visible_to_renderer(renderer_frontend& r) const {
+		push_to_renderer(r, r.get_local_scissor_bound());
 	}
 };
 
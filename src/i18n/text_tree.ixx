@@ -3,6 +3,7 @@ export module mo_yanxi.i18n.text_tree;
 import std;
 import magic_enum;
 export import mo_yanxi.referenced_ptr;
+import mo_yanxi.platform.mapped_file;
 
 namespace mo_yanxi::i18n {
 
@@ -141,6 +142,28 @@ struct node_record {
 	std::uint32_t tree_ptr_index{invalid_node_id};
 };
 
+/**
+ * @brief Open addressing slot of the path index, `node == invalid_node_id` marks an empty slot.
+ */
+struct path_index_slot {
+	std::uint32_t tag{};
+	node_id node{invalid_node_id};
+	std::uint32_t path_offset{};
+	std::uint32_t path_size{};
+};
+
+//stable across builds and platforms, the index is stored in the binary form
+[[nodiscard]] constexpr std::uint64_t hash_path(std::string_view path) noexcept {
+	std::uint64_t h = 0xcbf29ce484222325ULL;
+	for(const char c : path) {
+		h = (h ^ static_cast<std::uint8_t>(c)) * 0x100000001b3ULL;
+	}
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return h;
+}
+
 struct build_edge {
 	edge_kind kind{edge_kind::direct};
 	node_id target{invalid_node_id};
@@ -176,6 +199,33 @@ struct build_node {
 	return (value + alignment - 1) / alignment * alignment;
 }
 
+/**
+ * @brief Header of the binary form, followed by the payload exactly as a frozen tree keeps it in memory.
+ *
+ * The record sizes and byte order mark reject files written by an incompatible build instead of misreading them.
+ */
+struct binary_header {
+	static constexpr std::array<char, 4> expected_magic{'X', 'T', 'T', 'B'};
+	static constexpr std::uint32_t current_version = 2;
+	static constexpr std::uint32_t native_byte_order = 0x01020304;
+
+	std::array<char, 4> magic{expected_magic};
+	std::uint32_t version{current_version};
+	std::uint32_t byte_order{native_byte_order};
+	std::uint32_t node_record_size{sizeof(node_record)};
+	std::uint32_t edge_record_size{sizeof(edge_record)};
+	std::uint32_t node_count{};
+	std::uint32_t edge_count{};
+	node_id root{};
+	std::uint64_t strings_size{};
+	std::uint64_t payload_size{};
+	std::uint32_t index_capacity{};
+	std::array<std::uint32_t, 3> reserved{};
+};
+
+static_assert(std::is_trivially_copyable_v<binary_header>);
+static_assert(sizeof(binary_header) % alignof(std::max_align_t) == 0);
+
 }
 
 
@@ -195,6 +245,9 @@ public:
 		if(nodes_.empty() || path.empty()) {
 			return {.status = path.empty() ? lookup_status::invalid_path : lookup_status::missing};
 		}
+		if(const auto indexed = find_indexed(path); indexed != invalid_node_id) {
+			return result_for(this, indexed);
+		}
 		resolver_state state{};
 		state.depth = 1;
 		state.stack[0] = path_frame{this, root_};
@@ -212,7 +265,7 @@ public:
 	[[nodiscard]] text_tree_cursor operator[](std::string_view path) const noexcept;
 
 	[[nodiscard]] const std::byte* raw_data() const noexcept {
-		return payload_data();
+		return payload_;
 	}
 
 	[[nodiscard]] std::size_t raw_size() const noexcept {
@@ -227,19 +280,117 @@ public:
 		return this->ref_count();
 	}
 
+	/**
+	 * @brief Whether the payload lives in a mapped binary file rather than next to the tree object.
+	 */
+	[[nodiscard]] bool is_mapped() const noexcept {
+		return static_cast<bool>(mapping_);
+	}
+
+	/**
+	 * @brief Whether `lookup` can answer plain paths from the precomputed path index.
+	 */
+	[[nodiscard]] bool has_path_index() const noexcept {
+		return !path_index_.empty();
+	}
+
+	/**
+	 * @brief Whether `path` is answered from the path index instead of being walked segment by segment.
+	 */
+	[[nodiscard]] bool is_path_indexed(std::string_view path) const noexcept {
+		return find_indexed(path) != invalid_node_id;
+	}
+
+	/**
+	 * @brief Write the binary form read back by `map_binary`.
+	 *
+	 * @throws std::invalid_argument if the tree mounts other frozen trees, they have no on-disk form
+	 * @throws std::runtime_error if the stream fails
+	 */
+	void write_binary(std::ostream& out) const {
+		if(!tree_ptrs_.empty()) {
+			throw std::invalid_argument{"text tree with mounted trees cannot be serialized"};
+		}
+
+		const detail::binary_header header{
+			.node_count = static_cast<std::uint32_t>(nodes_.size()),
+			.edge_count = static_cast<std::uint32_t>(edges_.size()),
+			.root = root_,
+			.strings_size = strings_size_,
+			.payload_size = buffer_size_,
+			.index_capacity = static_cast<std::uint32_t>(path_index_.size()),
+		};
+		out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		out.write(reinterpret_cast<const char*>(raw_data()), static_cast<std::streamsize>(raw_size()));
+		if(!out) {
+			throw std::runtime_error{"failed to write text tree binary"};
+		}
+	}
+
+	/**
+	 * @brief View a tree written by `write_binary` in place, nothing is copied or parsed.
+	 *
+	 * The records are validated once so lookups on a corrupted file cannot leave the mapping, the mapping is
+	 * released with the last reference to the tree.
+	 *
+	 * @throws std::invalid_argument if the file is not a compatible text tree binary
+	 */
+	[[nodiscard]] static frozen_text_tree_ptr map_binary(platform::mapped_file file) {
+		if(const auto error = validate_binary(file.bytes())) {
+			throw std::invalid_argument{std::format("invalid text tree binary: {}", error)};
+		}
+
+		detail::binary_header header;
+		std::memcpy(&header, file.data(), sizeof(header));
+
+		auto* memory = static_cast<std::byte*>(::operator new(payload_offset(), std::align_val_t{allocation_alignment()}));
+		auto* tree = new (static_cast<void*>(memory)) frozen_text_tree{static_cast<std::size_t>(header.payload_size), header.root};
+		tree->mapping_ = std::move(file);
+		tree->payload_ = tree->mapping_.data() + sizeof(header);
+		tree->bind_payload(make_payload_layout({
+			.node_count = header.node_count,
+			.edge_count = header.edge_count,
+			.index_capacity = header.index_capacity,
+			.string_size = static_cast<std::size_t>(header.strings_size),
+		}));
+		return frozen_text_tree_ptr{tree};
+	}
+
 	[[nodiscard]] node_kind kind_of(node_id id) const {
 		check_node_id(id, nodes_.size());
 		return nodes_[id].kind;
 	}
 
+	/**
+	 * @brief Visit every text stored in this tree, mounted trees are not entered.
+	 */
+	template <std::invocable<std::string_view> Fn>
+	void for_each_text(Fn&& fn) const {
+		for(const auto& node : nodes_) {
+			if(node.kind == node_kind::text) {
+				std::invoke(fn, string_at(node.text_offset, node.text_size));
+			}
+		}
+	}
+
 private:
 	friend class text_tree_builder;
 	friend class text_tree_cursor;
 	friend struct frozen_text_tree_deleter;
 
+	struct payload_counts {
+		std::size_t node_count{};
+		std::size_t edge_count{};
+		std::size_t index_capacity{};
+		std::size_t tree_ptr_count{};
+		std::size_t string_size{};
+	};
+
 	struct payload_layout {
+		payload_counts counts{};
 		std::size_t nodes_offset{};
 		std::size_t edges_offset{};
+		std::size_t index_offset{};
 		std::size_t ptrs_offset{};
 		std::size_t strings_offset{};
 		std::size_t total_size{};
@@ -258,8 +409,11 @@ private:
 	};
 
 	std::size_t buffer_size_{};
+	const std::byte* payload_{};
+	platform::mapped_file mapping_{};
 	std::span<const detail::node_record> nodes_{};
 	std::span<const detail::edge_record> edges_{};
+	std::span<const detail::path_index_slot> path_index_{};
 	std::span<const frozen_text_tree_ptr> tree_ptrs_{};
 	const char* strings_{};
 	std::size_t strings_size_{};
@@ -290,22 +444,152 @@ private:
 		return reinterpret_cast<const std::byte*>(this) + payload_offset();
 	}
 
-	[[nodiscard]] static payload_layout make_payload_layout(
-		std::size_t node_count,
-		std::size_t edge_count,
-		std::size_t tree_ptr_count,
-		std::size_t string_size) noexcept {
+	[[nodiscard]] static payload_layout make_payload_layout(const payload_counts& counts) noexcept {
 		const auto nodes_offset = std::size_t{};
-		const auto edges_offset = detail::align_up(node_count * sizeof(detail::node_record), alignof(detail::edge_record));
-		const auto ptrs_offset = detail::align_up(edges_offset + edge_count * sizeof(detail::edge_record), alignof(frozen_text_tree_ptr));
-		const auto strings_offset = detail::align_up(ptrs_offset + tree_ptr_count * sizeof(frozen_text_tree_ptr), alignof(char));
+		const auto edges_offset = detail::align_up(counts.node_count * sizeof(detail::node_record), alignof(detail::edge_record));
+		const auto index_offset = detail::align_up(edges_offset + counts.edge_count * sizeof(detail::edge_record), alignof(detail::path_index_slot));
+		const auto ptrs_offset = detail::align_up(index_offset + counts.index_capacity * sizeof(detail::path_index_slot), alignof(frozen_text_tree_ptr));
+		const auto strings_offset = detail::align_up(ptrs_offset + counts.tree_ptr_count * sizeof(frozen_text_tree_ptr), alignof(char));
 		return payload_layout{
+			.counts = counts,
 			.nodes_offset = nodes_offset,
 			.edges_offset = edges_offset,
+			.index_offset = index_offset,
 			.ptrs_offset = ptrs_offset,
 			.strings_offset = strings_offset,
-			.total_size = strings_offset + string_size,
+			.total_size = strings_offset + counts.string_size,
+		};
+	}
+
+	void bind_payload(const payload_layout& layout) noexcept {
+		const auto& counts = layout.counts;
+		nodes_ = std::span{reinterpret_cast<const detail::node_record*>(payload_ + layout.nodes_offset), counts.node_count};
+		edges_ = std::span{reinterpret_cast<const detail::edge_record*>(payload_ + layout.edges_offset), counts.edge_count};
+		path_index_ = std::span{reinterpret_cast<const detail::path_index_slot*>(payload_ + layout.index_offset), counts.index_capacity};
+		tree_ptrs_ = std::span{reinterpret_cast<const frozen_text_tree_ptr*>(payload_ + layout.ptrs_offset), counts.tree_ptr_count};
+		strings_ = reinterpret_cast<const char*>(payload_ + layout.strings_offset);
+		strings_size_ = counts.string_size;
+	}
+
+	/**
+	 * @brief Node of a path registered in the path index, `invalid_node_id` when the walker has to resolve it.
+	 */
+	[[nodiscard]] node_id find_indexed(std::string_view path) const noexcept {
+		if(path_index_.empty()) {
+			return invalid_node_id;
+		}
+		const auto hash = detail::hash_path(path);
+		const auto tag = static_cast<std::uint32_t>(hash >> 32);
+		const auto mask = path_index_.size() - 1;
+		auto slot_index = static_cast<std::size_t>(hash) & mask;
+		for(std::size_t probe = 0; probe < path_index_.size(); ++probe, slot_index = (slot_index + 1) & mask) {
+			const auto& slot = path_index_[slot_index];
+			if(slot.node == invalid_node_id) {
+				return invalid_node_id;
+			}
+			if(slot.tag == tag && string_at(slot.path_offset, slot.path_size) == path) {
+				return slot.node;
+			}
+		}
+		return invalid_node_id;
+	}
+
+	[[nodiscard]] static const char* validate_binary(std::span<const std::byte> bytes) noexcept {
+		if(bytes.size() < sizeof(detail::binary_header)) {
+			return "file too small";
+		}
+
+		detail::binary_header header;
+		std::memcpy(&header, bytes.data(), sizeof(header));
+		if(header.magic != detail::binary_header::expected_magic) {
+			return "bad magic";
+		}
+		if(header.version != detail::binary_header::current_version) {
+			return "unsupported version";
+		}
+		if(header.byte_order != detail::binary_header::native_byte_order
+			|| header.node_record_size != sizeof(detail::node_record)
+			|| header.edge_record_size != sizeof(detail::edge_record)) {
+			return "written by an incompatible build";
+		}
+		if(header.node_count == 0 || header.root >= header.node_count) {
+			return "root out of range";
+		}
+		if(header.strings_size > bytes.size()) {
+			return "truncated";
+		}
+		if(!std::has_single_bit(header.index_capacity) && header.index_capacity != 0) {
+			return "path index capacity is not a power of two";
+		}
+
+		const auto layout = make_payload_layout({
+			.node_count = header.node_count,
+			.edge_count = header.edge_count,
+			.index_capacity = header.index_capacity,
+			.string_size = static_cast<std::size_t>(header.strings_size),
+		});
+		if(header.payload_size != layout.total_size || bytes.size() - sizeof(header) < layout.total_size) {
+			return "truncated";
+		}
+
+		const auto* payload = bytes.data() + sizeof(header);
+		if(reinterpret_cast<std::uintptr_t>(payload) % alignof(std::max_align_t) != 0) {
+			return "misaligned mapping";
+		}
+
+		const auto in_strings = [&](std::uint64_t offset, std::uint64_t size) noexcept {
+			return offset <= header.strings_size && size <= header.strings_size - offset;
 		};
+
+		const std::span nodes{reinterpret_cast<const detail::node_record*>(payload + layout.nodes_offset), header.node_count};
+		for(const auto& node : nodes) {
+			switch(node.kind) {
+			case node_kind::directory:
+				if(std::uint64_t{node.edge_begin} + node.edge_count > header.edge_count) {
+					return "edge range out of bounds";
+				}
+				break;
+			case node_kind::text:
+				if(!in_strings(node.text_offset, node.text_size)) {
+					return "text out of bounds";
+				}
+				break;
+			default:
+				return "unsupported node kind";
+			}
+		}
+
+		const std::span edges{reinterpret_cast<const detail::edge_record*>(payload + layout.edges_offset), header.edge_count};
+		for(const auto& edge : edges) {
+			if(!in_strings(edge.name_offset, edge.name_size)) {
+				return "edge name out of bounds";
+			}
+			switch(edge.kind) {
+			case detail::edge_kind::direct:
+				if(edge.target >= header.node_count) {
+					return "edge target out of range";
+				}
+				break;
+			case detail::edge_kind::symbolic_link:
+				if(!in_strings(edge.link_offset, edge.link_size)) {
+					return "link target out of bounds";
+				}
+				break;
+			default:
+				return "unsupported edge kind";
+			}
+		}
+
+		const std::span index{reinterpret_cast<const detail::path_index_slot*>(payload + layout.index_offset), header.index_capacity};
+		for(const auto& slot : index) {
+			if(slot.node == invalid_node_id) {
+				continue;
+			}
+			if(slot.node >= header.node_count || !in_strings(slot.path_offset, slot.path_size)) {
+				return "path index entry out of range";
+			}
+		}
+		return nullptr;
 	}
 
 	static void check_node_id(node_id id, std::size_t size) {
@@ -528,10 +812,17 @@ private:
 	[[nodiscard]] static frozen_text_tree_ptr create_from(
 		std::vector<detail::node_record>& nodes,
 		std::vector<detail::edge_record>& edges,
+		std::vector<detail::path_index_slot>& path_index,
 		std::vector<frozen_text_tree_ptr>& tree_ptrs,
 		std::string& strings,
 		node_id root) {
-		const auto layout = make_payload_layout(nodes.size(), edges.size(), tree_ptrs.size(), strings.size());
+		const auto layout = make_payload_layout({
+			.node_count = nodes.size(),
+			.edge_count = edges.size(),
+			.index_capacity = path_index.size(),
+			.tree_ptr_count = tree_ptrs.size(),
+			.string_size = strings.size(),
+		});
 		const auto allocation_size = payload_offset() + layout.total_size;
 		auto* memory = static_cast<std::byte*>(::operator new(allocation_size, std::align_val_t{allocation_alignment()}));
 
@@ -541,6 +832,9 @@ private:
 		try {
 			tree = new (static_cast<void*>(memory)) frozen_text_tree{layout.total_size, root};
 			auto* raw = tree->payload_data();
+			tree->payload_ = raw;
+			//alignment gaps are written out by write_binary, keep them deterministic
+			std::memset(raw, 0, layout.total_size);
 
 			auto* node_dst = reinterpret_cast<detail::node_record*>(raw + layout.nodes_offset);
 			for(std::size_t i = 0; i < nodes.size(); ++i) {
@@ -552,6 +846,11 @@ private:
 				std::construct_at(edge_dst + i, edges[i]);
 			}
 
+			auto* index_dst = reinterpret_cast<detail::path_index_slot*>(raw + layout.index_offset);
+			for(std::size_t i = 0; i < path_index.size(); ++i) {
+				std::construct_at(index_dst + i, path_index[i]);
+			}
+
 			ptr_dst = reinterpret_cast<frozen_text_tree_ptr*>(raw + layout.ptrs_offset);
 			for(std::size_t i = 0; i < tree_ptrs.size(); ++i) {
 				std::construct_at(ptr_dst + i, std::move(tree_ptrs[i]));
@@ -561,11 +860,7 @@ private:
 			auto* str_dst = reinterpret_cast<char*>(raw + layout.strings_offset);
 			std::ranges::copy(strings, str_dst);
 
-			tree->nodes_ = std::span<const detail::node_record>{node_dst, nodes.size()};
-			tree->edges_ = std::span<const detail::edge_record>{edge_dst, edges.size()};
-			tree->tree_ptrs_ = std::span<const frozen_text_tree_ptr>{ptr_dst, tree_ptrs.size()};
-			tree->strings_ = str_dst;
-			tree->strings_size_ = strings.size();
+			tree->bind_payload(layout);
 
 			return frozen_text_tree_ptr{tree};
 		} catch(...) {
@@ -593,6 +888,31 @@ inline void frozen_text_tree_deleter::operator()(frozen_text_tree* tree) const n
 	frozen_text_tree::destroy_heap(tree);
 }
 
+export inline constexpr std::string_view text_tree_binary_extension{".ttb"};
+
+/**
+ * @brief Compile a frozen tree to a file `map_text_tree_binary_file` can map, replacing it atomically.
+ */
+export void save_text_tree_binary_file(const frozen_text_tree& tree, const std::filesystem::path& path) {
+	auto temp_path = path;
+	temp_path += ".tmp";
+	{
+		std::ofstream out{temp_path, std::ios::binary | std::ios::trunc};
+		if(!out.is_open()) {
+			throw std::runtime_error{std::format("failed to open text tree binary {}", temp_path.string())};
+		}
+		tree.write_binary(out);
+	}
+	std::filesystem::rename(temp_path, path);
+}
+
+/**
+ * @throws std::invalid_argument if the file is missing or not a compatible text tree binary
+ */
+export [[nodiscard]] frozen_text_tree_ptr map_text_tree_binary_file(const std::filesystem::path& path) {
+	return frozen_text_tree::map_binary(platform::mapped_file{path});
+}
+
 class text_tree_cursor {
 public:
 	[[nodiscard]] text_tree_cursor() = default;
@@ -808,9 +1128,21 @@ public:
 			detail::build_edge{.kind = detail::edge_kind::symbolic_link, .link_target = std::string{target}});
 	}
 
+	/**
+	 * @brief Whether `freeze` precomputes the full path index, enabled by default.
+	 *
+	 * The index maps every path reachable through plain edges (hard links included) to its node, so `lookup` of
+	 * such a path is one hash probe; paths through symbolic links or mounted trees still go through the walker.
+	 * It costs one slot per path plus the path strings, disable it for trees that are rarely looked up.
+	 */
+	void set_path_index_enabled(bool enabled) noexcept {
+		path_index_enabled_ = enabled;
+	}
+
 	[[nodiscard]] frozen_text_tree_ptr freeze() && {
 		std::vector<detail::node_record> frozen_nodes;
 		std::vector<detail::edge_record> frozen_edges;
+		std::vector<detail::path_index_slot> frozen_path_index;
 		std::vector<frozen_text_tree_ptr> frozen_tree_ptrs;
 		std::string frozen_strings;
 
@@ -855,9 +1187,14 @@ public:
 			});
 		}
 
+		if(path_index_enabled_) {
+			frozen_path_index = build_path_index(frozen_strings);
+		}
+
 		auto frozen = frozen_text_tree::create_from(
 			frozen_nodes,
 			frozen_edges,
+			frozen_path_index,
 			frozen_tree_ptrs,
 			frozen_strings,
 			root_namespace());
@@ -872,6 +1209,10 @@ private:
 	mutable std::vector<node_id> reach_stack_{};
 	mutable std::vector<std::uint32_t> reach_marks_{};
 	mutable std::uint32_t reach_epoch_{1};
+	bool path_index_enabled_{true};
+
+	/** @brief Paths to a node beyond this many are left to the walker, hard linked directories multiply paths. */
+	static constexpr std::size_t max_indexed_paths_per_node = 4;
 
 	[[nodiscard]] static std::uint32_t checked_u32(std::size_t value, const char* message) {
 		if(!std::in_range<std::uint32_t>(value)) {
@@ -887,6 +1228,66 @@ private:
 		return offset;
 	}
 
+	void collect_index_paths(
+		node_id id,
+		std::size_t depth,
+		std::string& path,
+		std::string& strings,
+		std::vector<detail::path_index_slot>& entries,
+		std::vector<std::size_t>& path_counts) const {
+		for(const auto& [name, edge] : nodes_[id].children) {
+			if(edge.kind != detail::edge_kind::direct) {
+				continue;
+			}
+			//every path through this one also reaches the descendants, which already got as many paths as the cap
+			if(path_counts[edge.target] >= max_indexed_paths_per_node) {
+				continue;
+			}
+			++path_counts[edge.target];
+
+			const auto prev_size = path.size();
+			if(depth != 0) {
+				path.push_back('.');
+			}
+			path.append(name);
+
+			entries.push_back(detail::path_index_slot{
+				.tag = static_cast<std::uint32_t>(detail::hash_path(path) >> 32),
+				.node = edge.target,
+				.path_offset = append_string(strings, path),
+				.path_size = checked_u32(path.size(), "text tree path too large"),
+			});
+
+			//the walker rejects paths as deep as its stack, they must not be answered from the index either
+			if(detail::is_local_namespace(nodes_[edge.target].kind) && depth + 2 < frozen_text_tree::max_path_depth) {
+				collect_index_paths(edge.target, depth + 1, path, strings, entries, path_counts);
+			}
+			path.resize(prev_size);
+		}
+	}
+
+	[[nodiscard]] std::vector<detail::path_index_slot> build_path_index(std::string& strings) const {
+		std::vector<detail::path_index_slot> entries;
+		std::string path;
+		std::vector<std::size_t> path_counts(nodes_.size());
+		collect_index_paths(root_namespace(), 0, path, strings, entries, path_counts);
+		if(entries.empty()) {
+			return {};
+		}
+
+		std::vector<detail::path_index_slot> slots(std::bit_ceil(entries.size() * 2));
+		const auto mask = slots.size() - 1;
+		for(const auto& entry : entries) {
+			const auto hash = detail::hash_path(std::string_view{strings.data() + entry.path_offset, entry.path_size});
+			auto slot_index = static_cast<std::size_t>(hash) & mask;
+			while(slots[slot_index].node != invalid_node_id) {
+				slot_index = (slot_index + 1) & mask;
+			}
+			slots[slot_index] = entry;
+		}
+		return slots;
+	}
+
 	[[nodiscard]] node_id new_node(node_kind kind, node_id parent, std::string_view name) {
 		const auto id = checked_u32(nodes_.size(), "too many text tree nodes");
 		nodes_.push_back(detail::build_node{
@@ -90,6 +90,162 @@ private:
 	text_subscription subscription_{};
 };
 
+export struct i18n_text_batch_options{
+	/**
+	 * @brief Resolve on worker threads once a batch holds at least this many distinct paths, 0 always resolves inline.
+	 */
+	std::size_t parallel_threshold{};
+};
+
+/**
+ * @brief Collects the text updates of bound listeners and delivers them together.
+ *
+ * While a batch is alive, it is the active batch of its thread: listeners created by `make_i18n_text_listener`
+ * (and so every target binding) defer to it instead of applying their text right away. `flush` then drops the
+ * repeated updates of a listener (the last one wins), resolves each distinct path once per snapshot and applies
+ * the results in the order they were deferred.
+ *
+ * Updates still pending when the batch is destroyed are dropped, deferred listeners must outlive the flush.
+ */
+export class i18n_text_batch{
+public:
+	using apply_fn = void(*)(void* target, std::string_view text);
+
+	[[nodiscard]] explicit i18n_text_batch(i18n_text_batch_options options = {})
+		: options_(options),
+		  previous_(std::exchange(active_, this)){
+	}
+
+	i18n_text_batch(const i18n_text_batch&) = delete;
+	i18n_text_batch& operator=(const i18n_text_batch&) = delete;
+
+	~i18n_text_batch(){
+		active_ = previous_;
+	}
+
+	[[nodiscard]] static i18n_text_batch* active() noexcept{
+		return active_;
+	}
+
+	[[nodiscard]] std::size_t pending() const noexcept{
+		return entries_.size();
+	}
+
+	void defer(const text_snapshot* snapshot, const text_subscription& subscription, void* target, apply_fn apply){
+		entries_.push_back({snapshot, std::addressof(subscription), target, apply});
+	}
+
+	/**
+	 * @brief Deliver every deferred update, including the ones deferred by the updates themselves.
+	 *
+	 * @return number of updates applied
+	 */
+	std::size_t flush(){
+		std::size_t applied{};
+		std::vector<entry> entries;
+		while(!entries_.empty()){
+			entries.clear();
+			entries.swap(entries_);
+			deduplicate_(entries);
+			resolve_(entries);
+
+			for(const auto& e : entries){
+				e.apply(e.target, e.text);
+			}
+			applied += entries.size();
+		}
+		return applied;
+	}
+
+private:
+	struct entry{
+		const text_snapshot* snapshot;
+		const text_subscription* subscription;
+		void* target;
+		apply_fn apply;
+		std::string_view text{};
+	};
+
+	static inline thread_local i18n_text_batch* active_{};
+
+	i18n_text_batch_options options_{};
+	i18n_text_batch* previous_{};
+	std::vector<entry> entries_{};
+
+	//keeps the last update of each target, in deferral order
+	static void deduplicate_(std::vector<entry>& entries){
+		std::vector<std::size_t> order(entries.size());
+		std::iota(order.begin(), order.end(), 0uz);
+		std::ranges::stable_sort(order, std::ranges::less{}, [&](std::size_t i){ return entries[i].target; });
+
+		std::vector<bool> keep(entries.size());
+		for(std::size_t i = 0; i < order.size(); ++i){
+			if(i + 1 == order.size() || entries[order[i]].target != entries[order[i + 1]].target){
+				keep[order[i]] = true;
+			}
+		}
+
+		std::size_t count{};
+		for(std::size_t i = 0; i < entries.size(); ++i){
+			if(keep[i]) entries[count++] = entries[i];
+		}
+		entries.resize(count);
+	}
+
+	void resolve_(std::vector<entry>& entries) const{
+		struct lookup_key{
+			const frozen_text_tree* tree;
+			std::string_view path;
+
+			auto operator<=>(const lookup_key&) const noexcept = default;
+		};
+
+		const auto key_of = [](const entry& e) -> lookup_key{
+			if(e.snapshot == nullptr || !e.snapshot->tree) return {};
+			return {e.snapshot->tree.get(), e.subscription->path};
+		};
+
+		std::vector<std::size_t> order(entries.size());
+		std::iota(order.begin(), order.end(), 0uz);
+		std::ranges::sort(order, std::ranges::less{}, [&](std::size_t i){ return key_of(entries[i]); });
+
+		std::vector<lookup_key> keys;
+		std::vector<std::size_t> key_of_entry(entries.size());
+		for(const auto i : order){
+			const auto key = key_of(entries[i]);
+			if(keys.empty() || keys.back() != key) keys.push_back(key);
+			key_of_entry[i] = keys.size() - 1;
+		}
+
+		std::vector<std::optional<std::string_view>> texts(keys.size());
+		const auto resolve_range = [&](std::size_t begin, std::size_t end) noexcept{
+			for(; begin < end; ++begin){
+				const auto& [tree, path] = keys[begin];
+				if(tree != nullptr && !path.empty()) texts[begin] = tree->find_text(path);
+			}
+		};
+
+		const auto workers = std::min<std::size_t>(std::thread::hardware_concurrency(), keys.size());
+		if(options_.parallel_threshold != 0 && keys.size() >= options_.parallel_threshold && workers > 1){
+			//the trees are immutable, lookups from several threads need no synchronization
+			const auto chunk = (keys.size() + workers - 1) / workers;
+			std::vector<std::jthread> threads;
+			threads.reserve(workers - 1);
+			for(std::size_t begin = chunk; begin < keys.size(); begin += chunk){
+				threads.emplace_back(resolve_range, begin, std::min(begin + chunk, keys.size()));
+			}
+			resolve_range(0, std::min(chunk, keys.size()));
+		}else{
+			resolve_range(0, keys.size());
+		}
+
+		for(std::size_t i = 0; i < entries.size(); ++i){
+			auto& e = entries[i];
+			e.text = texts[key_of_entry[i]].value_or(e.subscription->missing_i18n_text());
+		}
+	}
+};
+
 struct i18n_text_snapshot_pointer{
 	[[nodiscard]] static const text_snapshot* operator()(const text_snapshot& snapshot) noexcept{
 		return std::addressof(snapshot);
@@ -121,6 +277,25 @@ export struct i18n_text_root_node
 				.locale = std::string{locale},
 			});
 	}
+
+	/**
+	 * @brief Swap in a new tree as the next revision, bound listeners receive their texts as one `i18n_text_batch`.
+	 *
+	 * Every successor is notified first, then each distinct path is looked up once in the new tree and the texts
+	 * are delivered back to back, so the scene sees a single burst of changes to lay out.
+	 */
+	std::size_t switch_tree(
+		frozen_text_tree_ptr tree,
+		std::string_view locale,
+		i18n_text_batch_options options = {}){
+		i18n_text_batch batch{options};
+		update_value(text_snapshot{
+				.tree = std::move(tree),
+				.revision = get_raw_cache().revision + 1,
+				.locale = std::string{locale},
+			});
+		return batch.flush();
+	}
 };
 
 export struct i18n_text_subscriber_node : react_flow::modifier<
@@ -181,6 +356,12 @@ struct i18n_text_listener_callback{
 	Fn fn;
 
 	void operator()(react_flow::data_carrier<const text_snapshot*>& snapshot){
+		if(auto* batch = i18n_text_batch::active()){
+			batch->defer(snapshot.get(), subscription_state.subscription(), this, [](void* self, std::string_view text){
+				std::invoke(static_cast<i18n_text_listener_callback*>(self)->fn, text);
+			});
+			return;
+		}
 		std::invoke(fn, subscription_state.resolve(snapshot.get()));
 	}
 };
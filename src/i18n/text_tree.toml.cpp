@@ -360,18 +360,43 @@ std::vector<locale_name> make_locale_fallback_chain(
 	return chain;
 }
 
+namespace {
+
+[[nodiscard]] bool is_older_than(const std::filesystem::path& lhs, const std::filesystem::path& rhs) noexcept {
+	std::error_code ec;
+	const auto lhs_time = std::filesystem::last_write_time(lhs, ec);
+	if(ec) {
+		return true;
+	}
+	const auto rhs_time = std::filesystem::last_write_time(rhs, ec);
+	if(ec) {
+		return false;
+	}
+	return lhs_time < rhs_time;
+}
+
+}
+
 std::optional<locale_text_tree_file> find_text_tree_locale_file(
 	std::string_view locale,
 	const locale_text_tree_load_options& options) {
 	std::optional<locale_text_tree_file> result;
 	visit_locale_fallback_chain(locale, options.default_locale, [&](locale_name candidate) {
 		auto path = options.bundle_dir / std::filesystem::path{std::string_view{candidate}};
+		auto binary_path = path;
 		path += ".toml";
+		binary_path += text_tree_binary_extension;
 
 		std::error_code ec;
-		if(!std::filesystem::is_regular_file(path, ec)) {
+		const bool has_source = std::filesystem::is_regular_file(path, ec);
+		const bool has_binary = std::filesystem::is_regular_file(binary_path, ec);
+		if(!has_source && !has_binary) {
 			return false;
 		}
+		//a compiled bundle older than its source is stale, parse the source instead
+		if(has_binary && (!has_source || !is_older_than(binary_path, path))) {
+			path = std::move(binary_path);
+		}
 
 		result = locale_text_tree_file{
 			.locale = candidate,
@@ -390,6 +415,28 @@ std::optional<locale_text_tree_load_result> load_text_tree_locale_bundle(
 		return std::nullopt;
 	}
 
+	if(file->path.extension() == text_tree_binary_extension) {
+		auto source_path = file->path;
+		source_path.replace_extension(".toml");
+		std::error_code ec;
+		const bool has_source = std::filesystem::is_regular_file(source_path, ec);
+
+		try {
+			auto tree = map_text_tree_binary_file(file->path);
+			return locale_text_tree_load_result{
+				.tree = std::move(tree),
+				.locale = std::move(file->locale),
+				.path = std::move(file->path),
+			};
+		} catch(const std::invalid_argument&) {
+			//a corrupted or incompatible compiled bundle must not hide a valid source
+			if(!has_source) {
+				throw;
+			}
+			file->path = std::move(source_path);
+		}
+	}
+
 	auto toml_options = options.toml;
 	toml_options.base_dir = file->path.parent_path();
 	return locale_text_tree_load_result{
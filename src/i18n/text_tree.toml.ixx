@@ -44,10 +44,18 @@ export [[nodiscard]] std::vector<locale_name> make_locale_fallback_chain(
 	std::string_view locale,
 	std::string_view default_locale = "en-US");
 
+/**
+ * @brief A compiled `<locale>.ttb` (see `save_text_tree_binary_file`) is preferred over `<locale>.toml` unless it is older.
+ */
 export [[nodiscard]] std::optional<locale_text_tree_file> find_text_tree_locale_file(
 	std::string_view locale,
 	const locale_text_tree_load_options& options = {});
 
+/**
+ * @brief Load the file `find_text_tree_locale_file` picks, a compiled bundle that fails to map falls back to its `.toml`.
+ *
+ * @throws std::invalid_argument if the file that ends up loaded is invalid
+ */
 export [[nodiscard]] std::optional<locale_text_tree_load_result> load_text_tree_locale_bundle(
 	std::string_view locale,
 	const locale_text_tree_load_options& options = {});
@@ -0,0 +1,162 @@
+module;
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+export module mo_yanxi.platform.mapped_file;
+
+import std;
+
+namespace mo_yanxi::platform {
+
+/**
+ * @brief Read-only view of a whole file mapped into the address space.
+ *
+ * An empty file or a failed open yields an empty mapping instead of throwing, callers treat it as "no data".
+ */
+export struct mapped_file {
+private:
+	const std::byte* data_{};
+	std::size_t size_{};
+
+#ifdef _WIN32
+	HANDLE file_{INVALID_HANDLE_VALUE};
+	HANDLE mapping_{};
+#endif
+
+public:
+	[[nodiscard]] mapped_file() = default;
+
+	[[nodiscard]] explicit mapped_file(const std::filesystem::path& path) noexcept {
+#ifdef _WIN32
+		file_ = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+		if(file_ == INVALID_HANDLE_VALUE) {
+			return;
+		}
+
+		LARGE_INTEGER file_size{};
+		if(!GetFileSizeEx(file_, &file_size) || file_size.QuadPart <= 0) {
+			close_();
+			return;
+		}
+
+		mapping_ = CreateFileMappingW(file_, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if(mapping_ == nullptr) {
+			close_();
+			return;
+		}
+
+		const auto* view = MapViewOfFile(mapping_, FILE_MAP_READ, 0, 0, 0);
+		if(view == nullptr) {
+			close_();
+			return;
+		}
+
+		data_ = static_cast<const std::byte*>(view);
+		size_ = static_cast<std::size_t>(file_size.QuadPart);
+#else
+		const int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) {
+			return;
+		}
+
+		struct stat st{};
+		if(::fstat(fd, &st) != 0 || st.st_size <= 0) {
+			::close(fd);
+			return;
+		}
+
+		void* view = ::mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		::close(fd);
+		if(view == MAP_FAILED) {
+			return;
+		}
+
+		data_ = static_cast<const std::byte*>(view);
+		size_ = static_cast<std::size_t>(st.st_size);
+#endif
+	}
+
+	~mapped_file() {
+		close_();
+	}
+
+	mapped_file(const mapped_file&) = delete;
+	mapped_file& operator=(const mapped_file&) = delete;
+
+	mapped_file(mapped_file&& other) noexcept
+		: data_(std::exchange(other.data_, nullptr)),
+		  size_(std::exchange(other.size_, 0))
+#ifdef _WIN32
+		  , file_(std::exchange(other.file_, INVALID_HANDLE_VALUE)),
+		  mapping_(std::exchange(other.mapping_, nullptr))
+#endif
+	{
+	}
+
+	mapped_file& operator=(mapped_file&& other) noexcept {
+		if(this == &other) return *this;
+		close_();
+		data_ = std::exchange(other.data_, nullptr);
+		size_ = std::exchange(other.size_, 0);
+#ifdef _WIN32
+		file_ = std::exchange(other.file_, INVALID_HANDLE_VALUE);
+		mapping_ = std::exchange(other.mapping_, nullptr);
+#endif
+		return *this;
+	}
+
+	[[nodiscard]] const std::byte* data() const noexcept {
+		return data_;
+	}
+
+	[[nodiscard]] std::size_t size() const noexcept {
+		return size_;
+	}
+
+	[[nodiscard]] bool empty() const noexcept {
+		return size_ == 0;
+	}
+
+	[[nodiscard]] std::span<const std::byte> bytes() const noexcept {
+		return {data_, size_};
+	}
+
+	[[nodiscard]] std::string_view chars() const noexcept {
+		return {reinterpret_cast<const char*>(data_), size_};
+	}
+
+	explicit operator bool() const noexcept {
+		return data_ != nullptr;
+	}
+
+	void reset() noexcept {
+		close_();
+	}
+
+private:
+	void close_() noexcept {
+#ifdef _WIN32
+		if(data_) UnmapViewOfFile(data_);
+		if(mapping_) CloseHandle(mapping_);
+		if(file_ != INVALID_HANDLE_VALUE) CloseHandle(file_);
+		mapping_ = nullptr;
+		file_ = INVALID_HANDLE_VALUE;
+#else
+		if(data_) ::munmap(const_cast<std::byte*>(data_), size_);
+#endif
+		data_ = nullptr;
+		size_ = 0;
+	}
+};
+
+}
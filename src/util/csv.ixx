@@ -1,6 +1,15 @@
+module;
+
+#if defined(_M_X64) || defined(__SSE2__)
+#define XRGUI_CSV_HAS_SSE2 1
+#include <emmintrin.h>
+#endif
+
 export module mo_yanxi.csv;
 
 import std;
+import mo_yanxi.platform.mapped_file;
+import mo_yanxi.thread_pool;
 
 namespace mo_yanxi::csv{
 export
@@ -112,6 +121,37 @@ export struct coord{
 template <typename Func>
 concept csv_callback = std::invocable<Func, coord, std::string_view>;
 
+/**
+ * @brief Find the next quote, delimiter or line break at or after `pos`.
+ *
+ * @return `data.size()` if there is none
+ */
+[[nodiscard]] inline std::size_t find_structural(std::string_view data, std::size_t pos, char delimiter) noexcept{
+#if XRGUI_CSV_HAS_SSE2
+	const __m128i quote = _mm_set1_epi8('"');
+	const __m128i delim = _mm_set1_epi8(delimiter);
+	const __m128i lf = _mm_set1_epi8('\n');
+	const __m128i cr = _mm_set1_epi8('\r');
+
+	for(; pos + 16 <= data.size(); pos += 16){
+		const __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data.data() + pos));
+		const __m128i hit = _mm_or_si128(
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, delim)),
+			_mm_or_si128(_mm_cmpeq_epi8(chunk, lf), _mm_cmpeq_epi8(chunk, cr)));
+
+		if(const auto mask = static_cast<unsigned>(_mm_movemask_epi8(hit))){
+			return pos + std::countr_zero(mask);
+		}
+	}
+#endif
+
+	for(; pos < data.size(); ++pos){
+		const char c = data[pos];
+		if(c == '"' || c == delimiter || c == '\n' || c == '\r') return pos;
+	}
+	return data.size();
+}
+
 template <csv_callback Callback>
 inline void parse_memory(std::string_view data, Callback&& callback, char delimiter = ','){
 	std::size_t current_row = 0;
@@ -130,15 +170,19 @@ inline void parse_memory(std::string_view data, Callback&& callback, char delimi
 	};
 
 	for(std::size_t i = 0; i < data.size(); ++i){
+		//only a quote can end a quoted section, anything else is skipped in bulk
+		i = in_quotes ? data.find('"', i) : find_structural(data, i, delimiter);
+		if(i >= data.size()) break;
+
 		char c = data[i];
 
 		if(c == '"'){
 			in_quotes = !in_quotes;
-		} else if(c == delimiter && !in_quotes){
+		} else if(c == delimiter){
 			yield_field(i);
 			current_col++;
 			field_start = i + 1;
-		} else if((c == '\n' || c == '\r') && !in_quotes){
+		} else{
 			bool is_rn = (c == '\r' && i + 1 < data.size() && data[i + 1] == '\n');
 			yield_field(i);
 
@@ -159,6 +203,291 @@ inline void parse_memory(std::string_view data, Callback&& callback, char delimi
 	}
 }
 
+/**
+ * @brief Find the first record boundary at or after `target`, scanning quotes from `from`, a known boundary.
+ *
+ * Records end with `\n`, `\r\n` or a lone `\r`, the same as in `parse_memory`.
+ *
+ * @return the position after the line break ending the record, or `data.size()`
+ */
+[[nodiscard]] inline std::size_t next_record_boundary(std::string_view data, std::size_t from, std::size_t target) noexcept{
+	if(target >= data.size()) return data.size();
+
+	bool in_quotes = false;
+	for(auto quote = data.find('"', from); quote < target; quote = data.find('"', quote + 1)){
+		in_quotes = !in_quotes;
+	}
+
+	for(auto pos = data.find_first_of("\"\n\r", target); pos != std::string_view::npos; pos = data.find_first_of("\"\n\r", pos + 1)){
+		if(data[pos] == '"'){
+			in_quotes = !in_quotes;
+		} else if(!in_quotes){
+			if(data[pos] == '\r' && pos + 1 < data.size() && data[pos + 1] == '\n') ++pos;
+			return pos + 1;
+		}
+	}
+
+	return data.size();
+}
+
+export
+/**
+ * @brief Fields of consecutive records, viewing the source text without copying.
+ *
+ * Fields keep their escaped quotes, see `unescape_csv_field`.
+ */
+struct record_chunk{
+	std::size_t first_row{};
+	std::vector<std::string_view> fields{};
+	std::vector<std::size_t> record_ends{};
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return record_ends.size();
+	}
+
+	[[nodiscard]] bool empty() const noexcept{
+		return record_ends.empty();
+	}
+
+	[[nodiscard]] std::span<const std::string_view> operator[](std::size_t record) const noexcept{
+		const auto begin = record ? record_ends[record - 1] : 0;
+		return std::span{fields}.subspan(begin, record_ends[record] - begin);
+	}
+};
+
+export
+[[nodiscard]] inline record_chunk parse_chunk(std::string_view data, char delimiter = ','){
+	record_chunk chunk{};
+	std::size_t current_row = 0;
+
+	csv::parse_memory(data, [&](coord pos, std::string_view field){
+		if(pos.row != current_row){
+			chunk.record_ends.push_back(chunk.fields.size());
+			current_row = pos.row;
+		}
+		chunk.fields.push_back(field);
+	}, delimiter);
+
+	if(!chunk.fields.empty()){
+		chunk.record_ends.push_back(chunk.fields.size());
+	}
+	return chunk;
+}
+
+export
+/**
+ * @brief Splits a text into chunks on record boundaries, parses them on a thread pool and hands them out in source order.
+ *
+ * Up to `max_in_flight` chunks are parsed ahead of the consumer. The queued tasks hold `keep_alive`, which should
+ * own the text: dropping the parser then only cancels the chunks not started yet instead of waiting for the running
+ * ones. Without it the destructor waits for them.
+ */
+class parallel_chunk_parser{
+public:
+	static constexpr std::size_t default_chunk_size = 8uz << 20;
+
+private:
+	struct pending_chunk{
+		std::string_view text{};
+		char delimiter{};
+		std::atomic_bool claimed{};
+		std::atomic_bool ready{};
+		record_chunk chunk{};
+		std::exception_ptr error{};
+
+		[[nodiscard]] pending_chunk(std::string_view text, char delimiter) noexcept
+			: text(text), delimiter(delimiter){
+		}
+
+		//the pool task and the consumer race for the chunk, only the winner parses it
+		bool try_run() noexcept{
+			if(claimed.exchange(true, std::memory_order_acq_rel)) return false;
+			try{
+				chunk = csv::parse_chunk(text, delimiter);
+			} catch(...){
+				error = std::current_exception();
+			}
+			ready.store(true, std::memory_order_release);
+			ready.notify_all();
+			return true;
+		}
+
+		bool try_cancel() noexcept{
+			return !claimed.exchange(true, std::memory_order_acq_rel);
+		}
+
+		void wait() const noexcept{
+			ready.wait(false, std::memory_order_acquire);
+		}
+	};
+
+	thread_pool* pool_{};
+	std::string_view text_{};
+	char delimiter_{','};
+	std::shared_ptr<const void> keep_alive_{};
+
+	std::deque<std::shared_ptr<pending_chunk>> in_flight_{};
+	std::size_t max_in_flight_{};
+	std::size_t chunk_size_{};
+	std::size_t begin_{};
+	std::size_t next_row_{};
+
+public:
+	[[nodiscard]] parallel_chunk_parser(
+		thread_pool& pool,
+		std::string_view text,
+		char delimiter = ',',
+		std::shared_ptr<const void> keep_alive = {},
+		std::size_t max_in_flight = 0,
+		std::size_t chunk_size = default_chunk_size)
+		: pool_(&pool),
+		text_(text),
+		delimiter_(delimiter),
+		keep_alive_(std::move(keep_alive)),
+		max_in_flight_(max_in_flight ? max_in_flight : pool.size() + 1),
+		chunk_size_(std::max(chunk_size, 1uz)){
+		refill_();
+	}
+
+	parallel_chunk_parser(const parallel_chunk_parser&) = delete;
+	parallel_chunk_parser& operator=(const parallel_chunk_parser&) = delete;
+
+	~parallel_chunk_parser(){
+		if(keep_alive_){
+			for(const auto& chunk : in_flight_) (void)chunk->try_cancel();
+		} else{
+			stop();
+		}
+	}
+
+	/** @return true once every chunk has been handed out */
+	[[nodiscard]] bool done() const noexcept{
+		return in_flight_.empty() && begin_ >= text_.size();
+	}
+
+	/**
+	 * @brief The next chunk if it has already been parsed, never blocks.
+	 */
+	[[nodiscard]] std::optional<record_chunk> try_next(){
+		if(in_flight_.empty() || !in_flight_.front()->ready.load(std::memory_order_acquire)) return std::nullopt;
+		return take_();
+	}
+
+	/**
+	 * @brief The next chunk, parsed on the calling thread if no worker has started it yet.
+	 *
+	 * Does not depend on free workers, so it may be called from a task of the same pool.
+	 */
+	[[nodiscard]] std::optional<record_chunk> next(){
+		if(in_flight_.empty()) return std::nullopt;
+		auto& front = *in_flight_.front();
+		if(!front.try_run()) front.wait();
+		return take_();
+	}
+
+	/**
+	 * @brief Drop the chunks not started yet and wait for the ones being parsed.
+	 */
+	void stop() noexcept{
+		for(const auto& chunk : in_flight_){
+			if(!chunk->try_cancel()) chunk->wait();
+		}
+		in_flight_.clear();
+		begin_ = text_.size();
+	}
+
+private:
+	void refill_(){
+		while(begin_ < text_.size() && in_flight_.size() < max_in_flight_){
+			const auto end = csv::next_record_boundary(text_, begin_, begin_ + chunk_size_);
+			auto chunk = std::make_shared<pending_chunk>(text_.substr(begin_, end - begin_), delimiter_);
+			(void)pool_->try_post([chunk, keep_alive = keep_alive_]{
+				(void)chunk->try_run();
+			});
+			in_flight_.push_back(std::move(chunk));
+			begin_ = end;
+		}
+	}
+
+	[[nodiscard]] record_chunk take_(){
+		const auto pending = std::move(in_flight_.front());
+		in_flight_.pop_front();
+		if(pending->error) std::rethrow_exception(pending->error);
+
+		auto chunk = std::move(pending->chunk);
+		chunk.first_row = next_row_;
+		next_row_ += chunk.size();
+		refill_();
+		return chunk;
+	}
+};
+
+export
+/**
+ * @brief Memory mapped csv file parsed in place.
+ *
+ * Fields are views into the mapping and stay valid as long as the reader lives.
+ */
+struct mapped_reader{
+	static constexpr std::size_t default_chunk_size = parallel_chunk_parser::default_chunk_size;
+
+private:
+	platform::mapped_file file_{};
+	char delimiter_{','};
+
+public:
+	[[nodiscard]] mapped_reader() = default;
+
+	[[nodiscard]] explicit mapped_reader(const std::filesystem::path& path, char delimiter = ',')
+		: file_(path), delimiter_(delimiter){
+	}
+
+	[[nodiscard]] explicit operator bool() const noexcept{
+		return static_cast<bool>(file_);
+	}
+
+	[[nodiscard]] char delimiter() const noexcept{
+		return delimiter_;
+	}
+
+	/** @brief The mapped text without a leading UTF-8 byte order mark. */
+	[[nodiscard]] std::string_view data() const noexcept{
+		auto text = file_.chars();
+		if(text.starts_with("\xEF\xBB\xBF")) text.remove_prefix(3);
+		return text;
+	}
+
+	template <csv_callback Callback>
+	void parse(Callback&& callback) const{
+		csv::parse_memory(data(), std::forward<Callback>(callback), delimiter_);
+	}
+
+	/**
+	 * @brief Split the text into chunks on record boundaries and parse them on `pool`.
+	 *
+	 * Chunks are handed to `on_chunk` on the calling thread in source order as soon as they and
+	 * all chunks before them complete, with at most `max_in_flight` chunks parsed ahead (the pool size plus one by
+	 * default). `on_chunk` may return false to stop. See `parallel_chunk_parser`.
+	 */
+	template <typename OnChunk>
+		requires std::invocable<OnChunk&, record_chunk&&>
+	void parse_parallel(
+		thread_pool& pool,
+		OnChunk&& on_chunk,
+		std::size_t max_in_flight = 0,
+		std::size_t chunk_size = default_chunk_size) const{
+		parallel_chunk_parser parser{pool, data(), delimiter_, {}, max_in_flight, chunk_size};
+
+		while(auto chunk = parser.next()){
+			if constexpr(std::convertible_to<std::invoke_result_t<OnChunk&, record_chunk&&>, bool>){
+				if(!std::invoke(on_chunk, std::move(*chunk))) return;
+			} else{
+				std::invoke(on_chunk, std::move(*chunk));
+			}
+		}
+	}
+};
+
 export
 template <csv_callback Callback>
 inline void parse_file(const std::filesystem::path& file_path, Callback&& callback, char delimiter = ','){
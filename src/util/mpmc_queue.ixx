@@ -0,0 +1,126 @@
+export module mo_yanxi.mpmc_queue;
+
+import std;
+
+namespace mo_yanxi{
+
+export
+/**
+ * @brief Bounded lock-free multi-producer multi-consumer ring.
+ *
+ * Every cell carries a sequence number telling producers and consumers whose turn it is, so pushes and pops only
+ * contend on a single CAS of their own cursor. Nothing blocks: a full ring fails `try_push` and an empty one fails
+ * `try_pop`, waiting is left to the caller.
+ *
+ * Moving a value out of a cell must not throw, a popped cell is only released afterwards.
+ */
+template <typename T>
+class mpmc_queue{
+	static constexpr std::size_t cache_line_size = 64;
+
+	struct cell{
+		std::atomic<std::size_t> sequence;
+		alignas(T) std::byte storage[sizeof(T)];
+
+		T* value() noexcept{
+			return std::launder(reinterpret_cast<T*>(storage));
+		}
+	};
+
+	std::unique_ptr<cell[]> cells_{};
+	std::size_t mask_{};
+
+	alignas(cache_line_size) std::atomic<std::size_t> enqueue_pos_{};
+	alignas(cache_line_size) std::atomic<std::size_t> dequeue_pos_{};
+
+public:
+	/**
+	 * @param capacity rounded up to a power of two, at least 2
+	 */
+	[[nodiscard]] explicit mpmc_queue(std::size_t capacity = 1024)
+		: cells_(std::make_unique<cell[]>(std::bit_ceil(std::max<std::size_t>(capacity, 2)))),
+		  mask_(std::bit_ceil(std::max<std::size_t>(capacity, 2)) - 1){
+		for(std::size_t i = 0; i <= mask_; ++i){
+			cells_[i].sequence.store(i, std::memory_order::relaxed);
+		}
+	}
+
+	mpmc_queue(const mpmc_queue&) = delete;
+	mpmc_queue& operator=(const mpmc_queue&) = delete;
+
+	~mpmc_queue(){
+		while(try_pop()){}
+	}
+
+	template <typename... Args>
+		requires (std::constructible_from<T, Args&&...>)
+	[[nodiscard]] bool try_emplace(Args&&... args){
+		auto pos = enqueue_pos_.load(std::memory_order::relaxed);
+		cell* target;
+		while(true){
+			target = &cells_[pos & mask_];
+			const auto seq = target->sequence.load(std::memory_order::acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos);
+			if(diff == 0){
+				if(enqueue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order::relaxed)) break;
+			} else if(diff < 0){
+				return false;
+			} else{
+				pos = enqueue_pos_.load(std::memory_order::relaxed);
+			}
+		}
+
+		std::construct_at(target->value(), std::forward<Args>(args)...);
+		target->sequence.store(pos + 1, std::memory_order::release);
+		return true;
+	}
+
+	[[nodiscard]] bool try_push(T&& value){
+		return this->try_emplace(std::move(value));
+	}
+
+	[[nodiscard]] bool try_push(const T& value){
+		return this->try_emplace(value);
+	}
+
+	[[nodiscard]] std::optional<T> try_pop() noexcept(std::is_nothrow_move_constructible_v<T>){
+		auto pos = dequeue_pos_.load(std::memory_order::relaxed);
+		cell* target;
+		while(true){
+			target = &cells_[pos & mask_];
+			const auto seq = target->sequence.load(std::memory_order::acquire);
+			const auto diff = static_cast<std::ptrdiff_t>(seq) - static_cast<std::ptrdiff_t>(pos + 1);
+			if(diff == 0){
+				if(dequeue_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order::relaxed)) break;
+			} else if(diff < 0){
+				return std::nullopt;
+			} else{
+				pos = dequeue_pos_.load(std::memory_order::relaxed);
+			}
+		}
+
+		std::optional<T> result{std::move(*target->value())};
+		std::destroy_at(target->value());
+		target->sequence.store(pos + mask_ + 1, std::memory_order::release);
+		return result;
+	}
+
+	/**
+	 * @brief Only a hint while other threads push or pop concurrently.
+	 */
+	[[nodiscard]] std::size_t size_approx() const noexcept{
+		const auto deq = dequeue_pos_.load(std::memory_order::seq_cst);
+		const auto enq = enqueue_pos_.load(std::memory_order::seq_cst);
+		return enq > deq ? enq - deq : 0;
+	}
+
+	[[nodiscard]] bool empty_approx() const noexcept{
+		return size_approx() == 0;
+	}
+
+	[[nodiscard]] std::size_t capacity() const noexcept{
+		return mask_ + 1;
+	}
+};
+
+}
@@ -40,6 +40,50 @@ public:
 		queue_.push(std::move(fn));
 		return true;
 	}
+
+	[[nodiscard]] std::size_t size() const noexcept{
+		return workers_.size();
+	}
+
+	/**
+	 * @brief Invoke `fn(i)` for every i in [0, count) on the workers and wait for all of them.
+	 *
+	 * The calling thread claims indices as well and only waits for the ones already running,
+	 * so it may be called from a task of this pool. `fn` must not throw.
+	 */
+	template <std::invocable<std::size_t> Fn>
+	void parallel_for(std::size_t count, Fn&& fn){
+		if(count == 0) return;
+
+		struct batch{
+			std::atomic_size_t next{};
+			std::atomic_size_t done{};
+			std::size_t count{};
+			std::remove_reference_t<Fn>* fn{};
+
+			void run() noexcept{
+				for(auto i = next.fetch_add(1, std::memory_order_relaxed); i < count; i = next.fetch_add(1, std::memory_order_relaxed)){
+					std::invoke(*fn, i);
+					if(done.fetch_add(1, std::memory_order_acq_rel) + 1 == count) done.notify_all();
+				}
+			}
+		};
+
+		//helpers may start after the batch is finished, they only touch `fn` once they claimed an index
+		const auto shared = std::make_shared<batch>();
+		shared->count = count;
+		shared->fn = std::addressof(fn);
+
+		const auto helpers = std::min(count - 1, workers_.size());
+		for(std::size_t i = 0; i < helpers; ++i){
+			(void)try_post([shared]{ shared->run(); });
+		}
+		shared->run();
+
+		for(auto d = shared->done.load(std::memory_order_acquire); d != count; d = shared->done.load(std::memory_order_acquire)){
+			shared->done.wait(d, std::memory_order_acquire);
+		}
+	}
 };
 
 }
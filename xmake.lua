@@ -248,10 +248,16 @@ if is_host_project then
         add_files(path.join(magic_enum_dir, "module/magic_enum.cppm"), {
             public = true
         })
+        add_files("src/graphic/image/bitmap_kernels.ixx", {public = true})
+        add_files("src/graphic/image/bitmap_resize.ixx", {public = true})
+        add_files("src/graphic/image/region_slot_table.ixx", {public = true})
+        add_files("src/platform/mapped_file.ixx", {public = true})
         add_files("src/util/csv.ixx", {public = true})
         add_files("src/util/double_buffer.ixx", {public = true})
         add_files("src/util/fixed_vector.ixx", {public = true})
+        add_files("src/util/mpmc_queue.ixx", {public = true})
         add_files("src/util/resource_manager.ixx", {public = true})
+        add_files("src/util/thread_pool.ixx", {public = true})
         add_files("src/util/unicode.ixx", {public = true})
         add_files("src/util/vector_string.ixx", {public = true})
         add_files("src/audio/audio.ixx", {public = true})
@@ -259,6 +265,8 @@ if is_host_project then
         add_files("src/gui/core/misc/gui.sound.manager.ixx", {public = true})
         add_files("src/gui/core/misc/inout_animator.ixx", {public = true})
         add_files("src/gui/core/misc/gui.slider_logic.ixx", {public = true})
+        add_files("src/gui/core/draw/gui.renderer.scissor_bound.ixx", {public = true})
+        add_files("src/gui/ext/text_document.ixx", {public = true})
         add_files("src/audio/audio_resource.ixx", {public = true})
         add_files("src/i18n/text_tree.ixx", {public = true})
         add_files("src/i18n/text_tree.react_flow.ixx", {public = true})